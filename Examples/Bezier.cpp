@@ -1,6 +1,5 @@
 /* The following program renders Bezier curves in two ways --- using Bernstein polynomials and using de Casteljau's algorithm. */
 #include <iostream>
-#include <windows.h>
 #include <cmath>
 #include <vector>
 #include "graphics.h"
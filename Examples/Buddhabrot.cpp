@@ -0,0 +1,187 @@
+/*
+
+The following program renders the Buddhabrot, a way of looking at the Mandelbrot set (see Mandelbrot.cpp) that shows where the orbits of the points outside
+the set go before they escape, rather than how long they take to escape. Points C are picked at random; the ones whose orbit Z_n+1 = Z_n^2 + C escapes
+have every point Z_n of their orbit counted in a histogram of the image, and the brightness of each pixel shows how many orbits passed through it. The picture
+takes its name from looking a little like a seated Buddha (with the real axis pointing up).
+
+Unlike the escape-time Mandelbrot, the work is not tied to pixels: any orbit can land anywhere, so the threads cannot simply split the image. Instead each
+thread counts into a histogram of its own (no atomics, no sharing of cache lines), and at the end the histograms are added up, each thread summing its own
+band of rows across all of them, and the total is tone mapped into the window. Points in the main cardioid and the period-2 bulb never escape and are
+skipped without iterating, and every escaping orbit is also counted mirrored in the real axis, since the picture is symmetric. The number of samples and orbit
+points processed per second is printed, to compare machines.
+
+For more information on the Buddhabrot, please visit https://en.wikipedia.org/wiki/Buddhabrot
+
+*/
+
+#define NOMINMAX // graphics.h brings in windows.h, whose min and max macros would break std::min and std::max
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include "graphics.h"
+#include "colors.h"
+
+struct Random // xorshift64*: fast, and good enough for picking points
+{
+	uint64_t state;
+
+	Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+	double next() // uniform in [0, 1)
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
+
+struct SampleStats
+{
+	long long samples; // points C tried
+	long long escaped; // of which escaped (and were counted)
+	long long points; // orbit points counted
+};
+
+// The part of the plane shown: real part [-2, 1] across, imaginary part [-1.5, 1.5] down.
+const double RE_MIN = -2, RE_MAX = 1, IM_MIN = -1.5, IM_MAX = 1.5;
+
+bool isInsideBulbs(const double &cr, const double &ci) // main cardioid or period-2 bulb
+{
+	const double q = (cr - 0.25) * (cr - 0.25) + ci * ci;
+	return q * (q + (cr - 0.25)) <= 0.25 * ci * ci || (cr + 1) * (cr + 1) + ci * ci <= 0.0625;
+}
+
+void sampleOrbits(const long long &nSamples, const int &maxItr, const int &width, const int &height, const uint64_t &seed, std::vector<uint32_t> &histogram, SampleStats &stats)
+{
+	std::vector<double> orbitRe(maxItr), orbitIm(maxItr);
+	const double scaleX = width / (RE_MAX - RE_MIN), scaleY = height / (IM_MAX - IM_MIN);
+	Random random(seed);
+	for (long long s = 0; s < nSamples; s++)
+	{
+		const double cr = -2 + 4 * random.next(), ci = -2 + 4 * random.next(); // every escaping orbit that can reach the picture starts in here
+		stats.samples++;
+		if (isInsideBulbs(cr, ci))
+			continue;
+		double zr = 0, zi = 0;
+		int n = 0;
+		bool escaped = false;
+		while (n < maxItr && !escaped)
+		{
+			const double t = zr * zr - zi * zi + cr;
+			zi = 2 * zr * zi + ci;
+			zr = t;
+			escaped = zr * zr + zi * zi > 4;
+			if (!escaped) // the point it escapes to is not part of the picture
+			{
+				orbitRe[n] = zr;
+				orbitIm[n] = zi;
+				n++;
+			}
+		}
+		if (!escaped) // inside the set, as far as we can tell
+			continue;
+		stats.escaped++;
+		for (int i = 0; i < n; i++)
+		{
+			const double fx = (orbitRe[i] - RE_MIN) * scaleX, fy = (orbitIm[i] - IM_MIN) * scaleY;
+			if (fx >= 0 && fx < width && fy >= 0 && fy < height) // before truncating, which would take -0.5 to column 0
+			{
+				const int x = (int)fx, y = (int)fy;
+				histogram[(size_t)y * width + x]++;
+				histogram[(size_t)(height - 1 - y) * width + x]++; // and its mirror image
+				stats.points++;
+			}
+		}
+	}
+}
+
+void drawBuddhabrot(const int &width, const int &height, const long long &nSamples, const int &maxItr)
+{
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::vector<uint32_t>> histograms(nThreads);
+	std::vector<SampleStats> stats(nThreads, SampleStats());
+	std::vector<std::thread> pool;
+
+	// Sampling: each thread with its own histogram and random numbers
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back([&, t]()
+		{
+			histograms[t].assign((size_t)width * height, 0); // allocated (and first touched) by the thread that uses it
+			sampleOrbits(nSamples / nThreads + (t < nSamples % nThreads), maxItr, width, height, 12345 + t, histograms[t], stats[t]);
+		});
+	for (auto &thread : pool)
+		thread.join();
+	pool.clear();
+	auto sampled = std::chrono::steady_clock::now();
+
+	// Reduction: thread t adds up its own band of rows of every histogram into the first one
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back([&, t]()
+		{
+			const size_t begin = (size_t)height * t / nThreads * width, end = (size_t)height * (t + 1) / nThreads * width;
+			for (int h = 1; h < nThreads; h++)
+				for (size_t i = begin; i < end; i++)
+					histograms[0][i] += histograms[h][i];
+		});
+	for (auto &thread : pool)
+		thread.join();
+	pool.clear();
+	auto reduced = std::chrono::steady_clock::now();
+
+	// Tone mapping: brightness grows with the square root of the count, and the brightest 0.1% of the pixels are all white
+	const std::vector<uint32_t> &total = histograms[0];
+	std::vector<uint32_t> sorted(total);
+	std::nth_element(sorted.begin(), sorted.begin() + sorted.size() * 999 / 1000, sorted.end());
+	const double white = std::max(1u, sorted[sorted.size() * 999 / 1000]);
+	unsigned int gray[256];
+	for (int i = 0; i < 256; i++)
+		gray[i] = bufferpixel(COLOR(i, i, i));
+	int pitch = 0;
+	unsigned int *pixels = lockbuffer(&pitch);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			pixels[(size_t)y * pitch + x] = gray[(int)(255 * std::min(1.0, sqrt(total[(size_t)y * width + x] / white)))];
+	unlockbuffer(0, 0, width - 1, height - 1);
+	auto mapped = std::chrono::steady_clock::now();
+
+	SampleStats sum = SampleStats();
+	for (const SampleStats &s : stats)
+	{
+		sum.samples += s.samples;
+		sum.escaped += s.escaped;
+		sum.points += s.points;
+	}
+	const double sampleSeconds = std::chrono::duration<double>(sampled - start).count();
+	printf("%d threads: %lld samples (%lld escaped) and %lld orbit points in %.2f s.\n", nThreads, sum.samples, sum.escaped, sum.points, sampleSeconds);
+	printf("%.2f million samples/s, %.2f million orbit points/s.\n", sum.samples / sampleSeconds / 1e6, sum.points / sampleSeconds / 1e6);
+	printf("Reduction %.1f ms, tone mapping %.1f ms.\n", std::chrono::duration<double, std::milli>(reduced - sampled).count(),
+		std::chrono::duration<double, std::milli>(mapped - reduced).count());
+}
+
+int main()
+{
+	int width = 0, height = 0, maxItr = 0;
+	double millions = 0;
+	printf("Please enter the desired resolution in pixels. Width, followed by height.\n");
+	scanf("%d%d", &width, &height);
+	printf("Please enter the number of samples (in millions) and the maximum number of iterations (e.g. 100 1000).\n");
+	scanf("%lf%d", &millions, &maxItr);
+	if (width <= 0 || height <= 0 || millions <= 0 || maxItr <= 0)
+	{
+		printf("Invalid choice! Aborting...\n");
+		exit(EXIT_FAILURE);
+	}
+	initwindow(width, height, "Buddhabrot");
+	drawBuddhabrot(width, height, (long long)(millions * 1e6), maxItr);
+	system("pause");
+	closegraph();
+	return 0;
+}
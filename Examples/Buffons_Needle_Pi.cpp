@@ -12,7 +12,6 @@
 #include <iostream>
 #include <random>
 #include <vector>
-#include <windows.h>
 
 #include "graphics.h"
 #include "primitives.h"
@@ -141,7 +140,7 @@ int main()
 		std::cout << "Please enter the width of the parallel strips." << std::endl;
 		std::cin >> stripWidth;
 
-		stripWidth = min(WIDTH, stripWidth);
+		stripWidth = std::min<uint32_t>(WIDTH, stripWidth);
 		std::vector<Line> strips = generateStrips(stripWidth);
 
 		std::cout << "Please enter the number of sticks to use for the simulation. Higher the number, more accurate the simulation." << std::endl;
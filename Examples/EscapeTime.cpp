@@ -0,0 +1,272 @@
+/*
+
+The following program renders escape-time fractals: the Mandelbrot set (see Mandelbrot.cpp), Julia sets, the Burning Ship and the Multibrot sets z^n + c.
+All of them iterate a formula from a starting point until the orbit leaves a circle (the bailout) or a maximum number of iterations is reached, and color
+each pixel by how many iterations that took. They differ only in the formula, where the orbit starts, the bailout and the coloring.
+
+Here those four things are template parameters of one engine, so every variant is compiled into a loop of its own, with the formula inlined and the
+exponent of a Multibrot unrolled into plain multiplications; there is no branch on the variant and no call through a function pointer inside the loop. The
+fixed c of a Julia set is just a value the loop reads. The loop works on LANES pixels at once, with the pixels that have escaped masked out rather than
+leaving the loop, so the compiler can turn it into vector instructions.
+
+Usage:
+	EscapeTime [mandelbrot | julia <re> <im> | burningship | multibrot3 ... multibrot6] [width height] [iterations] [bands | binary]
+for example
+	EscapeTime julia -0.8 0.156 1024 768 1000
+
+For more information on these fractals, please visit https://en.wikipedia.org/wiki/Julia_set and https://en.wikipedia.org/wiki/Burning_Ship_fractal
+
+*/
+
+#define NOMINMAX // graphics.h brings in windows.h, whose min and max macros would break std::min and std::max
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "graphics.h"
+#include "colors.h"
+
+#define LANES 8 // pixels iterated together
+
+struct View // the part of the plane shown
+{
+	double left, top, right, bottom;
+};
+
+struct Params
+{
+	int width, height, maxItr;
+	View view;
+	double juliaRe, juliaIm; // c of a Julia set
+};
+
+// z^N by repeated multiplication, unrolled at compile time
+template <int N> struct Power
+{
+	static inline void apply(const double &zr, const double &zi, double &pr, double &pi)
+	{
+		Power<N - 1>::apply(zr, zi, pr, pi);
+		const double t = pr * zr - pi * zi;
+		pi = pr * zi + pi * zr;
+		pr = t;
+	}
+};
+
+template <> struct Power<1>
+{
+	static inline void apply(const double &zr, const double &zi, double &pr, double &pi)
+	{
+		pr = zr;
+		pi = zi;
+	}
+};
+
+// Formulas: one step of the orbit
+template <int N> struct Multibrot // z^N + c
+{
+	static inline void step(double &zr, double &zi, const double &cr, const double &ci)
+	{
+		double pr, pi;
+		Power<N>::apply(zr, zi, pr, pi);
+		zr = pr + cr;
+		zi = pi + ci;
+	}
+};
+
+template <> struct Multibrot<2> // z^2 + c, written out
+{
+	static inline void step(double &zr, double &zi, const double &cr, const double &ci)
+	{
+		const double t = zr * zr - zi * zi + cr;
+		zi = 2 * zr * zi + ci;
+		zr = t;
+	}
+};
+
+struct BurningShip // (|Re z| + i|Im z|)^2 + c
+{
+	static inline void step(double &zr, double &zi, const double &cr, const double &ci)
+	{
+		const double ar = fabs(zr), ai = fabs(zi);
+		zr = ar * ar - ai * ai + cr;
+		zi = 2 * ar * ai + ci;
+	}
+};
+
+// Starts: where the orbit of a pixel starts, and which c it uses
+struct FromZero // the Mandelbrot way: z = 0, c = the pixel
+{
+	static inline void start(const double &x, const double &y, const Params &, double &zr, double &zi, double &cr, double &ci)
+	{
+		zr = zi = 0;
+		cr = x;
+		ci = y;
+	}
+};
+
+struct FromPixel // the Julia way: z = the pixel, c fixed
+{
+	static inline void start(const double &x, const double &y, const Params &p, double &zr, double &zi, double &cr, double &ci)
+	{
+		zr = x;
+		zi = y;
+		cr = p.juliaRe;
+		ci = p.juliaIm;
+	}
+};
+
+// Colorings
+struct Binary // as in Mandelbrot.cpp
+{
+	static inline int color(const int &itr, const int &maxItr)
+	{
+		return (itr < maxItr) ? BLACK : WHITE;
+	}
+};
+
+struct Bands
+{
+	static inline int color(const int &itr, const int &maxItr)
+	{
+		return (itr < maxItr) ? 1 + itr % 15 : BLACK;
+	}
+};
+
+// Iterates LANES pixels of a row (real parts x, imaginary part y) and stores their iteration counts. Escaped lanes keep being stepped but no longer counted,
+// so the inner loop has no exits and the same work in every lane.
+template <class Formula, class Start, int BailoutSquared>
+inline void iterateLanes(const double *x, const double &y, const Params &p, int *itrs)
+{
+	const int maxItr = p.maxItr; // read once, the loop touches nothing else of p
+	double zr[LANES], zi[LANES], cr[LANES], ci[LANES];
+	int count[LANES], active[LANES];
+	for (int i = 0; i < LANES; i++)
+	{
+		Start::start(x[i], y, p, zr[i], zi[i], cr[i], ci[i]);
+		count[i] = 0;
+		active[i] = 1;
+	}
+	for (int n = 0; n < maxItr; n++)
+	{
+		int any = 0;
+		for (int i = 0; i < LANES; i++)
+		{
+			active[i] &= (zr[i] * zr[i] + zi[i] * zi[i] <= BailoutSquared);
+			count[i] += active[i];
+			any |= active[i];
+			Formula::step(zr[i], zi[i], cr[i], ci[i]);
+		}
+		if (!any)
+			break;
+	}
+	for (int i = 0; i < LANES; i++)
+		itrs[i] = count[i];
+}
+
+template <class Formula, class Start, int BailoutSquared, class Coloring>
+void render(const Params &p)
+{
+	const int padded = (p.width + LANES - 1) / LANES * LANES;
+	std::vector<double> xs(padded);
+	std::vector<int> itrs(padded);
+	unsigned int palette[16];
+	for (int color = 0; color < 16; color++)
+		palette[color] = bufferpixel(color);
+	for (int x = 0; x < padded; x++) // the padding repeats the last column
+		xs[x] = p.view.left + std::min(x, p.width - 1) * (p.view.right - p.view.left) / p.width;
+
+	int pitch = 0;
+	unsigned int *pixels = lockbuffer(&pitch);
+	for (int y = 0; y < p.height; y++)
+	{
+		const double im = p.view.top + y * (p.view.bottom - p.view.top) / p.height;
+		for (int x = 0; x < padded; x += LANES)
+			iterateLanes<Formula, Start, BailoutSquared>(&xs[x], im, p, &itrs[x]);
+		for (int x = 0; x < p.width; x++)
+			pixels[(size_t)y * pitch + x] = palette[Coloring::color(itrs[x], p.maxItr)];
+	}
+	unlockbuffer(0, 0, p.width - 1, p.height - 1);
+}
+
+// The variants that can be picked from the command line, each compiled with both colorings
+typedef void (*Renderer)(const Params &);
+
+struct Variant
+{
+	const char *name;
+	View view;
+	Renderer binary, bands;
+};
+
+#define VARIANT(name, view, Formula, Start) { name, view, render<Formula, Start, 4, Binary>, render<Formula, Start, 4, Bands> }
+
+const Variant variants[] =
+{
+	VARIANT("mandelbrot", View({ -2.5, -1, 1, 1 }), Multibrot<2>, FromZero),
+	VARIANT("julia", View({ -1.6, -1, 1.6, 1 }), Multibrot<2>, FromPixel),
+	VARIANT("burningship", View({ -2.2, -2, 1.3, 1 }), BurningShip, FromZero),
+	VARIANT("multibrot3", View({ -1.5, -1.5, 1.5, 1.5 }), Multibrot<3>, FromZero),
+	VARIANT("multibrot4", View({ -1.5, -1.5, 1.5, 1.5 }), Multibrot<4>, FromZero),
+	VARIANT("multibrot5", View({ -1.5, -1.5, 1.5, 1.5 }), Multibrot<5>, FromZero),
+	VARIANT("multibrot6", View({ -1.5, -1.5, 1.5, 1.5 }), Multibrot<6>, FromZero),
+};
+
+int main(int argc, char **argv)
+{
+	const int nVariants = sizeof(variants) / sizeof(variants[0]);
+	const Variant *variant = &variants[0];
+	Params p = { 800, 600, 500, variants[0].view, -0.8, 0.156 };
+	bool bands = true;
+	int arg = 1;
+
+	if (arg < argc && !isdigit((unsigned char)argv[arg][0]))
+	{
+		variant = NULL;
+		for (int v = 0; v < nVariants; v++)
+			if (strcmp(argv[arg], variants[v].name) == 0)
+				variant = &variants[v];
+		if (variant == NULL)
+		{
+			printf("Unknown fractal %s. Choose one of:", argv[arg]);
+			for (int v = 0; v < nVariants; v++)
+				printf(" %s", variants[v].name);
+			printf("\n");
+			exit(EXIT_FAILURE);
+		}
+		arg++;
+		if (strcmp(variant->name, "julia") == 0 && arg + 1 < argc)
+		{
+			p.juliaRe = atof(argv[arg++]);
+			p.juliaIm = atof(argv[arg++]);
+		}
+	}
+	if (arg + 1 < argc)
+	{
+		p.width = atoi(argv[arg++]);
+		p.height = atoi(argv[arg++]);
+	}
+	if (arg < argc && isdigit((unsigned char)argv[arg][0]))
+		p.maxItr = atoi(argv[arg++]);
+	if (arg < argc)
+		bands = strcmp(argv[arg++], "binary") != 0;
+	if (p.width <= 0 || p.height <= 0 || p.maxItr <= 0)
+	{
+		printf("Invalid choice! Aborting...\n");
+		exit(EXIT_FAILURE);
+	}
+	p.view = variant->view;
+
+	initwindow(p.width, p.height, variant->name);
+	auto start = std::chrono::steady_clock::now();
+	(bands ? variant->bands : variant->binary)(p);
+	auto stop = std::chrono::steady_clock::now();
+	printf("%s, %dx%d, %d iterations: %.1f ms.\n", variant->name, p.width, p.height, p.maxItr,
+		std::chrono::duration<double, std::milli>(stop - start).count());
+	system("pause");
+	closegraph();
+	return 0;
+}
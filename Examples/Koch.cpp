@@ -1,104 +1,90 @@
-/* 
-	The following program renders the Koch Snowflake using a naive implementation.
+/*
+	The following program renders the Koch Snowflake.
+
+	The curve is never stored: each side of the triangle is split depth first, and every segment at the bottom of the
+	recursion is handed to a sink as soon as it is found (see emitKochCurve), so a snowflake of any depth needs memory
+	for the recursion alone and no allocations. A segment is not split any further once its thirds would be shorter
+	than a pixel, as nothing of them could be seen; so asking for more iterations than that only costs the deepest
+	drawing again. The corners are kept in floats all the way down and only rounded to pixels when a segment is drawn.
 
 	For more information please see https://en.wikipedia.org/wiki/Koch_snowflake
-	
+
 */
 
 #include <iostream>
-#include <windows.h>
 #include <cmath>
-#include <vector>
 #include <chrono>
 
 #include "graphics.h"
 #include "colors.h"
 #include "primitives.h"
 
-// trisect a line segment and return the points
-std::vector<Point> trisect(const Line& edge)
+#define KOCH_MIN_LENGTH 3.0f // a segment shorter than this (in pixels) is not split, its thirds would be shorter than a pixel
+
+// draws every segment it is given
+struct LineSink
 {
-	Point p1;
-	double x = ((double)edge.dst.x + 2 * (double)edge.src.x) * 0.3333; // (mx2 + nx1) / (m + n)
-	double y = ((double)edge.dst.y + 2 * (double)edge.src.y) * 0.3333; // (my2 + ny1) / (m + n)
+	void operator()(const Vec2 &a, const Vec2 &b)
+	{
+		line((int)round(a.x), (int)round(a.y), (int)round(b.x), (int)round(b.y));
+	}
+};
 
-	p1.x = static_cast<int>(x);
-	p1.y = static_cast<int>(y);
+// counts the segments it is given, to time the generator without drawing
+struct CountSink
+{
+	size_t segments = 0;
 
-	Point p2 = getMidpoint(p1, edge.dst);
-	std::vector<Point> outList = {edge.src, p1, p2, edge.dst};
-	return outList;
-}
+	void operator()(const Vec2 &, const Vec2 &)
+	{
+		segments++;
+	}
+};
 
 /*
-	Given any two points p1 and p2 in an equilateral triangle,
-	get the third point.
+	Emits the Koch curve from a to b, split depth times, into sink, one segment at a time in order from a to b. The
+	middle third of each segment is replaced by the two other sides of the equilateral triangle on it, on the left of
+	the direction from a to b (outwards, for a triangle whose corners go clockwise on the screen); its apex is the
+	midpoint of the segment moved sqrt(3) / 6 of its length along the normal.
 */
-Point getApex(const Point& p1, const Point& p2)
-{	
-	Vec2 dir = points2Vec(p1, p2);	// get direction vector from p1 to p2
-
-	Point mid = getMidpoint(p1, p2);
-	Vec2 o(mid.x, mid.y);
-	double a = dir.getMagnitude(); // get the length of each side of the equilateral triangle
-	double h = 0.86605 * a; // height (h) = (sqrt(3) / 2) * a
-
-	Vec2 normal = dir.getNormal();
-	Vec2 p = o + normal * h; // walk h units from the mid point in the direction of the apex
-	return vec2Point(p);
-}
-
-// return a fractal side for a given edge
-std::vector<Line> getFractalSide(const Line& edge)
+template <class Sink>
+void emitKochCurve(const Vec2 &a, const Vec2 &b, int depth, Sink &sink)
 {
-	std::vector<Point> splitPoints = trisect(edge);
-	Point apex = getApex(splitPoints[1], splitPoints[2]);
-
-	std::vector<Line> out;
-	out.push_back(Line(splitPoints[0], splitPoints[1]));
-	out.push_back(Line(splitPoints[1], apex));
-	out.push_back(Line(apex, splitPoints[2]));
-	out.push_back(Line(splitPoints[2], splitPoints[3]));
-
-	return out;
+	const Vec2 d = b - a;
+	if (depth <= 0 || d.getMagnitude() < KOCH_MIN_LENGTH)
+	{
+		sink(a, b);
+		return;
+	}
+	const Vec2 p1 = a + d / 3.0f, p2 = a + d * (2.0f / 3.0f);
+	const Vec2 apex = (a + b) * 0.5f + Vec2(d.y, -d.x) * 0.28867513f; // sqrt(3) / 6
+	emitKochCurve(a, p1, depth - 1, sink);
+	emitKochCurve(p1, apex, depth - 1, sink);
+	emitKochCurve(apex, p2, depth - 1, sink);
+	emitKochCurve(p2, b, depth - 1, sink);
 }
 
-// draws each Koch curve of the snowflake
-void drawFractal(const std::vector<Line>& edgeList)
+// emits the three sides of the snowflake on the triangle with the given corners
+template <class Sink>
+void emitKochSnowflake(const Vec2 corners[3], int depth, Sink &sink)
 {
-	for (const auto& edge : edgeList)
-		edge.draw();
+	for (int i = 0; i < 3; i++)
+		emitKochCurve(corners[i], corners[(i + 1) % 3], depth, sink);
 }
 
-void drawKochSnowflake(std::vector<Line>& fractalEdges, int depth, int maxDepth)
+// draws every iteration of the snowflake up to maxDepth, half a second apart
+void drawKochSnowflake(const Vec2 corners[3], int maxDepth)
 {
-	if (depth < maxDepth)
+	LineSink sink;
+	for (int depth = 0; depth <= maxDepth; depth++)
 	{
-		cleardevice();
-		std::cout << "Drawing iteration: " << depth + 1 << std::endl;		
-
-		// draw the existing fractal edges
-		for (const auto& edge : fractalEdges)
-			edge.draw();
-
-		delay(500);
-		std::vector<Line> newEdges;
-
-		// fractalize each existing edge 
-		for (const auto& edge : fractalEdges)
+		if (depth > 0)
 		{
-			std::vector<Line> generatedEdges = getFractalSide(edge);
-			
-			// save each generated edge in a buffer storage
-			for (const auto& edge : generatedEdges)
-				newEdges.push_back(edge);
+			delay(500);
+			std::cout << "Drawing iteration: " << depth << std::endl;
 		}
-		fractalEdges.clear(); // clear stale edges
-		fractalEdges = newEdges; // update edges with the newly fractalized edges
-
 		cleardevice();
-		drawFractal(fractalEdges); // draw the newly created fractalized edges
-		drawKochSnowflake(fractalEdges, depth + 1, maxDepth);
+		emitKochSnowflake(corners, depth, sink);
 	}
 }
 
@@ -116,19 +102,30 @@ int main()
 
 		// hard-coded values for initial vertices
 		// of the parent equilateral triangle
-		std::vector<Line> edges;
-		edges.push_back({{ 200, 275 }, { 800, 275 }});
-		edges.push_back({{ 800, 275 }, { 500, 795 }});
-		edges.push_back({{ 500, 795 }, { 200, 275 }});
+		const Vec2 corners[3] = { Vec2(200, 275), Vec2(800, 275), Vec2(500, 795) };
 
 		auto start = std::chrono::high_resolution_clock::now();
 
-		drawKochSnowflake(edges, 0, nItr);
+		drawKochSnowflake(corners, nItr);
 
 		auto stop = std::chrono::high_resolution_clock::now();
 		auto diff = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
 		std::cout << "Time taken is " << diff.count() << " seconds.\n" << std::endl;
 
+		// time the last iteration again, without the delays: generating alone, then drawing
+		CountSink counter;
+		start = std::chrono::high_resolution_clock::now();
+		emitKochSnowflake(corners, nItr, counter);
+		stop = std::chrono::high_resolution_clock::now();
+		const double generated = std::chrono::duration<double, std::milli>(stop - start).count();
+		LineSink drawer;
+		start = std::chrono::high_resolution_clock::now();
+		emitKochSnowflake(corners, nItr, drawer);
+		stop = std::chrono::high_resolution_clock::now();
+		const double drawn = std::chrono::duration<double, std::milli>(stop - start).count();
+		printf("%zu segments: generated in %.2f ms (%.1f million a second), drawn in %.2f ms (%.1f million a second).\n", counter.segments,
+			generated, counter.segments / generated / 1000, drawn, counter.segments / drawn / 1000);
+
 		std::cout << "Continue? (1 = Yes / 0 = No)" << std::endl;
 		std::cin >> ch;
 		if (ch == 0)
@@ -136,9 +133,9 @@ int main()
 		std::cout << "\n\n";
 		cleardevice();
 	}
-		
+
 	std::cout << "Thank you." << std::endl;
 	system("pause"); // windows only feature
 	closegraph();
 	return 0;
-}
\ No newline at end of file
+}
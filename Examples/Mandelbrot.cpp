@@ -24,25 +24,84 @@ The Mandelbrot set is what is known as a fractal pattern. It has repeating patte
 Benoit Mandelbrot. It is the most well-known fractal. Computing the Mandelbrot used to be a very compute intensive task to perform once. Nowadays, it can be trivially 
 computed by even processors in smart watches. 
 
-For fun, there is a simple multithreaded implementation provided here using OpenMP. The setcolor() and putpixel() functions are both thread safe (but involve expensive locks),
-which is why the calls to them are not in a "#pragma omp critical" section. The speedup achieved is ~1.25x which is nothing spectacular. This might have something to do with
-the BGI library apart from just the poor quality of the naive implementation here (e.g. false sharing and alignment issues). Something more granular, like using a thread pool
-with tiling may provide better performance.
+For fun, there is a multithreaded implementation provided here as well. The single threaded version hands each row to putpixels() in one call. The
+multithreaded version cuts the image into 64x64 tiles and renders them on a small work-stealing thread pool. The tiles are first dealt out to the workers in runs
+of neighbouring tiles; a worker that runs out steals the back half of another worker's run, so the tiles along the boundary of the set, which take by far the most
+iterations, end up spread over all the workers. Each tile is rendered into a buffer of its own and then copied into the page (locked once with lockbuffer()) in one
+go. The time every tile took is printed afterwards as a map, together with how busy each worker was, so any load imbalance is easy to see. (When every pixel went
+through putpixel() and its lock, the speedup was only ~1.25x; with OpenMP over rows it was limited by the rows through the middle of the set.)
+
+Both versions run the escape-time loop on several pixels at once with SIMD instructions: 2 (SSE2), 4 (AVX) or 8 (AVX-512) doubles per instruction, whichever
+the processor supports, falling back to the plain scalar loop elsewhere. The counts are exactly those of the scalar loop. Set MANDEL_KERNEL=scalar (or sse2,
+avx) to compare.
+
+Answering Y to "Deep zoom?" renders a view of any width (1e-100 and far beyond the ~1e-13 where doubles give out) around a centre given to any number of
+digits. Only the centre is iterated in high precision; every pixel follows it as a small double-precision difference (perturbation), and is rebased onto the
+start of the orbit when that difference would lose its precision. See setupDeepZoom().
+
+Answering Y to "Trace boundaries?" skips most of the work inside the set: a rectangle whose border pixels all took the same number of iterations is filled in
+without iterating its inside (Mariani-Silver), the main cardioid and the period-2 bulb are recognised directly, and orbits that repeat are stopped early. The
+number of pixels skipped is printed at the end. See RectTracer.
+
+Answering Y to "Explore interactively?" lets you pan and zoom with the keyboard. Each view is drawn coarse to fine (every 8th pixel, then every 4th, 2nd and
+1st, shown after each pass), so the first picture is there in milliseconds, and the pixels that stay in view when panning or zooming by 2 keep their counts
+instead of being computed again. See exploreMandelbrot().
+
+Setting MANDEL_CACHE to a file name keeps the iteration counts of every tile in that file (MANDEL_CACHE_MB megabytes, default 256, least recently used
+tiles replaced), memory-mapped, so rendering a view again, even in a later run, reads the counts instead of computing them. See computeTile().
+
+Setting MANDEL_IMAGE to a file name renders into that file (a PAM image) instead of the window, for pictures larger than the screen or even than memory,
+such as 100000 x 100000 pixels. The file is memory-mapped a tile at a time (see createimagemapbgi in graphics.h), so the memory used stays the same however
+large the picture is. See drawMandelbrotToImage().
 
 To know more about the Mandelbrot set please refer to https://en.wikipedia.org/wiki/Mandelbrot_set
 
 */
 
+#define NOMINMAX // graphics.h brings in windows.h, whose min and max macros would break std::min and std::max
 #include <iostream>
 #include <cmath>
 #include <chrono>
 #include <thread>
-#include <omp.h>
-#include "windows.h"
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <mutex>
 #include "graphics.h"
 #include "colors.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define MAX_ITR 500
+#define TILE_SIZE 64
+
+// The escape-time kernels below use SSE2, AVX or AVX-512 when the processor has them. The choice is made when the program starts, so one build runs
+// everywhere; GCC and Clang need the target attribute to compile the wider kernels without -mavx, MSVC compiles them as they are. GCC would also fuse
+// a multiply and an add into one FMA instruction where the target has it (AVX-512 does), which rounds differently from the scalar code, so that is
+// turned off for the kernels.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MANDEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MANDEL_TARGET(isa)
+#elif defined(__clang__)
+#define MANDEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MANDEL_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#endif
+#endif
 
 struct Complex // class to support Complex numbers
 {
@@ -68,23 +127,135 @@ struct Complex // class to support Complex numbers
 	}
 };
 
+struct DeepZoom // the state of the deep zoom mode (see setupDeepZoom)
+{
+	bool active;
+	int maxItr;
+	double pixelSize; // width of one pixel in the complex plane
+	std::vector<double> refRe, refIm; // the reference orbit Z_0 ... Z_len (the last one may have escaped)
+	std::atomic<long long> rebases;
+	double centreRe, centreIm; // the centre, rounded (for the tile cache)
+	uint64_t centreHash; // a hash of the exact digits of the centre (for the tile cache)
+} deepZoom;
+
+struct TraceStats // how much work boundary tracing saved
+{
+	long long skipped; // pixels filled in without being iterated
+	long long rejected; // pixels found inside the main cardioid or the period-2 bulb
+	long long periodic; // pixels whose orbit was caught repeating itself
+};
+bool boundaryTracing = false;
+std::atomic<long long> tracedSkipped(0), tracedRejected(0), tracedPeriodic(0);
+
+// The layout of the tile cache file: a header and then nSets sets of CACHE_WAYS slots (see the description above getCacheSet)
+#define CACHE_WAYS 8
+#define CACHE_MAGIC 0x31435444424e414dULL // "MANDBTC1"
+
+struct CacheKey
+{
+	double centreRe, centreIm, scaleX, scaleY;
+	uint64_t centreHash;
+	int32_t width, height, maxItr, mode, tileX, tileY;
+};
+
+struct CacheSlot
+{
+	CacheKey key;
+	uint64_t lastUsed; // 0 for an empty slot
+	int32_t itrs[TILE_SIZE * TILE_SIZE];
+};
+
+struct CacheHeader
+{
+	uint64_t magic;
+	uint32_t nSets, ways, tileSize, slotSize;
+	uint64_t clock; // the last lastUsed handed out
+};
+
+struct TileCache
+{
+	unsigned char *base; // NULL when there is no cache
+	size_t size;
+	uint32_t nSets;
+	std::atomic<uint64_t> clock;
+	std::mutex setLocks[64]; // set i is guarded by setLocks[i % 64]
+	std::atomic<long long> hits, misses, evictions;
+#ifdef _WIN32
+	HANDLE file, mapping;
+#else
+	int file;
+#endif
+} tileCache; // the tile cache (see openTileCache)
+
 void drawMandelbrot(const int &, const int &);
 void drawMandelbrotMT(const int &, const int &);
 double getMappedScaleX(const int &, const int &); // maps pixel values in the X direction of screen space between (-2.5, 1)
 double getMappedScaleY(const int &, const int &); // maps pixel values in the Y direction of screen space between (-1, 1)
 void evalMandel(Complex &, const Complex &);
+void getIterationsRow(const int &, const int &, const int &, const int &, const int &, int *); // iterations before each point of a row escapes (MAX_ITR if it never does)
+const char *selectKernel(); // picks the widest escape-time kernel the processor supports
+bool setupDeepZoom(const char *, const char *, const double &, const int &, const int &); // switches to the perturbation renderer for a deep zoom
+int getPixelColor(const int &); // the color of a pixel that took the given number of iterations
+void traceRect(const int &, const int &, const int &, const int &, const int &, const int &, int *, const int &); // fills a rectangle of iteration counts by boundary tracing
+void exploreMandelbrot(const int &, const int &); // pans and zooms with the keyboard, drawing each view coarse to fine
+bool openTileCache(const char *, const size_t &); // keeps the iteration counts of rendered tiles in a memory-mapped file
+void closeTileCache();
+void computeTile(const int &, const int &, const int &, const int &, const int &, const int &, int *, const int &); // iteration counts of one tile, cached or not
+bool drawMandelbrotToImage(const int &, const int &, const char *, const bool &); // renders into a memory-mapped image file, a tile at a time
 
 int main()
 {
 	int width = 0, height = 0;
-	char ch = ' ';
+	char ch = ' ', zoom = ' ', ch2 = ' ';
 	printf("Please enter the desired resolution in pixels. Width, followed by height.\n");
 	scanf("%d%d", &width, &height);
+	printf("Explore interactively (arrow keys or WASD pan, + and - zoom, Q quits)? (Y/N)\n");
+	scanf(" %c", &ch);
+	if (ch == 'y' || ch == 'Y')
+	{
+		initwindow(width, height, "Mandelbrot");
+		printf("Using the %s kernel.\n", selectKernel());
+		exploreMandelbrot(width, height);
+		closegraph();
+		return 0;
+	}
 	printf("Enable multithreading? (Y/N)\n");
 	scanf(" %c", &ch);
-	initwindow(width, height, "Mandelbrot");
+	printf("Deep zoom? (Y/N)\n");
+	scanf(" %c", &zoom);
+	if (zoom == 'y' || zoom == 'Y')
+	{
+		char re[1024], im[1024];
+		double viewWidth = 0;
+		int maxItr = 0;
+		printf("Please enter the centre of the view (real part, then imaginary part, to as many digits as needed), its width (e.g. 1e-100) and the maximum number of iterations.\n");
+		scanf("%1023s%1023s%lf%d", re, im, &viewWidth, &maxItr);
+		if (!setupDeepZoom(re, im, viewWidth, maxItr, width))
+		{
+			printf("Invalid view! Aborting...\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	printf("Trace boundaries (skip the inside of regions with the same count all around)? (Y/N)\n");
+	scanf(" %c", &ch2);
+	boundaryTracing = (ch2 == 'y' || ch2 == 'Y');
+	const char *cachePath = getenv("MANDEL_CACHE"); // e.g. MANDEL_CACHE=mandel.cache, with MANDEL_CACHE_MB as its size (default 256)
+	if (cachePath != NULL && !openTileCache(cachePath, getenv("MANDEL_CACHE_MB") ? atoi(getenv("MANDEL_CACHE_MB")) : 256))
+		printf("Could not open the tile cache %s; rendering without it.\n", cachePath);
+	const char *imagePath = getenv("MANDEL_IMAGE"); // e.g. MANDEL_IMAGE=poster.pam
+	if (imagePath == NULL)
+		initwindow(width, height, "Mandelbrot");
+	printf("Using the %s kernel.\n", selectKernel());
 	auto start = std::chrono::high_resolution_clock::now();
-	if (ch == 'y' || ch == 'Y')
+	if (imagePath != NULL && (ch == 'y' || ch == 'Y' || ch == 'n' || ch == 'N'))
+	{
+		if (!drawMandelbrotToImage(width, height, imagePath, ch == 'y' || ch == 'Y'))
+		{
+			printf("Could not write the image %s! Aborting...\n", imagePath);
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if (ch == 'y' || ch == 'Y')
 		drawMandelbrotMT(width, height);
 	else if ((ch == 'n' || ch == 'N'))
 		drawMandelbrot(width, height);
@@ -94,8 +265,18 @@ int main()
 		exit(EXIT_FAILURE);
 	}
 	auto stop = std::chrono::high_resolution_clock::now();
+	if (deepZoom.active)
+		printf("%lld rebases.\n", (long long)deepZoom.rebases);
+	if (tileCache.base != NULL)
+		printf("Tile cache: %lld hits, %lld misses, %lld tiles evicted.\n", (long long)tileCache.hits, (long long)tileCache.misses, (long long)tileCache.evictions);
+	if (boundaryTracing)
+		printf("Boundary tracing: %lld of %lld pixels skipped, %lld in the cardioid or bulb, %lld caught repeating.\n", (long long)tracedSkipped,
+			(long long)width * height, (long long)tracedRejected, (long long)tracedPeriodic);
+	closeTileCache();
 	auto diff = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
 	printf("Time taken is %d seconds.\n", diff.count());
+	if (imagePath != NULL)
+		return 0;
 	system("pause");
 	closegraph();
 	return 0;
@@ -122,63 +303,1031 @@ void evalMandel(Complex &z, const Complex &c)
 
 void drawMandelbrot(const int &width, const int &height)
 {
+	std::vector<int> xs(width), ys(width), colors(width), itrs(width), traced;
+	if (tileCache.base != NULL) // a band of tiles at a time, so that each tile can come from the cache
+	{
+		traced.resize((size_t)width * TILE_SIZE);
+		for (int y0 = 0; y0 < height; y0 += TILE_SIZE)
+		{
+			const int h = std::min(TILE_SIZE, height - y0);
+			for (int x0 = 0; x0 < width; x0 += TILE_SIZE)
+				computeTile(x0, y0, std::min(TILE_SIZE, width - x0), h, width, height, &traced[x0], width);
+			for (int y = 0; y < h; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					xs[x] = x;
+					ys[x] = y0 + y;
+					colors[x] = getPixelColor(traced[(size_t)y * width + x]);
+				}
+				putpixels(width, xs.data(), ys.data(), colors.data());
+			}
+		}
+		return;
+	}
+	if (boundaryTracing)
+	{
+		traced.resize((size_t)width * height);
+		traceRect(0, 0, width, height, width, height, traced.data(), width);
+	}
 	for (int y = 0; y < height; y++) // y axis of the image	
 	{
+		if (boundaryTracing)
+			std::copy(traced.begin() + (size_t)y * width, traced.begin() + (size_t)(y + 1) * width, itrs.begin());
+		else
+			getIterationsRow(0, y, width, width, height, itrs.data()); // the whole row through the vector kernel
 		for (int x = 0; x < width; x++) // x axis of the image
 		{
-			int itr = 0;
-			Complex z, c;
-			c.a = getMappedScaleX((double)x, width);
-			c.b = getMappedScaleY((double)y, height);
-			while (z.real() * z.real() + z.imaginary() * z.imaginary() <= 2 * 2 && itr < MAX_ITR)
+			xs[x] = x;
+			ys[x] = y;
+			colors[x] = getPixelColor(itrs[x]);
+		}
+		putpixels(width, xs.data(), ys.data(), colors.data()); // one lock per row instead of one per pixel
+	}
+}
+
+// The escape-time kernels. Each one takes n points of a row (real parts cr, imaginary part ci) and stores how many iterations each took to escape. The
+// vector kernels follow the scalar one operation for operation (no fused multiply-add), so all of them give exactly the same counts. A lane that escapes is
+// masked out of the count; the lanes are iterated until every one of them has escaped or MAX_ITR is reached. (Building everything with -mfma or
+// -march=native lets the compiler fuse the scalar code too, and then a few points on the boundary of the set come out one iteration different.)
+typedef void (*RowKernel)(const double *, double, int, int *);
+RowKernel rowKernel = NULL;
+
+void rowScalar(const double *cr, double ci, int n, int *itrs)
+{
+	for (int i = 0; i < n; i++)
+	{
+		int itr = 0;
+		Complex z, c(cr[i], ci);
+		while (z.real() * z.real() + z.imaginary() * z.imaginary() <= 2 * 2 && itr < MAX_ITR)
+		{
+			evalMandel(z, c);
+			itr++;
+		}
+		itrs[i] = itr;
+	}
+}
+
+#ifdef MANDEL_X86
+MANDEL_TARGET("sse2") void rowSSE2(const double *cr, double ci, int n, int *itrs)
+{
+	const __m128d four = _mm_set1_pd(4), one = _mm_set1_pd(1), two = _mm_set1_pd(2), cI = _mm_set1_pd(ci);
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d cR = _mm_loadu_pd(cr + i), zr = _mm_setzero_pd(), zi = _mm_setzero_pd(), count = _mm_setzero_pd();
+		__m128d active = _mm_cmpeq_pd(count, count); // all lanes
+		for (int itr = 0; itr < MAX_ITR; itr++)
+		{
+			__m128d zr2 = _mm_mul_pd(zr, zr), zi2 = _mm_mul_pd(zi, zi);
+			active = _mm_and_pd(active, _mm_cmple_pd(_mm_add_pd(zr2, zi2), four));
+			if (_mm_movemask_pd(active) == 0)
+				break;
+			count = _mm_add_pd(count, _mm_and_pd(active, one));
+			__m128d zrNext = _mm_add_pd(_mm_sub_pd(zr2, zi2), cR);
+			zi = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, zr), zi), cI);
+			zr = zrNext;
+		}
+		double counts[2];
+		_mm_storeu_pd(counts, count);
+		for (int k = 0; k < 2; k++)
+			itrs[i + k] = (int)counts[k];
+	}
+	rowScalar(cr + i, ci, n - i, itrs + i);
+}
+
+MANDEL_TARGET("avx") void rowAVX(const double *cr, double ci, int n, int *itrs)
+{
+	const __m256d four = _mm256_set1_pd(4), one = _mm256_set1_pd(1), two = _mm256_set1_pd(2), cI = _mm256_set1_pd(ci);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d cR = _mm256_loadu_pd(cr + i), zr = _mm256_setzero_pd(), zi = _mm256_setzero_pd(), count = _mm256_setzero_pd();
+		__m256d active = _mm256_cmp_pd(count, count, _CMP_EQ_OQ); // all lanes
+		for (int itr = 0; itr < MAX_ITR; itr++)
+		{
+			__m256d zr2 = _mm256_mul_pd(zr, zr), zi2 = _mm256_mul_pd(zi, zi);
+			active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(zr2, zi2), four, _CMP_LE_OQ));
+			if (_mm256_movemask_pd(active) == 0)
+				break;
+			count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+			__m256d zrNext = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cR);
+			zi = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, zr), zi), cI);
+			zr = zrNext;
+		}
+		double counts[4];
+		_mm256_storeu_pd(counts, count);
+		for (int k = 0; k < 4; k++)
+			itrs[i + k] = (int)counts[k];
+	}
+	rowScalar(cr + i, ci, n - i, itrs + i);
+}
+
+MANDEL_TARGET("avx512f") void rowAVX512(const double *cr, double ci, int n, int *itrs)
+{
+	const __m512d four = _mm512_set1_pd(4), one = _mm512_set1_pd(1), two = _mm512_set1_pd(2), cI = _mm512_set1_pd(ci);
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m512d cR = _mm512_loadu_pd(cr + i), zr = _mm512_setzero_pd(), zi = _mm512_setzero_pd(), count = _mm512_setzero_pd();
+		__mmask8 active = 0xFF;
+		for (int itr = 0; itr < MAX_ITR; itr++)
+		{
+			__m512d zr2 = _mm512_mul_pd(zr, zr), zi2 = _mm512_mul_pd(zi, zi);
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(zr2, zi2), four, _CMP_LE_OQ);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_pd(count, active, count, one);
+			__m512d zrNext = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), cR);
+			zi = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, zr), zi), cI);
+			zr = zrNext;
+		}
+		double counts[8];
+		_mm512_storeu_pd(counts, count);
+		for (int k = 0; k < 8; k++)
+			itrs[i + k] = (int)counts[k];
+	}
+	rowScalar(cr + i, ci, n - i, itrs + i);
+}
+
+// Asks the processor (and, through xgetbv, the operating system) which of the kernels can run.
+bool cpuSupports(const char *isa)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	if (strcmp(isa, "sse2") == 0)
+		return (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	if (strcmp(isa, "avx") == 0)
+		return avx && (xcr0 & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6; // avx512f
+#else
+	__builtin_cpu_init();
+	if (strcmp(isa, "sse2") == 0)
+		return __builtin_cpu_supports("sse2");
+	if (strcmp(isa, "avx") == 0)
+		return __builtin_cpu_supports("avx");
+	return __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+
+// The environment variable MANDEL_KERNEL (scalar, sse2, avx or avx512) caps the choice, to compare the kernels against each other.
+const char *selectKernel()
+{
+	static const struct { const char *name, *isa; RowKernel kernel; } kernels[] =
+	{
+#ifdef MANDEL_X86
+		{ "avx512", "avx512f", rowAVX512 }, { "avx", "avx", rowAVX }, { "sse2", "sse2", rowSSE2 },
+#endif
+		{ "scalar", NULL, rowScalar }
+	};
+	const int nKernels = sizeof(kernels) / sizeof(kernels[0]);
+	const char *cap = getenv("MANDEL_KERNEL");
+	int k = 0;
+	while (cap != NULL && k < nKernels - 1 && strcmp(cap, kernels[k].name) != 0)
+		k++;
+	if (cap == NULL || strcmp(cap, kernels[k].name) != 0)
+		k = 0;
+#ifdef MANDEL_X86
+	while (k < nKernels - 1 && !cpuSupports(kernels[k].isa))
+		k++;
+#else
+	k = nKernels - 1;
+#endif
+	rowKernel = kernels[k].kernel;
+	return kernels[k].name;
+}
+
+// Deep zoom. Past a view width of about 1e-13 neighbouring pixels are no longer different doubles, so getMappedScaleX/Y cannot be used. Instead one
+// point, the centre C of the view, is iterated in high precision (the reference orbit Z_n, which is then rounded to doubles) and every pixel C + dc
+// only keeps track of its difference dz_n from it, which is small enough for doubles:
+//
+//		dz_n+1 = 2 Z_n dz_n + dz_n^2 + dc
+//
+// When the pixel's own orbit Z_n + dz_n comes closer to 0 than dz_n is big, or the reference orbit ends (it escaped), the difference would lose its
+// precision (a "glitch"); the pixel is then rebased: its orbit value becomes the new dz and it carries on from the start of the reference orbit
+// (Z_0 = 0). The only arithmetic that needs more than a double is the reference orbit, so the rest runs at close to the speed of plain doubles.
+// Widths down to about 1e-290 work before dc underflows.
+
+// A fixed-point number: limbs[0] is the integer part and the others are 32 bits of fraction each, most significant first.
+struct BigFixed
+{
+	std::vector<uint32_t> limbs;
+	bool negative;
+
+	BigFixed(int nLimbs = 1) : limbs(nLimbs, 0), negative(false) {}
+
+	double toDouble() const
+	{
+		double value = 0;
+		for (int i = (int)limbs.size() - 1; i >= 0; i--)
+			value += ldexp((double)limbs[i], -32 * i);
+		return negative ? -value : value;
+	}
+};
+
+int compareMagnitudes(const BigFixed &a, const BigFixed &b)
+{
+	for (size_t i = 0; i < a.limbs.size(); i++)
+		if (a.limbs[i] != b.limbs[i])
+			return a.limbs[i] < b.limbs[i] ? -1 : 1;
+	return 0;
+}
+
+BigFixed operator+(const BigFixed &a, const BigFixed &b)
+{
+	BigFixed r((int)a.limbs.size());
+	const BigFixed *big = &a, *small = &b;
+	if (a.negative != b.negative && compareMagnitudes(a, b) < 0)
+		std::swap(big, small);
+	r.negative = big->negative;
+	int64_t carry = 0;
+	for (int i = (int)r.limbs.size() - 1; i >= 0; i--)
+	{
+		int64_t sum = (int64_t)big->limbs[i] + (a.negative == b.negative ? (int64_t)small->limbs[i] : -(int64_t)small->limbs[i]) + carry;
+		carry = (sum < 0) ? -1 : (sum >> 32);
+		r.limbs[i] = (uint32_t)sum;
+	}
+	return r;
+}
+
+BigFixed operator-(const BigFixed &a)
+{
+	BigFixed r = a;
+	r.negative = !a.negative;
+	return r;
+}
+
+BigFixed operator*(const BigFixed &a, const BigFixed &b)
+{
+	const int n = (int)a.limbs.size();
+	std::vector<uint32_t> product(2 * n + 1, 0); // product[k + 1] has the weight of limb k
+	for (int i = n - 1; i >= 0; i--)
+	{
+		uint64_t carry = 0;
+		for (int j = n - 1; j >= 0; j--)
+		{
+			uint64_t t = (uint64_t)a.limbs[i] * b.limbs[j] + product[i + j + 1] + carry;
+			product[i + j + 1] = (uint32_t)t;
+			carry = t >> 32;
+		}
+		product[i] += (uint32_t)carry;
+	}
+	BigFixed r(n);
+	for (int k = 0; k < n; k++)
+		r.limbs[k] = product[k + 1]; // the lowest limbs are cut off
+	r.negative = a.negative != b.negative;
+	return r;
+}
+
+// Multiplies or divides by a small number, in place.
+void scaleBigFixed(BigFixed &v, const uint32_t &factor, const bool &divide)
+{
+	uint64_t carry = 0;
+	if (divide)
+		for (size_t i = 0; i < v.limbs.size(); i++)
+		{
+			uint64_t cur = (carry << 32) | v.limbs[i];
+			v.limbs[i] = (uint32_t)(cur / factor);
+			carry = cur % factor;
+		}
+	else
+		for (int i = (int)v.limbs.size() - 1; i >= 0; i--)
+		{
+			uint64_t t = (uint64_t)v.limbs[i] * factor + carry;
+			v.limbs[i] = (uint32_t)t;
+			carry = t >> 32;
+		}
+}
+
+// Reads a decimal number such as -1.7499999999999999999999e-3 to the full precision of nLimbs limbs.
+bool parseBigFixed(const char *text, const int &nLimbs, BigFixed &v)
+{
+	const char *p = text;
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		p++;
+	std::string digits;
+	int exponent = 0;
+	bool point = false;
+	for (; isdigit((unsigned char)*p) || (*p == '.' && !point); p++)
+	{
+		if (*p == '.')
+			point = true;
+		else
+		{
+			digits += *p;
+			if (!point)
+				exponent++; // the digits are read as 0.d1d2d3... times 10^exponent
+		}
+	}
+	if (*p == 'e' || *p == 'E')
+		exponent += atoi(++p);
+	else if (*p != '\0')
+		return false;
+	if (digits.empty())
+		return false;
+	v = BigFixed(nLimbs);
+	for (int i = (int)digits.size() - 1; i >= 0; i--) // Horner's rule from the last digit: 0.d_i... = (d_i + 0.d_i+1...) / 10
+	{
+		v.limbs[0] += digits[i] - '0';
+		scaleBigFixed(v, 10, true);
+	}
+	for (; exponent > 0; exponent--)
+		scaleBigFixed(v, 10, false);
+	for (; exponent < 0; exponent++)
+		scaleBigFixed(v, 10, true);
+	v.negative = negative;
+	return true;
+}
+
+bool setupDeepZoom(const char *re, const char *im, const double &viewWidth, const int &maxItr, const int &width)
+{
+	if (!(viewWidth > 0) || maxItr <= 0 || width <= 0)
+		return false;
+	// Enough fraction bits to tell pixels apart, and 64 more to keep the rounding of the orbit far below that
+	const int nLimbs = 1 + (int)ceil((log2(width / viewWidth) + 64) / 32);
+	BigFixed cr, ci;
+	if (!parseBigFixed(re, nLimbs, cr) || !parseBigFixed(im, nLimbs, ci))
+		return false;
+
+	auto start = std::chrono::steady_clock::now();
+	BigFixed zr(nLimbs), zi(nLimbs);
+	deepZoom.refRe.assign(1, 0.0);
+	deepZoom.refIm.assign(1, 0.0);
+	for (int n = 0; n < maxItr; n++)
+	{
+		BigFixed zr2 = zr * zr, zi2 = zi * zi, zrzi = zr * zi;
+		zi = zrzi + zrzi + ci;
+		zr = zr2 + (-zi2) + cr;
+		const double refRe = zr.toDouble(), refIm = zi.toDouble();
+		deepZoom.refRe.push_back(refRe);
+		deepZoom.refIm.push_back(refIm);
+		if (refRe * refRe + refIm * refIm > 4)
+			break;
+	}
+	deepZoom.active = true;
+	deepZoom.maxItr = maxItr;
+	deepZoom.pixelSize = viewWidth / width;
+	deepZoom.rebases = 0;
+	deepZoom.centreRe = cr.toDouble();
+	deepZoom.centreIm = ci.toDouble();
+	deepZoom.centreHash = 14695981039346656037ULL; // FNV-1a over "re,im"
+	for (const char *p : { re, ",", im })
+		for (; *p != '\0'; p++)
+			deepZoom.centreHash = (deepZoom.centreHash ^ (unsigned char)*p) * 1099511628211ULL;
+	printf("Reference orbit: %d iterations at %d bits in %.1f ms.\n", (int)deepZoom.refRe.size() - 1, 32 * nLimbs,
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return true;
+}
+
+void getIterationsRowDeep(const int &x0, const int &y, const int &count, const int &width, const int &height, int *itrs)
+{
+	const double *Zr = deepZoom.refRe.data(), *Zi = deepZoom.refIm.data();
+	const int last = (int)deepZoom.refRe.size() - 1;
+	const double dci = (y - height / 2.0) * deepZoom.pixelSize;
+	long long rebases = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const double dcr = (x0 + i - width / 2.0) * deepZoom.pixelSize;
+		double dzr = 0, dzi = 0;
+		int m = 0, itr = 0;
+		while (itr < deepZoom.maxItr)
+		{
+			// dz = (2 Z_m + dz) dz + dc
+			double tr = 2 * Zr[m] + dzr, ti = 2 * Zi[m] + dzi;
+			double nr = tr * dzr - ti * dzi + dcr;
+			dzi = tr * dzi + ti * dzr + dci;
+			dzr = nr;
+			m++;
+			itr++;
+			double zr = Zr[m] + dzr, zi = Zi[m] + dzi, z2 = zr * zr + zi * zi;
+			if (z2 > 4)
+				break;
+			if (z2 < dzr * dzr + dzi * dzi || m == last) // glitch, or the end of the reference: rebase
 			{
-				evalMandel(z, c);
-				itr++;
+				dzr = zr;
+				dzi = zi;
+				m = 0;
+				rebases++;
 			}
-			if (itr < MAX_ITR)
+		}
+		itrs[i] = itr;
+	}
+	deepZoom.rebases += rebases;
+}
+
+int getPixelColor(const int &itr)
+{
+	if (!deepZoom.active)
+		return (itr < MAX_ITR) ? BLACK : WHITE;
+	return (itr < deepZoom.maxItr) ? 1 + itr % 15 : BLACK; // bands of color, since at these depths nearly everything escapes eventually
+}
+
+void getIterationsRow(const int &x0, const int &y, const int &count, const int &width, const int &height, int *itrs)
+{
+	double cr[4096];
+	const double ci = getMappedScaleY((double)y, height);
+	if (deepZoom.active)
+	{
+		getIterationsRowDeep(x0, y, count, width, height, itrs);
+		return;
+	}
+	if (rowKernel == NULL)
+		selectKernel();
+	for (int done = 0; done < count; done += 4096)
+	{
+		const int n = std::min(4096, count - done);
+		for (int x = 0; x < n; x++)
+			cr[x] = getMappedScaleX((double)(x0 + done + x), width);
+		rowKernel(cr, ci, n, itrs + done);
+	}
+}
+
+// Boundary tracing (Mariani-Silver). The Mandelbrot set is connected and has no holes, so if every pixel on the border of a rectangle took the same
+// number of iterations, the pixels inside almost certainly did too (only filaments thinner than a pixel can slip through). The border is computed first;
+// if it is all one count the inside is filled in without iterating it, otherwise the rectangle is cut into four that share its middle row and column,
+// and each is handled the same way. Pixels that do have to be iterated skip the work where they can: points in the main cardioid or the period-2 bulb
+// are known to be inside, and an orbit that comes back to exactly a value it had before is periodic and will never escape. Both give the same counts
+// the plain loop would.
+struct RectTracer
+{
+	int x0, y0, width, height, stride;
+	int *itrs; // -1 until a pixel is computed
+	TraceStats stats;
+
+	int at(const int &x, const int &y)
+	{
+		int &itr = itrs[y * stride + x];
+		if (itr < 0)
+			itr = iterate(x0 + x, y0 + y);
+		return itr;
+	}
+
+	int iterate(const int &x, const int &y)
+	{
+		if (deepZoom.active)
+		{
+			int itr;
+			getIterationsRowDeep(x, y, 1, width, height, &itr);
+			return itr;
+		}
+		const Complex c(getMappedScaleX(x, width), getMappedScaleY(y, height));
+		const double q = (c.a - 0.25) * (c.a - 0.25) + c.b * c.b;
+		if (q * (q + (c.a - 0.25)) <= 0.25 * c.b * c.b || (c.a + 1) * (c.a + 1) + c.b * c.b <= 0.0625)
+		{
+			stats.rejected++;
+			return MAX_ITR;
+		}
+		Complex z, saved;
+		int itr = 0, period = 8, steps = 0;
+		while (z.real() * z.real() + z.imaginary() * z.imaginary() <= 2 * 2 && itr < MAX_ITR)
+		{
+			evalMandel(z, c);
+			itr++;
+			if (z.a == saved.a && z.b == saved.b)
+			{
+				stats.periodic++;
+				return MAX_ITR;
+			}
+			if (++steps == period) // Brent: compare against checkpoints that are further and further apart
+			{
+				saved = z;
+				steps = 0;
+				period *= 2;
+			}
+		}
+		return itr;
+	}
+
+	// left..right, top..bottom inclusive
+	void subdivide(const int &left, const int &top, const int &right, const int &bottom)
+	{
+		const int first = at(left, top);
+		bool same = true;
+		for (int x = left; x <= right; x++)
+			same = (at(x, top) == first) & (at(x, bottom) == first) & same;
+		for (int y = top + 1; y < bottom; y++)
+			same = (at(left, y) == first) & (at(right, y) == first) & same;
+
+		if (same)
+		{
+			for (int y = top + 1; y < bottom; y++)
+				for (int x = left + 1; x < right; x++)
+					itrs[y * stride + x] = first;
+			if (right - left > 1 && bottom - top > 1)
+				stats.skipped += (long long)(right - left - 1) * (bottom - top - 1);
+		}
+		else if (right - left < 6 || bottom - top < 6) // too small to be worth cutting up
+		{
+			for (int y = top + 1; y < bottom; y++)
+				for (int x = left + 1; x < right; x++)
+					at(x, y);
+		}
+		else
+		{
+			const int midX = (left + right) / 2, midY = (top + bottom) / 2;
+			subdivide(left, top, midX, midY);
+			subdivide(midX, top, right, midY);
+			subdivide(left, midY, midX, bottom);
+			subdivide(midX, midY, right, bottom);
+		}
+	}
+};
+
+void traceRect(const int &x0, const int &y0, const int &w, const int &h, const int &width, const int &height, int *itrs, const int &stride)
+{
+	RectTracer tracer = { x0, y0, width, height, stride, itrs, { 0, 0, 0 } };
+	for (int y = 0; y < h; y++)
+		std::fill(itrs + (size_t)y * stride, itrs + (size_t)y * stride + w, -1);
+	tracer.subdivide(0, 0, w - 1, h - 1);
+	tracedSkipped += tracer.stats.skipped;
+	tracedRejected += tracer.stats.rejected;
+	tracedPeriodic += tracer.stats.periodic;
+}
+
+// Progressive exploration. Each view is drawn in four passes: every 8th pixel of every 8th row first (shown as 8x8 blocks), then every 4th, 2nd and
+// finally every pixel, and the window is brought up to date after each pass, so there is something to look at almost at once. A key pressed in the
+// meantime cuts the remaining passes short. The iteration count of every pixel is kept; when the view moves, the counts of the pixels that are still in
+// it are carried over and only the rest are computed. A view is an offset in whole pixels and a zoom level (each level halves the pixel size), so a
+// pixel that is carried over is exactly the point it was before, and so is every other pixel after zooming in or out by 2.
+struct View
+{
+	long long ox, oy; // the pixel in the top left corner, counted in pixels of this level from the top left corner of the starting view
+	int level;
+};
+
+#define EXPLORE_MAX_LEVEL 40 // about where neighbouring pixels stop being different doubles; deeper views need the deep zoom mode
+
+double getViewX(const View &view, const long long &x, const int &width)
+{
+	return -2.5 + (view.ox + x) * ldexp(3.5 / width, -view.level);
+}
+
+double getViewY(const View &view, const long long &y, const int &height)
+{
+	return -1 + (view.oy + y) * ldexp(2.0 / height, -view.level);
+}
+
+// Where absolute pixel index i of level `level` is in a view of level `from` with offset o, or -1 if it is not one of its pixels.
+long long mapIndex(const long long &i, const int &level, const long long &o, const int &from)
+{
+	long long j;
+	if (from >= level)
+		j = i * (1LL << (from - level));
+	else if (i % (1LL << (level - from)) == 0)
+		j = i / (1LL << (level - from));
+	else
+		return -1;
+	return j - o;
+}
+
+// Copies the counts of the pixels of `old` that are also pixels of `view` and marks the rest -1.
+void reuseIterations(const View &old, const std::vector<int> &oldItrs, const View &view, std::vector<int> &itrs, const int &width, const int &height)
+{
+	std::vector<long long> oldX(width);
+	for (int x = 0; x < width; x++)
+		oldX[x] = mapIndex(view.ox + x, view.level, old.ox, old.level);
+	for (int y = 0; y < height; y++)
+	{
+		long long oldY = mapIndex(view.oy + y, view.level, old.oy, old.level);
+		for (int x = 0; x < width; x++)
+			itrs[(size_t)y * width + x] = (oldY >= 0 && oldY < height && oldX[x] >= 0 && oldX[x] < width) ? oldItrs[(size_t)oldY * width + oldX[x]] : -1;
+	}
+}
+
+// Computes the missing pixels of every step-th column of every step-th row, the rows shared out among all the cores. Returns how many there were.
+long long computePass(const View &view, const int &step, const int &width, const int &height, std::vector<int> &itrs)
+{
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::atomic<int> nextRow(0);
+	std::atomic<long long> computed(0);
+	auto worker = [&]()
+	{
+		std::vector<double> cr(width);
+		std::vector<int> columns(width), counts(width);
+		for (int row; (row = nextRow++ * step) < height;)
+		{
+			int n = 0;
+			for (int x = 0; x < width; x += step)
+				if (itrs[(size_t)row * width + x] < 0)
+				{
+					columns[n] = x;
+					cr[n++] = getViewX(view, x, width);
+				}
+			rowKernel(cr.data(), getViewY(view, row, height), n, counts.data());
+			for (int i = 0; i < n; i++)
+				itrs[(size_t)row * width + columns[i]] = counts[i];
+			computed += n;
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < nThreads; t++)
+		pool.emplace_back(worker);
+	worker();
+	for (auto &t : pool)
+		t.join();
+	return computed;
+}
+
+// Shows the view with each missing pixel taking the count of the last computed pixel above and to the left of it (a block of step x step pixels).
+void presentPass(const int &step, const int &width, const int &height, const std::vector<int> &itrs)
+{
+	unsigned int palette[16];
+	for (int color = 0; color < 16; color++)
+		palette[color] = bufferpixel(color);
+	int pitch = 0;
+	unsigned int *pixels = lockbuffer(&pitch);
+	for (int y = 0; y < height; y++)
+	{
+		const int *row = &itrs[(size_t)y * width], *block = &itrs[(size_t)(y & ~(step - 1)) * width];
+		for (int x = 0; x < width; x++)
+			pixels[(size_t)y * pitch + x] = palette[getPixelColor(row[x] >= 0 ? row[x] : block[x & ~(step - 1)])];
+	}
+	unlockbuffer(0, 0, width - 1, height - 1);
+	flushbgi();
+}
+
+void exploreMandelbrot(const int &width, const int &height)
+{
+	View view = { 0, 0, 0 }, shown = view;
+	std::vector<int> itrs((size_t)width * height, -1), shownItrs;
+	for (;;)
+	{
+		auto start = std::chrono::steady_clock::now();
+		long long computed = 0;
+		bool interrupted = false;
+		if (!shownItrs.empty())
+			reuseIterations(shown, shownItrs, view, itrs, width, height);
+		for (int step = 8; step >= 1 && !interrupted; step /= 2)
+		{
+			computed += computePass(view, step, width, height, itrs);
+			presentPass(step, width, height, itrs);
+			if (step == 8)
+				printf("First pass after %.1f ms.\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			interrupted = kbhit() != 0;
+		}
+		printf("%s after %.1f ms: %lld of %lld pixels computed, the rest carried over.\n", interrupted ? "Interrupted" : "Done",
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), computed, (long long)width * height);
+		shown = view;
+		shownItrs = itrs;
+
+		int key = getch();
+		if (key == 0) // an arrow key (or, without a window, the end of the input)
+		{
+			key = getch();
+			if (key == 0)
+				return;
+		}
+		switch (key)
+		{
+		case KEY_LEFT: case 'a': case 'A': view.ox -= width / 8; break;
+		case KEY_RIGHT: case 'd': case 'D': view.ox += width / 8; break;
+		case KEY_UP: case 'w': case 'W': view.oy -= height / 8; break;
+		case KEY_DOWN: case 's': case 'S': view.oy += height / 8; break;
+		case '+': case '=':
+			if (view.level < EXPLORE_MAX_LEVEL) // zoom in around the middle of the window
 			{
-				setcolor(BLACK);
-				putpixel(x, y, BLACK);
+				view.ox = 2 * (view.ox + width / 2) - width / 2;
+				view.oy = 2 * (view.oy + height / 2) - height / 2;
+				view.level++;
 			}
 			else
+				printf("Too deep for doubles; use the deep zoom mode.\n");
+			break;
+		case '-':
+			view.ox = (long long)floor((view.ox + width / 2) / 2.0) - width / 2;
+			view.oy = (long long)floor((view.oy + height / 2) / 2.0) - height / 2;
+			view.level--;
+			break;
+		case 'q': case 'Q': case 27:
+			return;
+		}
+	}
+}
+
+// The tile cache. The iteration counts of every tile rendered are kept in a file that is mapped into memory, so a view rendered before (by this run or
+// an earlier one) costs a page fault per tile instead of the iterations. A tile is identified by everything its counts depend on: the centre and scale of
+// the view (for deep zooms, also a hash of the exact digits of the centre), the resolution, the iteration limit, the mode and the position of the tile.
+// The file is a fixed number of slots, so its size is the cap. The slots are grouped in sets of CACHE_WAYS; a tile can only go in the set its key hashes
+// to, and when that set is full the least recently used tile in it is replaced. One program should use a cache file at a time.
+CacheSlot *getCacheSet(const uint32_t &set)
+{
+	return (CacheSlot *)(tileCache.base + sizeof(CacheHeader)) + (size_t)set * CACHE_WAYS;
+}
+
+bool openTileCache(const char *path, const size_t &megabytes)
+{
+	const uint32_t nSets = (uint32_t)std::max<size_t>(1, (megabytes << 20) / (sizeof(CacheSlot) * CACHE_WAYS));
+	const size_t size = sizeof(CacheHeader) + (size_t)nSets * CACHE_WAYS * sizeof(CacheSlot);
+#ifdef _WIN32
+	tileCache.file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (tileCache.file == INVALID_HANDLE_VALUE)
+		return false;
+	tileCache.mapping = CreateFileMappingA(tileCache.file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL); // grows the file with zeros
+	tileCache.base = tileCache.mapping ? (unsigned char *)MapViewOfFile(tileCache.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+	if (tileCache.base == NULL)
+	{
+		if (tileCache.mapping)
+			CloseHandle(tileCache.mapping);
+		CloseHandle(tileCache.file);
+		return false;
+	}
+#else
+	tileCache.file = open(path, O_RDWR | O_CREAT, 0644);
+	struct stat info;
+	if (tileCache.file < 0)
+		return false;
+	if (fstat(tileCache.file, &info) != 0 || ((size_t)info.st_size != size && ftruncate(tileCache.file, size) != 0)) // new space reads as zeros
+	{
+		close(tileCache.file);
+		return false;
+	}
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, tileCache.file, 0);
+	if (base == MAP_FAILED)
+	{
+		close(tileCache.file);
+		return false;
+	}
+	tileCache.base = (unsigned char *)base;
+#endif
+	tileCache.size = size;
+	tileCache.nSets = nSets;
+	CacheHeader *header = (CacheHeader *)tileCache.base;
+	if (header->magic != CACHE_MAGIC || header->nSets != nSets || header->ways != CACHE_WAYS || header->tileSize != TILE_SIZE || header->slotSize != sizeof(CacheSlot))
+	{
+		// A new file, or one laid out differently: forget whatever is in it
+		for (uint32_t set = 0; set < nSets; set++)
+			for (int way = 0; way < CACHE_WAYS; way++)
+				getCacheSet(set)[way].lastUsed = 0;
+		header->magic = CACHE_MAGIC;
+		header->nSets = nSets;
+		header->ways = CACHE_WAYS;
+		header->tileSize = TILE_SIZE;
+		header->slotSize = sizeof(CacheSlot);
+		header->clock = 0;
+	}
+	tileCache.clock = header->clock;
+	return true;
+}
+
+void closeTileCache()
+{
+	if (tileCache.base == NULL)
+		return;
+	((CacheHeader *)tileCache.base)->clock = tileCache.clock;
+#ifdef _WIN32
+	UnmapViewOfFile(tileCache.base);
+	CloseHandle(tileCache.mapping);
+	CloseHandle(tileCache.file);
+#else
+	munmap(tileCache.base, tileCache.size);
+	close(tileCache.file);
+#endif
+	tileCache.base = NULL;
+}
+
+CacheKey makeCacheKey(const int &x0, const int &y0, const int &width, const int &height)
+{
+	CacheKey key;
+	memset(&key, 0, sizeof(key)); // keys are compared byte for byte
+	if (deepZoom.active)
+	{
+		key.centreRe = deepZoom.centreRe;
+		key.centreIm = deepZoom.centreIm;
+		key.scaleX = key.scaleY = deepZoom.pixelSize;
+		key.centreHash = deepZoom.centreHash;
+	}
+	else
+	{
+		key.centreRe = getMappedScaleX(width, width) / 2 + getMappedScaleX(0, width) / 2;
+		key.centreIm = getMappedScaleY(height, height) / 2 + getMappedScaleY(0, height) / 2;
+		key.scaleX = 3.5 / width;
+		key.scaleY = 2.0 / height;
+	}
+	key.width = width;
+	key.height = height;
+	key.maxItr = deepZoom.active ? deepZoom.maxItr : MAX_ITR;
+	key.mode = (deepZoom.active ? 1 : 0) | (boundaryTracing ? 2 : 0); // tracing can miss a filament, so its tiles are kept apart
+	key.tileX = x0;
+	key.tileY = y0;
+	return key;
+}
+
+uint32_t getCacheSetIndex(const CacheKey &key)
+{
+	uint64_t hash = 14695981039346656037ULL; // FNV-1a
+	const unsigned char *bytes = (const unsigned char *)&key;
+	for (size_t i = 0; i < sizeof(key); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return (uint32_t)(hash % tileCache.nSets);
+}
+
+void computeTile(const int &x0, const int &y0, const int &w, const int &h, const int &width, const int &height, int *itrs, const int &stride)
+{
+	CacheKey key;
+	uint32_t set = 0;
+	if (tileCache.base != NULL)
+	{
+		key = makeCacheKey(x0, y0, width, height);
+		set = getCacheSetIndex(key);
+		std::lock_guard<std::mutex> guard(tileCache.setLocks[set % 64]);
+		CacheSlot *slots = getCacheSet(set);
+		for (int way = 0; way < CACHE_WAYS; way++)
+			if (slots[way].lastUsed != 0 && memcmp(&slots[way].key, &key, sizeof(key)) == 0)
 			{
-				setcolor(WHITE);
-				putpixel(x, y, WHITE);
+				slots[way].lastUsed = ++tileCache.clock;
+				for (int y = 0; y < h; y++)
+					memcpy(itrs + (size_t)y * stride, &slots[way].itrs[y * TILE_SIZE], w * sizeof(int));
+				tileCache.hits++;
+				return;
 			}
+		tileCache.misses++;
+	}
+
+	if (boundaryTracing)
+		traceRect(x0, y0, w, h, width, height, itrs, stride);
+	else
+		for (int y = 0; y < h; y++)
+			getIterationsRow(x0, y0 + y, w, width, height, itrs + (size_t)y * stride);
+
+	if (tileCache.base != NULL)
+	{
+		std::lock_guard<std::mutex> guard(tileCache.setLocks[set % 64]);
+		CacheSlot *slots = getCacheSet(set), *victim = &slots[0];
+		for (int way = 1; way < CACHE_WAYS; way++)
+			if (slots[way].lastUsed < victim->lastUsed)
+				victim = &slots[way];
+		if (victim->lastUsed != 0)
+			tileCache.evictions++;
+		victim->key = key;
+		for (int y = 0; y < h; y++)
+			memcpy(&victim->itrs[y * TILE_SIZE], itrs + (size_t)y * stride, w * sizeof(int));
+		victim->lastUsed = ++tileCache.clock;
+	}
+}
+
+// The tiles go to the threads in order, from a shared counter. Each one is computed first and only then mapped, colored and unmapped, so the file is
+// mapped only for as long as it takes to copy a tile into it.
+bool drawMandelbrotToImage(const int &width, const int &height, const char *path, const bool &multithreaded)
+{
+	const int image = createimagemapbgi(path, width, height);
+	if (image < 0)
+		return false;
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE, nTiles = tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE);
+	const int nThreads = multithreaded ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	unsigned int palette[16];
+	for (int color = 0; color < 16; color++)
+		palette[color] = imagemappixel(color);
+	std::atomic<int> next(0);
+	std::atomic<bool> failed(false);
+	auto worker = [&]()
+	{
+		std::vector<int> itrs(TILE_SIZE * TILE_SIZE);
+		for (int tile = next++; tile < nTiles && !failed; tile = next++)
+		{
+			const int x0 = tile % tilesX * TILE_SIZE, y0 = tile / tilesX * TILE_SIZE;
+			const int w = std::min(TILE_SIZE, width - x0), h = std::min(TILE_SIZE, height - y0);
+			computeTile(x0, y0, w, h, width, height, itrs.data(), TILE_SIZE);
+			int pitch = 0;
+			unsigned int *pixels = lockimagetile(image, x0, y0, x0 + w - 1, y0 + h - 1, &pitch);
+			if (pixels == NULL)
+			{
+				failed = true;
+				return;
+			}
+			for (int y = 0; y < h; y++)
+				for (int x = 0; x < w; x++)
+					pixels[(size_t)y * pitch + x] = palette[getPixelColor(itrs[y * TILE_SIZE + x])];
+			unlockimagetile(image, pixels);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back(worker);
+	for (auto &thread : pool)
+		thread.join();
+	return closeimagemapbgi(image) && !failed;
+}
+
+// Each worker of the tile pool owns a run of tiles [begin, end). Both ends are packed into one atomic word, so the owner (taking tiles from the front) and
+// thieves (taking the back half) can update it with a single compare-and-swap and no lock.
+uint64_t packRange(uint32_t begin, uint32_t end)
+{
+	return ((uint64_t)begin << 32) | end;
+}
+
+bool popTile(std::atomic<uint64_t> &range, uint32_t &tile)
+{
+	uint64_t old = range.load();
+	for (;;)
+	{
+		uint32_t begin = (uint32_t)(old >> 32), end = (uint32_t)old;
+		if (begin >= end)
+			return false;
+		if (range.compare_exchange_weak(old, packRange(begin + 1, end)))
+		{
+			tile = begin;
+			return true;
+		}
+	}
+}
+
+bool stealTiles(std::atomic<uint64_t> &victim, std::atomic<uint64_t> &mine)
+{
+	uint64_t old = victim.load();
+	for (;;)
+	{
+		uint32_t begin = (uint32_t)(old >> 32), end = (uint32_t)old;
+		if (begin >= end)
+			return false;
+		uint32_t mid = end - (end - begin + 1) / 2; // the back half, at least one tile
+		if (victim.compare_exchange_weak(old, packRange(begin, mid)))
+		{
+			mine.store(packRange(mid, end)); // only its owner ever refills an empty run
+			return true;
 		}
 	}
 }
 
 void drawMandelbrotMT(const int &width, const int &height)
 {
-	size_t nThreads = std::thread::hardware_concurrency();
-#pragma omp parallel num_threads(nThreads)
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE, tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	const uint32_t nTiles = tilesX * tilesY;
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	int pitch = 0;
+	unsigned int palette[16];
+	for (int color = 0; color < 16; color++)
+		palette[color] = bufferpixel(color);
+	unsigned int *pixels = lockbuffer(&pitch); // finished tiles are copied straight into the page
+
+	std::vector<std::atomic<uint64_t>> ranges(nThreads);
+	for (int w = 0; w < nThreads; w++) // deal the tiles out in runs of neighbours
+		ranges[w].store(packRange((uint32_t)((uint64_t)nTiles * w / nThreads), (uint32_t)((uint64_t)nTiles * (w + 1) / nThreads)));
+	std::vector<double> tileMs(nTiles), busyMs(nThreads);
+	std::vector<int> tilesDone(nThreads), steals(nThreads);
+
+	auto worker = [&](int id)
 	{
-#pragma omp for schedule(dynamic, 1)
-		for (int y = 0; y < height; y++) // y axis of the image	
+		std::vector<unsigned int> tileBuffer(TILE_SIZE * TILE_SIZE);
+		std::vector<int> tileItrs(TILE_SIZE * TILE_SIZE);
+		uint32_t tile;
+		for (;;)
 		{
-			for (int x = 0; x < width; x++) // x axis of the image
+			if (!popTile(ranges[id], tile))
 			{
-				int itr = 0;
-				Complex z, c;
-				c.a = getMappedScaleX((double)x, width);
-				c.b = getMappedScaleY((double)y, height);
-				while (z.real() * z.real() + z.imaginary() * z.imaginary() <= 2 * 2 && itr < MAX_ITR)
-				{
-					evalMandel(z, c);
-					itr++;
-				}
-				if (itr < MAX_ITR)
-				{
-					setcolor(BLACK);
-					putpixel(x, y, BLACK);
-				}
-				else
-				{
-					setcolor(WHITE);
-					putpixel(x, y, WHITE);
-				}
+				bool stolen = false;
+				for (int i = 1; i < nThreads && !stolen; i++)
+					stolen = stealTiles(ranges[(id + i) % nThreads], ranges[id]);
+				if (!stolen)
+					break; // every run is empty
+				steals[id]++;
+				continue;
 			}
+
+			auto start = std::chrono::steady_clock::now();
+			const int x0 = (tile % tilesX) * TILE_SIZE, y0 = (tile / tilesX) * TILE_SIZE;
+			const int w = std::min(TILE_SIZE, width - x0), h = std::min(TILE_SIZE, height - y0);
+			computeTile(x0, y0, w, h, width, height, tileItrs.data(), TILE_SIZE);
+			for (int y = 0; y < h; y++)
+				for (int x = 0; x < w; x++)
+					tileBuffer[y * TILE_SIZE + x] = palette[getPixelColor(tileItrs[y * TILE_SIZE + x])];
+			for (int y = 0; y < h; y++) // commit the finished tile in one blit
+				memcpy(pixels + (size_t)(y0 + y) * pitch + x0, &tileBuffer[y * TILE_SIZE], w * sizeof(unsigned int));
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			tileMs[tile] = ms;
+			busyMs[id] += ms;
+			tilesDone[id]++;
 		}
+	};
+	std::vector<std::thread> pool;
+	for (int w = 1; w < nThreads; w++)
+		pool.emplace_back(worker, w);
+	worker(0);
+	for (auto &t : pool)
+		t.join();
+	unlockbuffer(0, 0, width - 1, height - 1);
+
+	// Tile timings: one character per tile, darker is slower.
+	const char shades[] = " .:-=+*#%@";
+	double maxMs = *std::max_element(tileMs.begin(), tileMs.end()), sumMs = 0, maxBusy = 0;
+	for (double ms : tileMs)
+		sumMs += ms;
+	printf("%u tiles of %dx%d on %d workers; tile time mean %.2f ms, max %.2f ms\n", nTiles, TILE_SIZE, TILE_SIZE, nThreads, sumMs / nTiles, maxMs);
+	for (int ty = 0; ty < tilesY && tilesX <= 120; ty++)
+	{
+		for (int tx = 0; tx < tilesX; tx++)
+			putchar(shades[maxMs > 0 ? (int)(tileMs[ty * tilesX + tx] / maxMs * 9) : 0]);
+		putchar('\n');
+	}
+	for (int w = 0; w < nThreads; w++)
+	{
+		printf("worker %2d: %4d tiles, %3d steals, busy %8.1f ms\n", w, tilesDone[w], steals[w], busyMs[w]);
+		maxBusy = std::max(maxBusy, busyMs[w]);
 	}
-}
\ No newline at end of file
+	printf("load balance (mean busy / max busy): %.3f\n", sumMs / nThreads / maxBusy);
+}
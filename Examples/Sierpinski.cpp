@@ -15,7 +15,6 @@ For more information on the Sierpinski triangle, please visit https://en.wikiped
 #include <iostream>
 #include <cmath>
 #include <chrono>
-#include "windows.h"
 #include "graphics.h"
 #include "colors.h"
 #include "primitives.h"
@@ -0,0 +1,606 @@
+/*
+
+The following program renders the Mandelbrot set (see Mandelbrot.cpp) at sizes far too large for a window, such as posters of 30000 x 20000 pixels and more,
+straight into a BMP file. The image is cut into tiles of TILE_SIZE x TILE_SIZE pixels, and the tiles are handed out to a number of worker processes (the
+program starting copies of itself) over pipes. Each worker computes the tiles it is sent with the same per-pixel loop as Mandelbrot.cpp and sends the pixels
+back, and every finished tile is written into its place in the file at once, so neither the driver nor any worker ever holds more than a few tiles in memory.
+
+If a worker dies, the tile it was working on goes back into the queue and the worker is started again; a worker that dies MAX_RESTARTS times in a row
+without finishing a tile is given up, and its tiles are left to the others. On Linux, "numa" starts one worker per NUMA node, bound to the processors of its
+node and using all of them, so that each worker's memory stays on its own node.
+
+The BMP is one byte a pixel, but a BMP cannot be larger than 4 GB (its sizes are 32 bits), which is about 65000 x 65000 pixels. For anything larger, name
+the output .pam: it is then written as a PAM image through the memory-mapped image files of the library (see createimagemapbgi in graphics.h), which
+have no such limit but take four bytes a pixel.
+
+Usage:
+	TileFarm [width height] [workers | numa] [output.bmp | output.pam]
+for example
+	TileFarm 30000 20000 numa poster.bmp
+	TileFarm 100000 80000 numa poster.pam
+Setting the environment variable TILEFARM_CRASH_AFTER to n makes every worker crash after n tiles, to watch the recovery.
+
+*/
+
+#define NOMINMAX // windows.h would otherwise define min and max macros
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "graphics.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#define fseek64 _fseeki64
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#define fseek64 fseeko
+#endif
+
+#define MAX_ITR 500
+#define TILE_SIZE 256
+#define MAX_RESTARTS 3 // times in a row a worker may die before it is given up
+#define BMP_HEADER 62 // file header, info header and a palette of two colors
+
+struct Complex // class to support Complex numbers
+{
+	double a;
+	double b;
+
+	Complex() : a(0), b(0) {}
+	Complex(double a_, double b_) : a(a_), b(b_) {}
+
+	double real() const
+	{
+		return a;
+	}
+
+	double imaginary() const
+	{
+		return b;
+	}
+};
+
+struct Tile // a rectangle of the image; also the request and the header of the reply between driver and worker
+{
+	int32_t x0, y0, w, h;
+};
+
+struct Process // a running worker and the pipes to it
+{
+#ifdef _WIN32
+	HANDLE process, toWorker, fromWorker;
+#else
+	pid_t pid;
+	int toWorker, fromWorker;
+#endif
+};
+
+struct Farm // what the driver threads share
+{
+	std::mutex mutex; // guards everything up to the output file
+	std::condition_variable changed;
+	std::deque<Tile> queue; // tiles nobody has taken yet
+	int inFlight; // tiles taken but not finished
+	int done, total, crashes, restarts, givenUp;
+
+	std::mutex fileMutex; // guards the output file
+	FILE *out; // the BMP, or NULL if the output is a PAM image
+	int image; // the PAM image (see createimagemapbgi), or -1 if the output is a BMP
+	bool writeFailed; // a tile could not be written (a seek or write of the BMP, or mapping the PAM), say because the disk is full: the BMP header only made the file sparse
+	int width, height, stride;
+
+	std::string self; // the program, for starting workers
+	int workerThreads; // threads in each worker
+	std::vector<std::vector<int>> cpus; // the processors each worker is bound to (empty if not bound)
+};
+
+double getMappedScaleX(const int &, const int &); // maps a pixel to the complex plane as in Mandelbrot.cpp
+double getMappedScaleY(const int &, const int &);
+void evalMandel(Complex &, const Complex &); // one step of z = z^2 + c
+void computeTile(const Tile &, const int &, const int &, const int &, unsigned char *); // the colors of one tile, one byte per pixel
+int runWorker(const int &, const int &, const int &); // the worker: computes the tiles that arrive on stdin until it closes
+std::vector<std::vector<int>> getNumaNodes(); // the processors of each NUMA node (empty if there is only one, or we cannot tell)
+bool startWorker(Farm &, const int &, Process &);
+void stopWorker(Process &, const bool &); // closes the pipes and waits for the worker, killing it first if asked
+bool writeAll(Process &, const void *, const size_t &);
+bool readAll(Process &, void *, const size_t &);
+bool writeBmpHeader(FILE *, const int &, const int &);
+void writeTile(Farm &, const Tile &, const unsigned char *);
+void driveWorker(Farm &, const int &); // keeps one worker busy until the queue is empty
+
+int main(int argc, char **argv)
+{
+	if (argc == 5 && strcmp(argv[1], "--worker") == 0)
+		return runWorker(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+
+	int width = 4000, height = 2500, nWorkers = std::max(1u, std::thread::hardware_concurrency());
+	const char *path = "mandelbrot.bmp";
+	Farm farm;
+	int arg = 1;
+	if (arg + 1 < argc && isdigit((unsigned char)argv[arg][0]))
+	{
+		width = atoi(argv[arg++]);
+		height = atoi(argv[arg++]);
+	}
+	farm.workerThreads = 1;
+	if (arg < argc && strcmp(argv[arg], "numa") == 0)
+	{
+		farm.cpus = getNumaNodes();
+		if (farm.cpus.empty())
+			printf("No NUMA nodes found; using one worker per processor.\n");
+		else
+		{
+			nWorkers = (int)farm.cpus.size();
+			for (const std::vector<int> &node : farm.cpus)
+				farm.workerThreads = std::max(farm.workerThreads, (int)node.size());
+		}
+		arg++;
+	}
+	else if (arg < argc && isdigit((unsigned char)argv[arg][0]))
+		nWorkers = atoi(argv[arg++]);
+	if (arg < argc)
+		path = argv[arg++];
+	if (width <= 0 || height <= 0 || nWorkers <= 0)
+	{
+		printf("Invalid choice! Aborting...\n");
+		exit(EXIT_FAILURE);
+	}
+
+#ifdef _WIN32
+	char self[MAX_PATH];
+	GetModuleFileNameA(NULL, self, MAX_PATH);
+	farm.self = self;
+#else
+	signal(SIGPIPE, SIG_IGN); // a dead worker shows up as a failed write instead
+	char self[4096];
+	const ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	farm.self = (length > 0) ? std::string(self, length) : argv[0];
+#endif
+
+	farm.width = width;
+	farm.height = height;
+	farm.stride = (width + 3) & ~3; // BMP rows are padded to four bytes
+	const size_t pathLength = strlen(path);
+	const bool pam = pathLength >= 4 && strcmp(path + pathLength - 4, ".pam") == 0;
+	farm.out = NULL;
+	farm.image = -1;
+	if (pam)
+	{
+		farm.image = createimagemapbgi(path, width, height);
+		if (farm.image < 0)
+		{
+			printf("Cannot write a %d x %d PAM image to %s.\n", width, height, path);
+			exit(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		if (BMP_HEADER + (uint64_t)farm.stride * height > 0xFFFFFFFFu)
+		{
+			printf("A %d x %d BMP would be larger than the 4 GB a BMP can be; name the output .pam to write a PAM image instead.\n", width, height);
+			exit(EXIT_FAILURE);
+		}
+		farm.out = fopen(path, "wb");
+		if (farm.out == NULL || !writeBmpHeader(farm.out, width, height))
+		{
+			printf("Cannot write a %d x %d BMP to %s.\n", width, height, path);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int y0 = 0; y0 < height; y0 += TILE_SIZE)
+		for (int x0 = 0; x0 < width; x0 += TILE_SIZE)
+			farm.queue.push_back({ x0, y0, std::min(TILE_SIZE, width - x0), std::min(TILE_SIZE, height - y0) });
+	farm.inFlight = farm.done = farm.crashes = farm.restarts = farm.givenUp = 0;
+	farm.writeFailed = false;
+	farm.total = (int)farm.queue.size();
+
+	printf("%d x %d pixels in %d tiles, %d workers of %d threads, writing %s.\n", width, height, farm.total, nWorkers, farm.workerThreads, path);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> drivers;
+	for (int w = 0; w < nWorkers; w++)
+		drivers.emplace_back(driveWorker, std::ref(farm), w);
+	for (auto &driver : drivers)
+		driver.join();
+	auto stop = std::chrono::steady_clock::now();
+	bool written;
+	if (pam)
+		written = closeimagemapbgi(farm.image) && !farm.writeFailed;
+	else
+	{
+		written = !farm.writeFailed && fflush(farm.out) == 0;
+		written = fclose(farm.out) == 0 && written;
+	}
+
+	const double seconds = std::chrono::duration<double>(stop - start).count();
+	printf("\n%d of %d tiles in %.2f s (%.1f million pixels/s); %d workers died, %d restarted, %d given up.\n", farm.done, farm.total, seconds,
+		(double)width * height / seconds / 1e6, farm.crashes, farm.restarts, farm.givenUp);
+	if (farm.done < farm.total)
+	{
+		printf("Every worker was given up; the image is incomplete.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!written)
+	{
+		printf("Writing %s failed (is the disk full?); the image is incomplete.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+double getMappedScaleX(const int &x, const int &xMax)
+{
+	return ((x / (double) xMax) * 3.5) - 2.5;
+}
+
+double getMappedScaleY(const int &y, const int &yMax)
+{
+	return ((y / (double) yMax) * 2) - 1;
+}
+
+void evalMandel(Complex &z, const Complex &c)
+{
+	double zReal = z.a;
+	double zImaginary = z.b;
+	z.a = zReal * zReal - zImaginary * zImaginary + c.a;
+	z.b = 2 * zReal * zImaginary + c.b;
+}
+
+void computeTile(const Tile &tile, const int &width, const int &height, const int &nThreads, unsigned char *pixels)
+{
+	auto rows = [&](const int &begin, const int &end)
+	{
+		for (int y = begin; y < end; y++)
+			for (int x = 0; x < tile.w; x++)
+			{
+				int itr = 0;
+				Complex z, c(getMappedScaleX(tile.x0 + x, width), getMappedScaleY(tile.y0 + y, height));
+				while (z.real() * z.real() + z.imaginary() * z.imaginary() <= 2 * 2 && itr < MAX_ITR)
+				{
+					evalMandel(z, c);
+					itr++;
+				}
+				pixels[(size_t)y * tile.w + x] = (itr < MAX_ITR) ? 0 : 1; // palette entries: black outside, white inside
+			}
+	};
+	if (nThreads <= 1)
+	{
+		rows(0, tile.h);
+		return;
+	}
+	std::vector<std::thread> pool;
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back(rows, tile.h * t / nThreads, tile.h * (t + 1) / nThreads);
+	for (auto &thread : pool)
+		thread.join();
+}
+
+int runWorker(const int &width, const int &height, const int &nThreads)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	const char *crash = getenv("TILEFARM_CRASH_AFTER");
+	const int crashAfter = (crash != NULL) ? atoi(crash) : 0;
+	std::vector<unsigned char> pixels((size_t)TILE_SIZE * TILE_SIZE);
+	Tile tile;
+	for (int n = 1; fread(&tile, sizeof(tile), 1, stdin) == 1; n++)
+	{
+		if (tile.w <= 0 || tile.h <= 0 || tile.w > TILE_SIZE || tile.h > TILE_SIZE)
+			return EXIT_FAILURE;
+		if (crashAfter > 0 && n > crashAfter)
+			abort();
+		computeTile(tile, width, height, nThreads, pixels.data());
+		if (fwrite(&tile, sizeof(tile), 1, stdout) != 1 || fwrite(pixels.data(), 1, (size_t)tile.w * tile.h, stdout) != (size_t)tile.w * tile.h)
+			return EXIT_FAILURE;
+		fflush(stdout);
+	}
+	return 0;
+}
+
+std::vector<std::vector<int>> getNumaNodes()
+{
+	std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+	for (int node = 0; ; node++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "/sys/devices/system/node/node%d/cpulist", node);
+		FILE *file = fopen(name, "r");
+		if (file == NULL)
+			break;
+		std::vector<int> cpus;
+		int first = 0, last = 0;
+		char separator = 0;
+		while (fscanf(file, "%d", &first) == 1) // a list like 0-3,8-11
+		{
+			last = first;
+			if (fscanf(file, "%c", &separator) == 1 && separator == '-')
+				fscanf(file, "%d%c", &last, &separator);
+			for (int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		fclose(file);
+		if (!cpus.empty())
+			nodes.push_back(cpus);
+	}
+#endif
+	if (nodes.size() < 2)
+		nodes.clear();
+	return nodes;
+}
+
+std::mutex spawnMutex; // so that no worker inherits the pipes of another one being started at the same time
+
+bool startWorker(Farm &farm, const int &slot, Process &process)
+{
+	const std::string width = std::to_string(farm.width), height = std::to_string(farm.height), threads = std::to_string(farm.workerThreads);
+	std::lock_guard<std::mutex> guard(spawnMutex);
+#ifdef _WIN32
+	SECURITY_ATTRIBUTES inherit = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+	HANDLE childIn, childOut;
+	if (!CreatePipe(&childIn, &process.toWorker, &inherit, 0))
+		return false;
+	if (!CreatePipe(&process.fromWorker, &childOut, &inherit, 0))
+	{
+		CloseHandle(childIn);
+		CloseHandle(process.toWorker);
+		return false;
+	}
+	SetHandleInformation(process.toWorker, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(process.fromWorker, HANDLE_FLAG_INHERIT, 0);
+	STARTUPINFOA startup = { sizeof(STARTUPINFOA) };
+	startup.dwFlags = STARTF_USESTDHANDLES;
+	startup.hStdInput = childIn;
+	startup.hStdOutput = childOut;
+	startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+	PROCESS_INFORMATION info;
+	std::string command = "\"" + farm.self + "\" --worker " + width + " " + height + " " + threads;
+	const bool started = CreateProcessA(NULL, &command[0], NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info) != 0;
+	CloseHandle(childIn);
+	CloseHandle(childOut);
+	if (!started)
+	{
+		CloseHandle(process.toWorker);
+		CloseHandle(process.fromWorker);
+		return false;
+	}
+	CloseHandle(info.hThread);
+	process.process = info.hProcess;
+	return true;
+#else
+	int toWorker[2], fromWorker[2];
+	if (pipe(toWorker) != 0)
+		return false;
+	if (pipe(fromWorker) != 0)
+	{
+		close(toWorker[0]);
+		close(toWorker[1]);
+		return false;
+	}
+	fcntl(toWorker[1], F_SETFD, FD_CLOEXEC); // our ends must not stay open in other workers, or a dead worker's pipe would never close
+	fcntl(fromWorker[0], F_SETFD, FD_CLOEXEC);
+	process.pid = fork();
+	if (process.pid == 0)
+	{
+#ifdef __linux__
+		if (!farm.cpus.empty())
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for (int cpu : farm.cpus[slot % farm.cpus.size()])
+				CPU_SET(cpu, &set);
+			sched_setaffinity(0, sizeof(set), &set);
+		}
+#endif
+		dup2(toWorker[0], 0);
+		dup2(fromWorker[1], 1);
+		close(toWorker[0]);
+		close(fromWorker[1]);
+		execl(farm.self.c_str(), farm.self.c_str(), "--worker", width.c_str(), height.c_str(), threads.c_str(), (char *)NULL);
+		_exit(127);
+	}
+	close(toWorker[0]);
+	close(fromWorker[1]);
+	if (process.pid < 0)
+	{
+		close(toWorker[1]);
+		close(fromWorker[0]);
+		return false;
+	}
+	process.toWorker = toWorker[1];
+	process.fromWorker = fromWorker[0];
+	return true;
+#endif
+}
+
+void stopWorker(Process &process, const bool &kill)
+{
+#ifdef _WIN32
+	if (kill)
+		TerminateProcess(process.process, 1);
+	CloseHandle(process.toWorker); // a healthy worker sees the end of its input and exits
+	CloseHandle(process.fromWorker);
+	WaitForSingleObject(process.process, INFINITE);
+	CloseHandle(process.process);
+#else
+	if (kill)
+		::kill(process.pid, SIGKILL);
+	close(process.toWorker);
+	close(process.fromWorker);
+	waitpid(process.pid, NULL, 0);
+#endif
+}
+
+bool writeAll(Process &process, const void *data, const size_t &size)
+{
+	const char *p = (const char *)data;
+	for (size_t written = 0; written < size; )
+	{
+#ifdef _WIN32
+		DWORD n = 0;
+		if (!WriteFile(process.toWorker, p + written, (DWORD)(size - written), &n, NULL) || n == 0)
+			return false;
+#else
+		const ssize_t n = write(process.toWorker, p + written, size - written);
+		if (n <= 0)
+			return false;
+#endif
+		written += n;
+	}
+	return true;
+}
+
+bool readAll(Process &process, void *data, const size_t &size)
+{
+	char *p = (char *)data;
+	for (size_t got = 0; got < size; )
+	{
+#ifdef _WIN32
+		DWORD n = 0;
+		if (!ReadFile(process.fromWorker, p + got, (DWORD)(size - got), &n, NULL) || n == 0)
+			return false;
+#else
+		const ssize_t n = read(process.fromWorker, p + got, size - got);
+		if (n <= 0)
+			return false;
+#endif
+		got += n;
+	}
+	return true;
+}
+
+bool writeBmpHeader(FILE *out, const int &width, const int &height)
+{
+	const uint64_t fileSize = BMP_HEADER + (uint64_t)((width + 3) & ~3) * height;
+	if (fileSize > 0xFFFFFFFFu) // sizes in a BMP are 32 bits
+		return false;
+	const uint32_t fields[] = { (uint32_t)fileSize, 0, BMP_HEADER, 40, (uint32_t)width, (uint32_t)height, 1 | (8 << 16), 0, 0, 2835, 2835, 2, 2 };
+	unsigned char header[BMP_HEADER] = { 'B', 'M' };
+	for (int i = 0; i < 13; i++) // little endian, after the "BM"
+		for (int b = 0; b < 4; b++)
+			header[2 + 4 * i + b] = (unsigned char)(fields[i] >> (8 * b));
+	const unsigned char palette[8] = { 0, 0, 0, 0, 255, 255, 255, 0 }; // black, white
+	memcpy(header + 54, palette, sizeof(palette));
+	if (fwrite(header, 1, BMP_HEADER, out) != BMP_HEADER)
+		return false;
+	// Make the file its full size now; the tiles are written into it in whatever order they finish
+	return fseek64(out, fileSize - 1, SEEK_SET) == 0 && fputc(0, out) != EOF && fflush(out) == 0;
+}
+
+void writeTile(Farm &farm, const Tile &tile, const unsigned char *pixels)
+{
+	if (farm.image >= 0) // the image maps each tile on its own, and takes its own lock
+	{
+		static const unsigned int colors[2] = { imagemappixel(BLACK), imagemappixel(WHITE) }; // the two entries of the BMP palette
+		int pitch = 0;
+		unsigned int *out = lockimagetile(farm.image, tile.x0, tile.y0, tile.x0 + tile.w - 1, tile.y0 + tile.h - 1, &pitch);
+		if (out == NULL)
+		{
+			std::lock_guard<std::mutex> guard(farm.fileMutex);
+			farm.writeFailed = true;
+			return;
+		}
+		for (int y = 0; y < tile.h; y++)
+			for (int x = 0; x < tile.w; x++)
+				out[(size_t)y * pitch + x] = colors[pixels[(size_t)y * tile.w + x]];
+		unlockimagetile(farm.image, out);
+		return;
+	}
+	std::lock_guard<std::mutex> guard(farm.fileMutex);
+	for (int y = 0; y < tile.h && !farm.writeFailed; y++) // BMP rows go from the bottom up
+	{
+		farm.writeFailed = fseek64(farm.out, BMP_HEADER + (int64_t)(farm.height - 1 - tile.y0 - y) * farm.stride + tile.x0, SEEK_SET) != 0 ||
+			fwrite(pixels + (size_t)y * tile.w, 1, tile.w, farm.out) != (size_t)tile.w;
+	}
+}
+
+void driveWorker(Farm &farm, const int &slot)
+{
+	std::vector<unsigned char> pixels((size_t)TILE_SIZE * TILE_SIZE);
+	Process process;
+	bool running = false;
+	int failures = 0;
+	while (true)
+	{
+		Tile tile;
+		{
+			std::unique_lock<std::mutex> lock(farm.mutex);
+			farm.changed.wait(lock, [&]() { return !farm.queue.empty() || farm.inFlight == 0; }); // a tile in flight may still come back
+			if (farm.queue.empty())
+				break;
+			tile = farm.queue.front();
+			farm.queue.pop_front();
+			farm.inFlight++;
+		}
+
+		bool ok = false, died = false, restarted = false;
+		if (!running)
+		{
+			running = startWorker(farm, slot, process);
+			if (!running)
+				failures = MAX_RESTARTS + 1; // it cannot be started at all
+			restarted = running && failures > 0;
+		}
+		if (running)
+		{
+			Tile reply;
+			ok = writeAll(process, &tile, sizeof(tile)) && readAll(process, &reply, sizeof(reply)) &&
+				memcmp(&reply, &tile, sizeof(tile)) == 0 && readAll(process, pixels.data(), (size_t)tile.w * tile.h);
+			if (ok)
+			{
+				writeTile(farm, tile, pixels.data());
+				failures = 0;
+			}
+			else
+			{
+				stopWorker(process, true);
+				running = false;
+				died = true;
+				failures++;
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(farm.mutex);
+		farm.inFlight--;
+		farm.crashes += died;
+		farm.restarts += restarted;
+		if (ok)
+		{
+			farm.done++;
+			if (farm.done * 100LL / farm.total != (farm.done - 1) * 100LL / farm.total)
+			{
+				printf("\r%d%%", (int)(farm.done * 100LL / farm.total));
+				fflush(stdout);
+			}
+		}
+		else
+			farm.queue.push_front(tile); // first in line for whoever is free
+		farm.changed.notify_all();
+		if (failures > MAX_RESTARTS)
+		{
+			farm.givenUp++;
+			return;
+		}
+	}
+	if (running)
+		stopWorker(process, false);
+}
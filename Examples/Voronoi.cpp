@@ -1,15 +1,45 @@
 /*
 	The following program renders the Voronoi diagram. It uses the Delaunay triangulation as an intermediate step.
-	The Delaunay triangulation is implemented using the Bowyer-Watson algorithm.
+	The Delaunay triangulation is built by divide and conquer (see triangulateSites), with the halves of the
+	recursion on threads of their own. It can also be built with the Bowyer-Watson algorithm (see
+	triangulateIncrementally): the sites are inserted in Morton order into a mesh whose triangles know their neighbours
+	and circumcircles (see Mesh), so each insertion only looks at the few triangles around the new site.
+
+	That mesh can also be edited one site at a time: sites inserted, removed or moved (see addSite, removeSite and
+	moveSite) in microseconds, whatever the number of sites, each change telling which triangles and Voronoi edges
+	it took away and made (see getChangedVoronoiEdges), so that only that part of the window is drawn again. After
+	drawing, the program lets the sites be edited with the mouse this way.
+
+	Before drawing, the sites can be spread out evenly by Lloyd's relaxation (see relaxVoronoi): every site moves to
+	the centroid of its cell, again and again, in the same mesh, which only needs a few flips as the sites settle.
+
+	The diagram can also be traced directly with Fortune's sweep-line algorithm (see fortuneVoronoi), which needs no
+	triangulation. At start-up the program can time these on random sites, from a thousand to a million, and the
+	divide and conquer on ten million sites with 1 to 32 threads.
+
+	The cells can also be filled in pixel by pixel, or the distance to the nearest site shown, by jump flooding (see
+	jumpFlood), which does the same work for any number of sites.
+
+	The sites themselves come from Poisson disk sampling (see generateSites), in time that grows with the number of
+	sites alone, and are the same every time for the same seed.
 
 	For more information please see:
 	
 	- https://en.wikipedia.org/wiki/Voronoi_diagram
 	- https://en.wikipedia.org/wiki/Delaunay_triangulation
 	- https://en.wikipedia.org/wiki/Bowyer%E2%80%93Watson_algorithm
-
-	NOTE: This is a crude reference implementation with bugs. For example, the code breaks for very
-	low number of sites.
+	- Guibas and Stolfi, Primitives for the manipulation of general subdivisions and the computation of Voronoi diagrams (1985)
+	- https://en.wikipedia.org/wiki/Fortune%27s_algorithm
+	- https://en.wikipedia.org/wiki/Lloyd%27s_algorithm
+	- https://www.cs.ubc.ca/~rbridson/docs/bridson-siggraph07-poissondisk.pdf
+	- Rong and Tan, Jump flooding in GPU with applications to Voronoi diagram and distance transform (2006)
+	- Shewchuk, Adaptive precision floating-point arithmetic and fast robust geometric predicates (1997)
+
+	Both triangulations decide everything with exact geometric predicates (see orient2d and incircle), so
+	collinear and cocircular sites, and any number of sites, are handled without tolerances or retries.
+
+	NOTE: This is a crude reference implementation. The Bowyer-Watson mesh sits inside a finite super
+	triangle, so it can miss a few of the thinnest triangles along the hull of the sites.
 */
 
 #define NOMINMAX
@@ -21,6 +51,9 @@
 #include <limits>
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <thread>
+#include <atomic>
 #include "graphics.h"
 #include "colors.h"
 
@@ -168,18 +201,161 @@ inline float getEuclideanDist(const Point &p1, const Point &p2)
 	return sqrt((p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y));
 }
 
-// used for Possion disk sampling during the generation of sites
-bool isValidPos(const Point &p, const float minRadius, const std::vector<Point> &listPoints)
+// Robust geometric predicates, after Shewchuk, Adaptive precision floating-point arithmetic and fast robust geometric predicates (1997). Each determinant
+// is worked out in doubles first, and its sign trusted if the result is further from zero than the rounding error of the terms summed could take it;
+// that is nearly always, and costs one multiplication and comparison more. Only for points (nearly) collinear or cocircular is it worked out again
+// exactly, as an expansion: a sum of doubles that do not overlap, ordered by magnitude, so that the last, largest term has the sign of the whole. The
+// length of an expansion follows the numbers: the exact path drops every term that comes out zero, so it stays short for the simple coordinates that
+// degenerate inputs usually have.
+constexpr double ROUNDING = std::numeric_limits<double>::epsilon() / 2; // the largest relative error of one operation
+constexpr double ORIENT_ERROR_BOUND = (3 + 16 * ROUNDING) * ROUNDING;
+constexpr double INCIRCLE_ERROR_BOUND = (10 + 96 * ROUNDING) * ROUNDING;
+
+inline void twoSum(const double &a, const double &b, double &x, double &y) // x + y = a + b exactly, x being a + b rounded
 {
-	for (const auto& point : listPoints)
-		if (getEuclideanDist(p, point) < minRadius)
-			return false;
-	return true;
+	x = a + b;
+	const double bVirtual = x - a, aVirtual = x - bVirtual;
+	y = (a - aVirtual) + (b - bVirtual);
+}
+
+inline void twoProduct(const double &a, const double &b, double &x, double &y) // x + y = a * b exactly
+{
+	x = a * b;
+	y = std::fma(a, b, -x);
+}
+
+// The functions on expansions return the number of terms of the result.
+
+int diffExpansion(const double &a, const double &b, double *h) // h = a - b
+{
+	double x, y;
+	int n = 0;
+	twoSum(a, -b, x, y);
+	if (y != 0)
+		h[n++] = y;
+	if (x != 0 || n == 0)
+		h[n++] = x;
+	return n;
+}
+
+int growExpansion(double *e, const int &n, const double &b) // e += b, with room in e for one more term
+{
+	double q = b, sum;
+	int m = 0;
+	for (int i = 0; i < n; i++)
+	{
+		twoSum(q, e[i], sum, e[m]); // e[m] is never a term still to be read
+		q = sum;
+		m += (e[m] != 0);
+	}
+	if (q != 0 || m == 0)
+		e[m++] = q;
+	return m;
+}
+
+int addExpansions(double *e, int n, const double *f, const int &m) // e += f, with room in e for m more terms
+{
+	for (int i = 0; i < m; i++)
+		n = growExpansion(e, n, f[i]);
+	return n;
+}
+
+int scaleExpansion(const double *e, const int &n, const double &b, double *h) // h = e * b, with room in h for 2n terms
+{
+	double q, product, error, sum;
+	int m = 0;
+	twoProduct(e[0], b, q, h[0]);
+	m += (h[0] != 0);
+	for (int i = 1; i < n; i++)
+	{
+		twoProduct(e[i], b, product, error);
+		twoSum(q, error, sum, h[m]);
+		m += (h[m] != 0);
+		twoSum(product, sum, q, h[m]);
+		m += (h[m] != 0);
+	}
+	if (q != 0 || m == 0)
+		h[m++] = q;
+	return m;
+}
+
+int multiplyExpansions(const double *e, const int &n, const double *f, const int &m, double *h) // h = e * f, for n <= 16, with room in h for 2nm terms
+{
+	double scaled[32];
+	int k = 0;
+	for (int i = 0; i < m; i++)
+		k = addExpansions(h, k, scaled, scaleExpansion(e, n, f[i], scaled));
+	return k;
+}
+
+int crossExpansion(const double *a, const int &na, const double *b, const int &nb, const double *c, const int &nc, const double *d, const int &nd,
+	double *h) // h = a * b - c * d, for expansions of two terms at most, with room in h for 16 terms
+{
+	double cd[8];
+	const int n = multiplyExpansions(a, na, b, nb, h), m = multiplyExpansions(c, nc, d, nd, cd);
+	for (int i = 0; i < m; i++)
+		cd[i] = -cd[i];
+	return addExpansions(h, n, cd, m);
+}
+
+double orient2dExact(const double &ax, const double &ay, const double &bx, const double &by, const double &cx, const double &cy)
+{
+	double acx[2], acy[2], bcx[2], bcy[2], det[16];
+	const int nacx = diffExpansion(ax, cx, acx), nacy = diffExpansion(ay, cy, acy), nbcx = diffExpansion(bx, cx, bcx), nbcy = diffExpansion(by, cy, bcy);
+	return det[crossExpansion(acx, nacx, bcy, nbcy, acy, nacy, bcx, nbcx, det) - 1];
+}
+
+// twice the signed area of abc: positive if counter-clockwise, negative if clockwise, zero only if the three are exactly collinear
+inline double orient2d(const double &ax, const double &ay, const double &bx, const double &by, const double &cx, const double &cy)
+{
+	const double left = (ax - cx) * (by - cy), right = (ay - cy) * (bx - cx), det = left - right, bound = ORIENT_ERROR_BOUND * (fabs(left) + fabs(right));
+	if (det > bound || -det > bound)
+		return det;
+	return orient2dExact(ax, ay, bx, by, cx, cy);
+}
+
+inline double orient2d(const Point &a, const Point &b, const Point &c)
+{
+	return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+// h = (a * b - c * d) * (e * e + f * f), the term of one corner of the incircle determinant, with room in h for 512 terms
+int liftedCross(const double *a, const int &na, const double *b, const int &nb, const double *c, const int &nc, const double *d, const int &nd,
+	const double *e, const int &ne, const double *f, const int &nf, double *h)
+{
+	double cross[16], lift[16], ff[8];
+	const int nCross = crossExpansion(a, na, b, nb, c, nc, d, nd, cross);
+	const int nLift = addExpansions(lift, multiplyExpansions(e, ne, e, ne, lift), ff, multiplyExpansions(f, nf, f, nf, ff));
+	return multiplyExpansions(lift, nLift, cross, nCross, h);
+}
+
+double incircleExact(const double &ax, const double &ay, const double &bx, const double &by, const double &cx, const double &cy, const double &dx, const double &dy)
+{
+	double adx[2], ady[2], bdx[2], bdy[2], cdx[2], cdy[2], term[512], det[1536];
+	const int nadx = diffExpansion(ax, dx, adx), nady = diffExpansion(ay, dy, ady), nbdx = diffExpansion(bx, dx, bdx), nbdy = diffExpansion(by, dy, bdy),
+		ncdx = diffExpansion(cx, dx, cdx), ncdy = diffExpansion(cy, dy, cdy);
+	int n = liftedCross(bdx, nbdx, cdy, ncdy, cdx, ncdx, bdy, nbdy, adx, nadx, ady, nady, det);
+	n = addExpansions(det, n, term, liftedCross(cdx, ncdx, ady, nady, adx, nadx, cdy, ncdy, bdx, nbdx, bdy, nbdy, term));
+	n = addExpansions(det, n, term, liftedCross(adx, nadx, bdy, nbdy, bdx, nbdx, ady, nady, cdx, ncdx, cdy, ncdy, term));
+	return det[n - 1];
+}
+
+// positive if d lies inside the circle through a, b and c (counter-clockwise), negative if outside, zero only if exactly on it
+inline double incircle(const double &ax, const double &ay, const double &bx, const double &by, const double &cx, const double &cy, const double &dx, const double &dy)
+{
+	const double adx = ax - dx, ady = ay - dy, bdx = bx - dx, bdy = by - dy, cdx = cx - dx, cdy = cy - dy;
+	const double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy, cdxady = cdx * ady, adxcdy = adx * cdy, adxbdy = adx * bdy, bdxady = bdx * ady;
+	const double aLift = adx * adx + ady * ady, bLift = bdx * bdx + bdy * bdy, cLift = cdx * cdx + cdy * cdy;
+	const double det = aLift * (bdxcdy - cdxbdy) + bLift * (cdxady - adxcdy) + cLift * (adxbdy - bdxady);
+	const double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * aLift + (fabs(cdxady) + fabs(adxcdy)) * bLift + (fabs(adxbdy) + fabs(bdxady)) * cLift;
+	if (det > INCIRCLE_ERROR_BOUND * permanent || -det > INCIRCLE_ERROR_BOUND * permanent)
+		return det;
+	return incircleExact(ax, ay, bx, by, cx, cy, dx, dy);
 }
 
-inline bool isInsideCircle(const Point &p, const Circle &c)
+inline double incircle(const Point &a, const Point &b, const Point &c, const Point &d)
 {
-	return getEuclideanDist(p, c.center) < c.radius;
+	return incircle(a.x, a.y, b.x, b.y, c.x, c.y, d.x, d.y);
 }
 
 /*
@@ -206,297 +382,2449 @@ bool intersects(const Point &c1, const Point &c2, float radius, Point &p1, Point
 
 */
 
+// The circle through the corners, from the perpendicular bisectors of two sides worked out relative to one corner, which needs no slopes and so has no
+// special cases. Only collinear corners (which triangulate() never gives), or corners too nearly so for doubles, have no circle.
 Circle getCircumCircle(const Triangle &triangle)
 {
-	// triangle.display();
-
-	float x = 0, y = 0, radius = 0, m1 = 0, m2 = 0, c1 = 0, c2 = 0;
-	float num1 = triangle.a.x - triangle.c.x;
-	float den1 = triangle.c.y - triangle.a.y;
-	float num2 = triangle.b.x - triangle.c.x;
-	float den2 = triangle.c.y - triangle.b.y;	
-
-	if (fabs(num1) < EPSILON && fabs(num2) < EPSILON || fabs(den1) < EPSILON && fabs(den2) < EPSILON)
+	const double bx = (double)triangle.b.x - triangle.a.x, by = (double)triangle.b.y - triangle.a.y;
+	const double cx = (double)triangle.c.x - triangle.a.x, cy = (double)triangle.c.y - triangle.a.y;
+	const double d = 2 * (bx * cy - by * cx), b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+	if (d == 0)
 	{
 		std::cerr << "Error! Degenerate triangle detected." << std::endl;
 		return Circle();
 	}
-	
-	// degenerate case for m1
-	if (fabs(den1) < EPSILON)
-	{
-		m2 = num2 / den2;
-		c2 = (triangle.c.y + triangle.b.y - ((triangle.b.x + triangle.c.x) * m2)) / 2;
-		x = (triangle.a.x + triangle.c.x) / 2;
-		y = m2 * x + c2;
-		Point center(x, y);
-		radius = getEuclideanDist(center, triangle.b);
-		return Circle(center, radius);
-	}
-
-	// degenerate case for m2
-	if (fabs(den2) < EPSILON)
-	{
-		m1 = num1 / den1;
-		c1 = (triangle.c.y + triangle.a.y - ((triangle.a.x + triangle.c.x) * m1)) / 2;
-		x = (triangle.a.x + triangle.c.x) / 2;
-		y = m1 * x + c1;
-		Point center(x, y);
-		radius = getEuclideanDist(center, triangle.b);
-		return Circle(center, radius);
-	}
-
-	m1 = num1 / den1;
-	m2 = num2 / den2;
-	c1 = (triangle.c.y + triangle.a.y - ((triangle.a.x + triangle.c.x) * m1)) / 2;
-	c2 = (triangle.c.y + triangle.b.y - ((triangle.b.x + triangle.c.x) * m2)) / 2;
-	x = (c2 - c1) / (m1 - m2);
-	y = m1 * x + c1;
-	Point center(x, y);
-	radius = getEuclideanDist(center, triangle.a);
-	return Circle(center, radius);
-}
-
-// Bowyer-Watson algorithm for Delaunay triangulation
-std::vector<Triangle> triangulate(const std::vector<Point> &siteList)
+	const double ux = (cy * b2 - by * c2) / d, uy = (bx * c2 - cx * b2) / d;
+	return Circle(Point((float)(triangle.a.x + ux), (float)(triangle.a.y + uy)), (float)sqrt(ux * ux + uy * uy));
+}
+
+// The mesh the Bowyer-Watson algorithm works on. Triangles refer to their corners and their neighbours by index, so that inserting a site only touches
+// the triangles around it: a walk from the last triangle made finds the one the site falls in, and a flood fill from there across the neighbours whose
+// circumcircles hold the site (by incircle(), exactly) finds the cavity to retriangulate. With the sites inserted in Morton order (each one near the last)
+// the walk is a few steps and the cavity a few triangles, whatever the size of the mesh.
+//
+// Once built, sites can be inserted, removed and moved the same way, each change only touching the triangles around the site and recording them in
+// Mesh::change. Each point keeps a triangle it is a corner of, so a site to remove is found at once; a site inserted anywhere starts its walk from the
+// nearest of a few triangles picked across the mesh.
+#define NO_TRIANGLE -1
+
+struct MeshTriangle
 {
-	std::vector<Triangle> meshList;
-	Triangle superTriangle(Point(0, 0),
-						   Point(0, 2 * HEIGHT),
-						   Point(2 * WIDTH, 0));	
+	int v[3]; // corners (indices into Mesh::points), counter-clockwise
+	int adj[3]; // adj[i] is the triangle across the edge from v[i] to v[(i + 1) % 3], or NO_TRIANGLE
+	double cx, cy; // centre of the circumcircle, the Voronoi vertex
+	unsigned stamp; // the last insertion that looked at this triangle
+	bool alive;
+};
 
-	meshList.push_back(superTriangle);
+struct MeshChange // what one insertion or removal did to the mesh
+{
+	std::vector<int> removedSlots; // the triangles it took out
+	std::vector<MeshTriangle> removed; // copies of them, as their slots may have been reused
+	std::vector<int> created; // the triangles it made
+	float left, top, right, bottom; // the box around the sites at their corners, as they were when it was taken out or made
+};
 
-	// for each site in the list of sites (i.e. the list of input points)
-	for (auto siteItr = siteList.begin(); siteItr != siteList.end(); ++siteItr)
+struct Mesh
+{
+	std::vector<Point> points; // the sites, then the three corners of the super triangle, then the sites inserted later
+	std::vector<int> corners; // a triangle at each point, or NO_TRIANGLE for a point not in the mesh
+	std::vector<MeshTriangle> triangles;
+	std::vector<int> freeSlots; // of deleted triangles, for reuse
+	int firstCorner; // the first of the three corners of the super triangle
+	int last; // the triangle the next walk starts from
+	unsigned stamp;
+	MeshChange change; // of the last insertSite() or removeSite()
+	std::vector<int> order; // the sites buildMesh() was given, in the Morton order it inserted them, for walking them near each other one after another
+
+	// scratch space of insertSite(), removeSite() and findTrianglesNear(), kept to save allocations
+	struct BoundaryEdge
 	{
-		// list of non-Delaunay triangles
-		std::vector<Triangle> invalidMeshList;	
+		int a, b, outside;
+	};
+	std::vector<int> stack, cavity, created, polygon;
+	std::vector<BoundaryEdge> boundary;
+};
 
-		// for each triangle in the list of triangles to be returned
-		for (auto itr = meshList.begin(); itr != meshList.end(); ++itr)
-		{
-			Circle circumCircle = getCircumCircle(*itr);
-			if (isInsideCircle(*siteItr, circumCircle))
-				invalidMeshList.push_back(*itr);
-		}
-		std::vector<Edge> boundaryList;
+void setCircumCentre(const Mesh &mesh, MeshTriangle &t)
+{
+	const Point &a = mesh.points[t.v[0]], &b = mesh.points[t.v[1]], &c = mesh.points[t.v[2]];
+	const double bx = (double)b.x - a.x, by = (double)b.y - a.y, cx = (double)c.x - a.x, cy = (double)c.y - a.y;
+	const double d = 2 * (bx * cy - by * cx), b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+	if (d == 0) // a triangle too thin for doubles, which only the drawing of its Voronoi vertex notices
+	{
+		t.cx = a.x;
+		t.cy = a.y;
+		return;
+	}
+	t.cx = a.x + (cy * b2 - by * c2) / d;
+	t.cy = a.y + (bx * c2 - cx * b2) / d;
+}
 
-		// for each triangle in the list of invalid triangles
-		for (auto &triangle : invalidMeshList)
-		{
-			for (int i = 0; i < 3; i++) // for each edge in each triangle
-			{	
-				int match = 0;
-				for (const auto &edgeTri : invalidMeshList)
-					if (edgeTri.containsEdge(triangle[i]))
-						match++;
+inline bool isSamePlace(const Point &a, const Point &b) // exactly: sites closer than EPSILON are still two sites
+{
+	return a.x == b.x && a.y == b.y;
+}
 
-				if (match == 1) // edge is unique 
-					boundaryList.push_back(triangle[i]);
-			}
-		}
+inline bool isInsideCircumCircle(const Mesh &mesh, const MeshTriangle &t, const Point &p)
+{
+	return incircle(mesh.points[t.v[0]], mesh.points[t.v[1]], mesh.points[t.v[2]], p) > 0;
+}
 
-		// remove double counted edges by deleting duplicate triangles
-		for (const auto &badTriangle : invalidMeshList)
-		{
-			meshList.erase(std::remove_if(meshList.begin(),
-									meshList.end(),
-									[&, badTriangle](auto triangle) 
-			{
-				return triangle == badTriangle;
-			}), meshList.end());
-		}
+inline bool isSuperCorner(const Mesh &mesh, const int &v)
+{
+	return v >= mesh.firstCorner && v < mesh.firstCorner + 3;
+}
 
-		// fill the polygonal hole by retriangulating it
-		for (const auto &edge : boundaryList)
-		{
-			Triangle t(edge.src, edge.dst, *siteItr);
-			meshList.push_back(t);
-		}
-	}
+inline bool isRealTriangle(const Mesh &mesh, const MeshTriangle &t) // one of sites alone, not touching the super triangle
+{
+	return !isSuperCorner(mesh, t.v[0]) && !isSuperCorner(mesh, t.v[1]) && !isSuperCorner(mesh, t.v[2]);
+}
 
-	meshList.erase(std::remove_if(meshList.begin(),
-								  meshList.end(),
-								  [&, superTriangle](auto triangle) 
+int addTriangle(Mesh &mesh, const int &a, const int &b, const int &c)
+{
+	int index = (int)mesh.triangles.size();
+	if (!mesh.freeSlots.empty())
 	{
-		return (triangle.containsVertex(superTriangle.a) ||
-				triangle.containsVertex(superTriangle.b) ||
-				triangle.containsVertex(superTriangle.c));
-	}), meshList.end());
+		index = mesh.freeSlots.back();
+		mesh.freeSlots.pop_back();
+	}
+	else
+		mesh.triangles.push_back(MeshTriangle());
+	MeshTriangle &t = mesh.triangles[index];
+	t.v[0] = a;
+	t.v[1] = b;
+	t.v[2] = c;
+	t.adj[0] = t.adj[1] = t.adj[2] = NO_TRIANGLE;
+	t.stamp = 0;
+	t.alive = true;
+	setCircumCentre(mesh, t);
+	mesh.corners[a] = mesh.corners[b] = mesh.corners[c] = index;
+	return index;
+}
 
-	return meshList;
+// Makes t and the triangle n on the other side of its edge i neighbours.
+void setNeighbour(Mesh &mesh, const int &t, const int &i, const int &n)
+{
+	MeshTriangle &tri = mesh.triangles[t];
+	tri.adj[i] = n;
+	if (n == NO_TRIANGLE)
+		return;
+	MeshTriangle &out = mesh.triangles[n];
+	for (int j = 0; j < 3; j++)
+		if (out.v[j] == tri.v[(i + 1) % 3] && out.v[(j + 1) % 3] == tri.v[i])
+			out.adj[j] = t;
 }
 
-// this function may be too slow or get stuck in an infinite loop
-// if the number of sites to generate is too high with respect 
-// to the viewport resolution and minimum radius value
-std::vector<Point> generateSites(size_t maxPoints, float radius, int* errorState)
+// Widens the box of mesh.change to hold the sites at the corners of t.
+void boundChange(Mesh &mesh, const MeshTriangle &t)
 {
-	std::vector<Point> siteList;
-	std::random_device r;
-	std::seed_seq seed{r()};
-	std::default_random_engine engine(seed);
-	std::uniform_real_distribution<float> rndX(PADDING, WIDTH - PADDING);
-	std::uniform_real_distribution<float> rndY(PADDING, HEIGHT - PADDING);
+	for (int i = 0; i < 3; i++)
+	{
+		if (isSuperCorner(mesh, t.v[i]))
+			continue;
+		const Point &p = mesh.points[t.v[i]];
+		mesh.change.left = std::min(mesh.change.left, p.x);
+		mesh.change.top = std::min(mesh.change.top, p.y);
+		mesh.change.right = std::max(mesh.change.right, p.x);
+		mesh.change.bottom = std::max(mesh.change.bottom, p.y);
+	}
+}
 
-	float x = rndX(engine);
-	float y = rndY(engine);
-	Point site(x, y);
-	siteList.push_back(site);  // add the first point
-	site.draw(CYAN);
+// Takes the triangles of the cavity out of the mesh, keeping copies of them in mesh.change.
+void removeCavity(Mesh &mesh)
+{
+	mesh.change.removedSlots = mesh.cavity;
+	mesh.change.removed.clear();
+	mesh.change.left = mesh.change.top = std::numeric_limits<float>::infinity();
+	mesh.change.right = mesh.change.bottom = -std::numeric_limits<float>::infinity();
+	for (const int &t : mesh.cavity)
+	{
+		mesh.change.removed.push_back(mesh.triangles[t]);
+		boundChange(mesh, mesh.triangles[t]);
+		mesh.triangles[t].alive = false;
+		mesh.freeSlots.push_back(t);
+	}
+}
 
-	int ch = 0;
+// Records the triangles mesh.created holds as made by the change, and starts the next walk from the last of them.
+void finishChange(Mesh &mesh)
+{
+	mesh.change.created = mesh.created;
+	for (const int &t : mesh.created)
+		boundChange(mesh, mesh.triangles[t]);
+	mesh.last = mesh.created.back();
+}
 
-	auto start = std::chrono::high_resolution_clock::now();
-	while (siteList.size() < maxPoints)
+// Walks from mesh.last towards p, crossing any edge p lies beyond, and returns the triangle holding p. The edge tried first changes from step to step,
+// which keeps the walk from going round in circles.
+int locateTriangle(const Mesh &mesh, const Point &p)
+{
+	int t = mesh.last;
+	unsigned turn = 0;
+	for (;;)
 	{
-		auto now = std::chrono::high_resolution_clock::now();
-		auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - start);
-
-		if (duration.count() > 10)
+		const MeshTriangle &tri = mesh.triangles[t];
+		int next = NO_TRIANGLE;
+		for (int k = 0; k < 3 && next == NO_TRIANGLE; k++)
 		{
-			std::cout << "\nGenerating points seems to be taking too long." << std::endl;
-			std::cout << "This maybe because of an invalid combination of the number of sites "
-					  << "to generate and minimum radius between them." << std::endl;
-			std::cout << "Would you like to stop and try again with new input parameters?" << std::endl;
-			std::cout << "0 = Quit | 1 = Try again | 2 = Wait a little longer (will be prompted again in another 10 seconds)" << std::endl;
-			std::cin >> ch;
-
-			if (ch == 0)
-				*errorState = -1;
+			const int i = (k + turn) % 3;
+			if (orient2d(mesh.points[tri.v[i]], mesh.points[tri.v[(i + 1) % 3]], p) < 0)
+				next = tri.adj[i];
+		}
+		if (next == NO_TRIANGLE)
+			return t;
+		t = next;
+		turn++;
+	}
+}
 
-			if (ch == 1)
-				*errorState = 1;
+// Inserts mesh.points[site]. Returns false (changing nothing) if it falls on a corner that is already there.
+bool insertSite(Mesh &mesh, const int &site)
+{
+	const Point &p = mesh.points[site];
+	const int start = locateTriangle(mesh, p);
+	for (int i = 0; i < 3; i++)
+		if (isSamePlace(mesh.points[mesh.triangles[start].v[i]], p))
+			return false;
 
-			if (ch == 2)
-			{
-				start = std::chrono::high_resolution_clock::now();
-				std::cout << "Waiting for another 10 seconds for site generation to complete..." << std::endl;
+	// The cavity: every triangle reachable from the first across neighbours whose circumcircle holds p
+	const unsigned stamp = ++mesh.stamp;
+	mesh.stack.assign(1, start);
+	mesh.cavity.assign(1, start);
+	mesh.boundary.clear();
+	mesh.triangles[start].stamp = stamp;
+	while (!mesh.stack.empty())
+	{
+		const int t = mesh.stack.back();
+		mesh.stack.pop_back();
+		for (int i = 0; i < 3; i++)
+		{
+			const MeshTriangle &tri = mesh.triangles[t];
+			const int n = tri.adj[i];
+			if (n != NO_TRIANGLE && mesh.triangles[n].stamp == stamp)
 				continue;
+			if (n != NO_TRIANGLE && isInsideCircumCircle(mesh, mesh.triangles[n], p))
+			{
+				mesh.triangles[n].stamp = stamp;
+				mesh.stack.push_back(n);
+				mesh.cavity.push_back(n);
 			}
+			else
+				mesh.boundary.push_back({ tri.v[i], tri.v[(i + 1) % 3], n });
+		}
+	}
+	removeCavity(mesh);
 
-			return siteList;
+	// Fill it with a fan of triangles from p, one on each edge of its boundary
+	mesh.created.clear();
+	for (const Mesh::BoundaryEdge &e : mesh.boundary)
+	{
+		const int t = addTriangle(mesh, e.a, e.b, site);
+		setNeighbour(mesh, t, 0, e.outside);
+		mesh.created.push_back(t);
+	}
+	for (const int &t : mesh.created) // the cavity is small, so matching up the fan by scanning it is cheap
+	{
+		MeshTriangle &tri = mesh.triangles[t];
+		for (const int &u : mesh.created)
+		{
+			if (mesh.triangles[u].v[0] == tri.v[1])
+				tri.adj[1] = u;
+			if (mesh.triangles[u].v[1] == tri.v[0])
+				tri.adj[2] = u;
 		}
+	}
+	finishChange(mesh);
+	return true;
+}
 
-		site.x = rndX(engine);
-		site.y = rndY(engine);
+// Takes mesh.points[site] out of the mesh: the triangles around it go, and the polygon they leave is triangulated again, cutting off one at a time the
+// corner whose circumcircle holds no other corner of the polygon. Returns false (changing nothing) if the site is not in the mesh or is a corner of the
+// super triangle.
+bool removeSite(Mesh &mesh, const int &site)
+{
+	const int first = mesh.corners[site];
+	if (first == NO_TRIANGLE || isSuperCorner(mesh, site))
+		return false;
 
-		// Poisson disk sampling
-		if (isValidPos(site, radius, siteList)) // inefficient rejection sampling
+	// The triangles around the site, counter-clockwise, and the polygon of their far edges
+	mesh.cavity.clear();
+	mesh.polygon.clear();
+	mesh.boundary.clear();
+	int t = first;
+	do
+	{
+		const MeshTriangle &tri = mesh.triangles[t];
+		const int i = (tri.v[0] == site) ? 0 : (tri.v[1] == site) ? 1 : 2;
+		mesh.cavity.push_back(t);
+		mesh.polygon.push_back(tri.v[(i + 1) % 3]);
+		mesh.boundary.push_back({ tri.v[(i + 1) % 3], tri.v[(i + 2) % 3], tri.adj[(i + 1) % 3] });
+		t = tri.adj[(i + 2) % 3];
+	} while (t != first);
+	removeCavity(mesh);
+	mesh.corners[site] = NO_TRIANGLE;
+
+	// Cut ears off the polygon: boundary[j] is its edge from polygon[j] to the next corner, and the triangle outside it
+	mesh.created.clear();
+	while (mesh.polygon.size() > 3)
+	{
+		const int k = (int)mesh.polygon.size();
+		int ear = -1; // with exact predicates there always is one
+		for (int j = 0; j < k && ear < 0; j++)
 		{
-			siteList.push_back(site);			
-			site.draw(CYAN);
+			const Point &a = mesh.points[mesh.polygon[j]], &b = mesh.points[mesh.polygon[(j + 1) % k]], &c = mesh.points[mesh.polygon[(j + 2) % k]];
+			if (orient2d(a, b, c) <= 0)
+				continue;
+			bool empty = true;
+			for (int m = 3; m < k && empty; m++)
+				empty = incircle(a, b, c, mesh.points[mesh.polygon[(j + m) % k]]) <= 0;
+			if (empty)
+				ear = j;
 		}
+		const int b = (ear + 1) % k;
+		const int e = addTriangle(mesh, mesh.polygon[ear], mesh.polygon[b], mesh.polygon[(ear + 2) % k]);
+		setNeighbour(mesh, e, 0, mesh.boundary[ear].outside);
+		setNeighbour(mesh, e, 1, mesh.boundary[b].outside);
+		mesh.boundary[ear] = { mesh.polygon[ear], mesh.polygon[(ear + 2) % k], e }; // the cut is an edge of what is left
+		mesh.polygon.erase(mesh.polygon.begin() + b);
+		mesh.boundary.erase(mesh.boundary.begin() + b);
+		mesh.created.push_back(e);
 	}
+	const int e = addTriangle(mesh, mesh.polygon[0], mesh.polygon[1], mesh.polygon[2]);
+	for (int i = 0; i < 3; i++)
+		setNeighbour(mesh, e, i, mesh.boundary[i].outside);
+	mesh.created.push_back(e);
+	finishChange(mesh);
+	return true;
+}
 
-	*errorState = 0;
-	return siteList;
+// Points mesh.last at whichever of about n^(1/3) triangles, taken evenly from the whole mesh, has a corner nearest p (jump and walk). The walk to a site
+// far from the last change then takes about n^(1/3) steps rather than n^(1/2).
+void startNear(Mesh &mesh, const Point &p)
+{
+	const int n = (int)mesh.triangles.size(), step = std::max(n / ((int)std::cbrt((double)n) + 1), 1);
+	double nearest = std::numeric_limits<double>::infinity();
+	for (int t = mesh.stamp % step; t < n; t += step)
+	{
+		if (!mesh.triangles[t].alive)
+			continue;
+		const Point &corner = mesh.points[mesh.triangles[t].v[0]];
+		const double dx = (double)corner.x - p.x, dy = (double)corner.y - p.y;
+		if (dx * dx + dy * dy < nearest)
+		{
+			nearest = dx * dx + dy * dy;
+			mesh.last = t;
+		}
+	}
 }
 
-void drawMesh(const std::vector<Triangle> &meshList)
+// Adds a site to a mesh built by buildMesh(). Returns its index in mesh.points, or -1 (changing nothing) if a site is already there.
+int addSite(Mesh &mesh, const Point &p)
 {
-	for (const auto& triangle : meshList)
-		triangle.draw(LIGHTRED);
+	startNear(mesh, p);
+	mesh.points.push_back(p);
+	mesh.corners.push_back(NO_TRIANGLE);
+	if (insertSite(mesh, (int)mesh.points.size() - 1))
+		return (int)mesh.points.size() - 1;
+	mesh.points.pop_back();
+	mesh.corners.pop_back();
+	return -1;
 }
 
-/**
-	The Vorornoi pattern is the dual graph of the Delaunay triangulation.
-	This function generates the resulting Voronoi pettern from the input
-	Delaunay triangulated mesh.
-*/
-void drawVoronoiPattern(const std::vector<Triangle>& mesh)
+// Moves a site of the mesh to p, as a removal and an insertion. mesh.change tells what the two did together: a triangle the removal made and the
+// insertion took out again was never seen. Returns false (changing nothing) if the site is not in the mesh, or a site (even this one) is at p already.
+bool moveSite(Mesh &mesh, const int &site, const Point &p)
 {
-	for (size_t i = 0; i < mesh.size(); ++i)
+	if (mesh.corners[site] == NO_TRIANGLE || isSuperCorner(mesh, site))
+		return false;
+	mesh.last = mesh.corners[site]; // a site is seldom moved far
+	const MeshTriangle &target = mesh.triangles[locateTriangle(mesh, p)];
+	for (int i = 0; i < 3; i++)
+		if (isSamePlace(mesh.points[target.v[i]], p))
+			return false;
+	removeSite(mesh, site);
+	MeshChange removal = mesh.change;
+	mesh.points[site].x = p.x;
+	mesh.points[site].y = p.y;
+	insertSite(mesh, site);
+
+	const MeshChange &insertion = mesh.change;
+	std::vector<bool> transient(insertion.removedSlots.size(), false);
+	MeshChange both;
+	both.removedSlots = removal.removedSlots;
+	both.removed = removal.removed;
+	for (const int &t : removal.created)
 	{
-		Circle circumCircle = getCircumCircle(mesh[i]);
-		for (size_t j = 0; j < mesh.size(); ++j)
+		const auto found = std::find(insertion.removedSlots.begin(), insertion.removedSlots.end(), t);
+		if (found == insertion.removedSlots.end())
+			both.created.push_back(t);
+		else
+			transient[found - insertion.removedSlots.begin()] = true;
+	}
+	for (size_t i = 0; i < insertion.removedSlots.size(); i++)
+		if (!transient[i])
 		{
-			if (mesh[i].isNeighborOf(mesh[j]))
-			{
-				Circle circumCircleNeighbor = getCircumCircle(mesh[j]);
+			// Its neighbours are as the removal left them: one the removal made was, before the move, the triangle of the site on that edge
+			MeshTriangle copy = insertion.removed[i];
+			for (int j = 0; j < 3; j++)
+				if (std::find(removal.created.begin(), removal.created.end(), copy.adj[j]) != removal.created.end())
+					for (size_t k = 0; k < removal.removed.size(); k++)
+						for (int m = 0; m < 3; m++)
+							if (removal.removed[k].v[m] == copy.v[(j + 1) % 3] && removal.removed[k].v[(m + 1) % 3] == copy.v[j])
+								copy.adj[j] = removal.removedSlots[k];
+			both.removedSlots.push_back(insertion.removedSlots[i]);
+			both.removed.push_back(copy);
+		}
+	both.created.insert(both.created.end(), insertion.created.begin(), insertion.created.end());
+	both.left = std::min(removal.left, insertion.left);
+	both.top = std::min(removal.top, insertion.top);
+	both.right = std::max(removal.right, insertion.right);
+	both.bottom = std::max(removal.bottom, insertion.bottom);
+	mesh.change = both;
+	return true;
+}
 
-#ifndef NDEBUG
-				circumCircle.draw(LIGHTBLUE); // for debugging
-				circumCircleNeighbor.draw(LIGHTBLUE); // for debugging
-#endif
-				setcolor(YELLOW);
-				line(circumCircle.center.x, circumCircle.center.y, circumCircleNeighbor.center.x, circumCircleNeighbor.center.y);
+// Swaps the diagonal of the quadrilateral made by triangle t and its neighbour across edge i, which must be convex. The two triangles keep their slots;
+// mesh.change is left alone.
+void flipEdge(Mesh &mesh, const int &t, const int &i)
+{
+	const int n = mesh.triangles[t].adj[i];
+	MeshTriangle &tri = mesh.triangles[t], &out = mesh.triangles[n];
+	const int j = (out.adj[0] == t) ? 0 : (out.adj[1] == t) ? 1 : 2;
+	const int a = tri.v[i], b = tri.v[(i + 1) % 3], c = tri.v[(i + 2) % 3], d = out.v[(j + 2) % 3]; // t is abc, n is bad
+	const int bc = tri.adj[(i + 1) % 3], ca = tri.adj[(i + 2) % 3], ad = out.adj[(j + 1) % 3], db = out.adj[(j + 2) % 3];
+
+	tri.v[0] = a; // t becomes adc
+	tri.v[1] = d;
+	tri.v[2] = c;
+	tri.adj[1] = n;
+	tri.adj[2] = ca;
+	out.v[0] = d; // and n dbc
+	out.v[1] = b;
+	out.v[2] = c;
+	out.adj[0] = db;
+	out.adj[2] = t;
+	setNeighbour(mesh, t, 0, ad);
+	setNeighbour(mesh, n, 1, bc);
+	mesh.corners[a] = mesh.corners[c] = t;
+	mesh.corners[b] = mesh.corners[d] = n;
+	setCircumCentre(mesh, tri);
+	setCircumCentre(mesh, out);
+}
+
+// Moves a site of the mesh to p by flipping edges, where it can: if p lies inside the polygon of the site's neighbours, and sees all of it, the
+// triangles around the site stay the right way round, and only their edges can have stopped being Delaunay. Those are flipped until none is left
+// (Lawson's algorithm), checking the edges of every triangle a flip changes. Otherwise the site is moved by moveSite(). Much cheaper than moveSite() for
+// the short moves of a relaxation, but it does not keep mesh.change. Returns false (changing nothing) if moveSite() would.
+bool relocateSite(Mesh &mesh, const int &site, const Point &p)
+{
+	const int first = mesh.corners[site];
+	if (first == NO_TRIANGLE || isSuperCorner(mesh, site))
+		return false;
+	mesh.stack.clear();
+	int t = first;
+	do
+	{
+		const MeshTriangle &tri = mesh.triangles[t];
+		const int i = (tri.v[0] == site) ? 0 : (tri.v[1] == site) ? 1 : 2;
+		if (orient2d(mesh.points[tri.v[(i + 1) % 3]], mesh.points[tri.v[(i + 2) % 3]], p) <= 0)
+			return moveSite(mesh, site, p);
+		mesh.stack.push_back(t);
+		t = tri.adj[(i + 2) % 3];
+	} while (t != first);
+
+	mesh.points[site].x = p.x;
+	mesh.points[site].y = p.y;
+	for (const int &u : mesh.stack)
+		setCircumCentre(mesh, mesh.triangles[u]);
+	while (!mesh.stack.empty())
+	{
+		const int u = mesh.stack.back();
+		mesh.stack.pop_back();
+		for (int i = 0; i < 3; i++)
+		{
+			const MeshTriangle &tri = mesh.triangles[u];
+			const int n = tri.adj[i];
+			if (n == NO_TRIANGLE)
+				continue;
+			const MeshTriangle &out = mesh.triangles[n];
+			const int j = (out.adj[0] == u) ? 0 : (out.adj[1] == u) ? 1 : 2;
+			if (incircle(mesh.points[tri.v[0]], mesh.points[tri.v[1]], mesh.points[tri.v[2]], mesh.points[out.v[(j + 2) % 3]]) > 0)
+			{
+				flipEdge(mesh, u, i);
+				mesh.stack.push_back(u);
+				mesh.stack.push_back(n);
+				break;
 			}
 		}
 	}
+	mesh.last = first;
+	return true;
 }
 
-// has basic input validation for negative values
-// does not consider other invalid input like characters
-int main()
+// The Voronoi edges the last change to the mesh took away and made. Each joins the circumcentres of two neighbouring triangles; as in
+// drawVoronoiPattern(), only those between two triangles of sites are kept. A neighbour of a triangle taken away is either taken away too, and its copy
+// is in mesh.change, or still there as it was.
+void getChangedVoronoiEdges(const Mesh &mesh, std::vector<Edge> &removed, std::vector<Edge> &added)
 {
-	initwindow(WIDTH, HEIGHT, "Voronoi");
-	float minSiteDist = 0, radius = 0;
-	size_t maxPoints = 0, ch = 0;
-	int error = 0, input = 0;
-
-	while (true)
+	const MeshChange &change = mesh.change;
+	removed.clear();
+	added.clear();
+	for (size_t k = 0; k < change.removed.size(); k++)
 	{
-
-#ifndef NDEBUG
-		std::cout << "Running in DEBUG mode..." << std::endl;		
-		std::cout << "Circumcircles will be visible in renders." << std::endl;
-		std::cout << "Compile in RELEASE mode to remove them.\n" << std::endl;
-#endif
-		std::cout << "This program creates a Voronoi partition pattern." << std::endl;
-		std::cout << "How many sites (points) would you like to have on your partition?" << std::endl;
-		std::cin >> input;
-
-		if (input < 0)
+		const MeshTriangle &t = change.removed[k];
+		for (int i = 0; i < 3; i++)
 		{
-			std::cout << "Invalid input. Try again." << std::endl;
-			continue;
+			if (t.adj[i] == NO_TRIANGLE)
+				continue;
+			const auto found = std::find(change.removedSlots.begin(), change.removedSlots.end(), t.adj[i]);
+			const size_t other = found - change.removedSlots.begin();
+			if (found != change.removedSlots.end() && other < k) // already seen from the other side
+				continue;
+			const MeshTriangle &n = (found != change.removedSlots.end()) ? change.removed[other] : mesh.triangles[t.adj[i]];
+			if (isRealTriangle(mesh, t) && isRealTriangle(mesh, n))
+				removed.push_back(Edge(Point((float)t.cx, (float)t.cy), Point((float)n.cx, (float)n.cy)));
 		}
-
-		maxPoints = input;
-
-		std::cout << "Please enter the minimum site distance between points(radius)." << std::endl;
-		std::cin >> radius;
-
-		if (radius < 0)
+	}
+	for (size_t k = 0; k < change.created.size(); k++)
+	{
+		const MeshTriangle &t = mesh.triangles[change.created[k]];
+		for (int i = 0; i < 3; i++)
 		{
-			std::cout << "Invalid input. Try again." << std::endl;
-			continue;
+			if (t.adj[i] == NO_TRIANGLE)
+				continue;
+			const auto found = std::find(change.created.begin(), change.created.end(), t.adj[i]);
+			if (found != change.created.end() && (size_t)(found - change.created.begin()) < k)
+				continue;
+			const MeshTriangle &n = mesh.triangles[t.adj[i]];
+			if (isRealTriangle(mesh, t) && isRealTriangle(mesh, n))
+				added.push_back(Edge(Point((float)t.cx, (float)t.cy), Point((float)n.cx, (float)n.cy)));
 		}
+	}
+}
 
-		minSiteDist = radius;
-
-		std::cout << "Generating random points using Poisson disk sampling." << std::endl;
-		std::vector<Point> sites = generateSites(maxPoints, minSiteDist, &error);	
-
-		if (error == 1)
+// The site nearest p, or -1 if the mesh has none: from the nearest corner of the triangle p falls in, step to any neighbour nearer p until there is
+// none (in a Delaunay triangulation that ends at the nearest site).
+int findNearestSite(Mesh &mesh, const Point &p)
+{
+	startNear(mesh, p);
+	const MeshTriangle &start = mesh.triangles[locateTriangle(mesh, p)];
+	int nearest = -1;
+	double distance = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < 3; i++)
+	{
+		const double dx = (double)mesh.points[start.v[i]].x - p.x, dy = (double)mesh.points[start.v[i]].y - p.y;
+		if (!isSuperCorner(mesh, start.v[i]) && dx * dx + dy * dy < distance)
 		{
-			error = 0;
-			cleardevice();
-			continue;
+			nearest = start.v[i];
+			distance = dx * dx + dy * dy;
 		}
+	}
+	for (int site = -1; site != nearest;)
+	{
+		site = nearest;
+		const int first = mesh.corners[site];
+		int t = first;
+		do
+		{
+			const MeshTriangle &tri = mesh.triangles[t];
+			const int i = (tri.v[0] == site) ? 0 : (tri.v[1] == site) ? 1 : 2, v = tri.v[(i + 1) % 3];
+			const double dx = (double)mesh.points[v].x - p.x, dy = (double)mesh.points[v].y - p.y;
+			if (!isSuperCorner(mesh, v) && dx * dx + dy * dy < distance)
+			{
+				nearest = v;
+				distance = dx * dx + dy * dy;
+			}
+			t = tri.adj[(i + 2) % 3];
+		} while (t != first);
+	}
+	return nearest;
+}
 
-		if (error == -1)
-			break;
+uint32_t getMortonCode(uint32_t x, uint32_t y) // interleaves the bits of two 16-bit numbers
+{
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
 
-		std::vector<Triangle> mesh = triangulate(sites);
-		std::cout << mesh.size() << " triangles generated after triangulation." << std::endl;
+// Builds the mesh of the sites inside a super triangle that holds all of them, inserting them in Morton order.
+void buildMesh(Mesh &mesh, const std::vector<Point> &siteList)
+{
+	const size_t n = siteList.size();
+	float minX = 0, minY = 0, maxX = WIDTH, maxY = HEIGHT;
+	for (const auto &site : siteList)
+	{
+		minX = std::min(minX, site.x);
+		minY = std::min(minY, site.y);
+		maxX = std::max(maxX, site.x);
+		maxY = std::max(maxY, site.y);
+	}
+	const float size = std::max(maxX - minX, maxY - minY), midX = (minX + maxX) / 2, midY = (minY + maxY) / 2;
+
+	mesh.points = siteList;
+	mesh.points.push_back(Point(midX - 1000 * size, midY - 1000 * size)); // far out, so that its circumcircles seldom cut into the hull
+	mesh.points.push_back(Point(midX + 1000 * size, midY - 1000 * size));
+	mesh.points.push_back(Point(midX, midY + 1000 * size));
+	mesh.corners.assign(mesh.points.size(), NO_TRIANGLE);
+	mesh.firstCorner = (int)n;
+	mesh.triangles.clear();
+	mesh.freeSlots.clear();
+	mesh.stamp = 0;
+	if (orient2d(mesh.points[n], mesh.points[n + 1], mesh.points[n + 2]) > 0)
+		mesh.last = addTriangle(mesh, (int)n, (int)n + 1, (int)n + 2);
+	else
+		mesh.last = addTriangle(mesh, (int)n, (int)n + 2, (int)n + 1);
+
+	std::vector<std::pair<uint32_t, int>> order(n);
+	const float scale = 65535 / std::max(size, EPSILON);
+	for (size_t i = 0; i < n; i++)
+		order[i] = { getMortonCode((uint32_t)((siteList[i].x - minX) * scale), (uint32_t)((siteList[i].y - minY) * scale)), (int)i };
+	std::sort(order.begin(), order.end());
+	mesh.order.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		mesh.order[i] = order[i].second;
+		insertSite(mesh, order[i].second);
+	}
+}
 
-		std::cout << "Do you want to draw the generated mesh? (1 = Yes / 0 = No)" << std::endl;
-		std::cin >> ch;
-		if (ch)
-		{
-			std::cout << "Drawing generated mesh." << std::endl;
-			drawMesh(mesh);
-		}
+// Bowyer-Watson algorithm for Delaunay triangulation. Kept for comparison: triangulate() uses the divide and conquer below.
+std::vector<Triangle> triangulateIncrementally(const std::vector<Point> &siteList)
+{
+	Mesh mesh;
+	std::vector<Triangle> meshList;
+	const int nSites = (int)siteList.size();
+	buildMesh(mesh, siteList);
 
-		std::cout << "Do you want to draw the generated Voronoi partition? (1 = Yes / 0 = No)" << std::endl;
-		std::cin >> ch;
-		if (ch)
+	// keep the triangles that do not touch the super triangle
+	for (const auto &t : mesh.triangles)
+		if (t.alive && t.v[0] < nSites && t.v[1] < nSites && t.v[2] < nSites)
+			meshList.push_back(Triangle(mesh.points[t.v[0]], mesh.points[t.v[1]], mesh.points[t.v[2]]));
+	return meshList;
+}
+
+// Lloyd's relaxation: every site moves to the centroid of its Voronoi cell, clipped to the rectangle the sites were sampled in, and again, and again,
+// each time spreading the sites more evenly, until none of them moves further than RELAX_TOLERANCE (a centroidal Voronoi tessellation). The cell of a
+// site is the polygon of the circumcentres of the triangles around it in the mesh. The centroids are worked out by threads, each taking a share of the
+// sites and reading the mesh nobody changes meanwhile; then the sites are moved in the mesh one after another, by flips where they can (see
+// relocateSite), so each iteration starts from the triangulation of the last rather than building one again.
+#define RELAX_TOLERANCE 0.01f // a site moving less than this (in pixels) has settled
+
+struct CellCorner
+{
+	double x, y;
+};
+
+// Keeps the part of a polygon where the x (axis 0) or y (axis 1) of its corners is at least limit (side 1) or at most limit (side -1).
+void clipCell(const std::vector<CellCorner> &polygon, std::vector<CellCorner> &clipped, const int &axis, const double &limit, const double &side)
+{
+	clipped.clear();
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const CellCorner &a = polygon[i], &b = polygon[(i + 1) % polygon.size()];
+		const double da = side * ((axis ? a.y : a.x) - limit), db = side * ((axis ? b.y : b.x) - limit);
+		if (da >= 0)
+			clipped.push_back(a);
+		if ((da >= 0) != (db >= 0))
+			clipped.push_back({ a.x + (b.x - a.x) * da / (da - db), a.y + (b.y - a.y) * da / (da - db) });
+	}
+}
+
+// Sets centroid to the centroid of the cell of a site, clipped to the rectangle, or to the site itself if nothing of the cell is left. Only the cells
+// that reach out of the rectangle are clipped.
+void getCellCentroid(const Mesh &mesh, const int &site, const float &left, const float &top, const float &right, const float &bottom,
+	std::vector<CellCorner> &polygon, std::vector<CellCorner> &clipped, Point &centroid)
+{
+	const Point &p = mesh.points[site];
+	bool inside = true;
+	polygon.clear();
+	const int first = mesh.corners[site];
+	int t = first;
+	do
+	{
+		const MeshTriangle &tri = mesh.triangles[t];
+		polygon.push_back({ tri.cx - p.x, tri.cy - p.y }); // relative to the site, to keep the sums below small
+		inside = inside && tri.cx >= left && tri.cx <= right && tri.cy >= top && tri.cy <= bottom;
+		t = tri.adj[(tri.v[0] == site) ? 2 : (tri.v[1] == site) ? 0 : 1];
+	} while (t != first);
+	if (!inside)
+	{
+		clipCell(polygon, clipped, 0, left - p.x, 1);
+		clipCell(clipped, polygon, 0, right - p.x, -1);
+		clipCell(polygon, clipped, 1, top - p.y, 1);
+		clipCell(clipped, polygon, 1, bottom - p.y, -1);
+	}
+
+	double area = 0, cx = 0, cy = 0;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const CellCorner &a = polygon[i], &b = polygon[(i + 1) % polygon.size()];
+		const double cross = a.x * b.y - b.x * a.y;
+		area += cross;
+		cx += (a.x + b.x) * cross;
+		cy += (a.y + b.y) * cross;
+	}
+	centroid.x = (area > 0) ? (float)(p.x + cx / (3 * area)) : p.x; // not Point(x, y), which counts points and is no place for threads
+	centroid.y = (area > 0) ? (float)(p.y + cy / (3 * area)) : p.y;
+}
+
+// The centroids of the cells of the sites buildMesh() was given (centroids[i] for mesh.points[i]), with nThreads threads, each taking a run of
+// mesh.order, so that the cells it reads lie together.
+void getCellCentroids(const Mesh &mesh, const float &left, const float &top, const float &right, const float &bottom, const int &nThreads,
+	std::vector<Point> &centroids)
+{
+	const int n = (int)mesh.order.size();
+	centroids.resize(mesh.points.size());
+	std::vector<std::thread> pool;
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back([&, t]()
+		{
+			std::vector<CellCorner> polygon, clipped;
+			for (int i = n * t / nThreads; i < n * (t + 1) / nThreads; i++)
+			{
+				const int site = mesh.order[i];
+				centroids[site] = mesh.points[site];
+				if (mesh.corners[site] != NO_TRIANGLE)
+					getCellCentroid(mesh, site, left, top, right, bottom, polygon, clipped, centroids[site]);
+			}
+		});
+	for (auto &thread : pool)
+		thread.join();
+}
+
+// Moves every site buildMesh() was given to the centroid of its cell once, with nThreads threads for the centroids, in mesh.order: the sites have moved
+// little since the mesh was built, so that order still keeps each walk and flip among triangles the last one touched. Returns how far the site that
+// moved furthest went.
+float relaxSites(Mesh &mesh, const float &left, const float &top, const float &right, const float &bottom, const int &nThreads, std::vector<Point> &centroids)
+{
+	getCellCentroids(mesh, left, top, right, bottom, nThreads, centroids);
+	float furthest = 0;
+	for (const int &site : mesh.order)
+	{
+		if (mesh.corners[site] == NO_TRIANGLE || isSamePlace(centroids[site], mesh.points[site]))
+			continue;
+		const float distance = getEuclideanDist(centroids[site], mesh.points[site]);
+		if (relocateSite(mesh, site, centroids[site]))
+			furthest = std::max(furthest, distance);
+	}
+	return furthest;
+}
+
+// Guibas and Stolfi's divide and conquer Delaunay triangulation. The sites are sorted by x once; each half is triangulated on its own, and the two are
+// zipped together from the bottom of their common tangent up, deleting the edges of either half whose circumcircles the other half's sites fall into. The
+// two halves share nothing until the merge, so near the top of the recursion the left half goes to a new thread; the merges of each level run in parallel
+// the same way, and only the merges at the top, which walk along the seam of the two halves, are one thread's work.
+//
+// The triangulation is kept as a quad-edge structure: every edge is four records, one for each direction along it and one for each face beside it, and
+// each record points to the next record counter-clockwise around its vertex or face (see https://en.wikipedia.org/wiki/Quad-edge). Edges are numbered
+// 4 * quad + rotation and live in flat arrays; a planar graph of n vertices has fewer than 3n edges, so 3 quads for each site are set aside up front,
+// and each half of the recursion allocates from its own share of them, reusing the edges it deletes.
+#define DELAUNAY_PARALLEL_SITES 50000 // halves smaller than this are not worth a thread
+
+struct SortedSite
+{
+	float x, y;
+	int site; // index into the sites passed in
+};
+
+struct DelaunayGraph
+{
+	std::vector<SortedSite> sites; // sorted by x, then y, without duplicates
+	std::vector<int> next; // onext of each edge record
+	std::vector<int> origin; // the vertex (index into sites) a directed edge starts from; -1 for a quad not in use
+};
+
+struct EdgePool // the quads a part of the recursion allocates from
+{
+	std::vector<int> freeQuads;
+	int next, end;
+};
+
+inline int rot(const int &e) { return (e & ~3) | ((e + 1) & 3); }
+inline int rotInv(const int &e) { return (e & ~3) | ((e + 3) & 3); }
+inline int sym(const int &e) { return e ^ 2; }
+inline int org(const DelaunayGraph &g, const int &e) { return g.origin[e >> 1]; } // e must be a directed edge, rotation 0 or 2
+inline int dest(const DelaunayGraph &g, const int &e) { return g.origin[sym(e) >> 1]; }
+inline int onext(const DelaunayGraph &g, const int &e) { return g.next[e]; }
+inline int oprev(const DelaunayGraph &g, const int &e) { return rot(g.next[rot(e)]); }
+inline int lnext(const DelaunayGraph &g, const int &e) { return rot(g.next[rotInv(e)]); }
+inline int rprev(const DelaunayGraph &g, const int &e) { return g.next[sym(e)]; }
+
+inline double orient2d(const SortedSite &a, const SortedSite &b, const SortedSite &c)
+{
+	return orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+
+// whether d lies inside the circle through a, b and c (counter-clockwise)
+inline bool isInCircle(const SortedSite &a, const SortedSite &b, const SortedSite &c, const SortedSite &d)
+{
+	return incircle(a.x, a.y, b.x, b.y, c.x, c.y, d.x, d.y) > 0;
+}
+
+inline bool isRightOf(const DelaunayGraph &g, const int &x, const int &e)
+{
+	return orient2d(g.sites[x], g.sites[dest(g, e)], g.sites[org(g, e)]) > 0;
+}
+
+inline bool isLeftOf(const DelaunayGraph &g, const int &x, const int &e)
+{
+	return orient2d(g.sites[x], g.sites[org(g, e)], g.sites[dest(g, e)]) > 0;
+}
+
+int makeEdge(DelaunayGraph &g, EdgePool &pool, const int &a, const int &b)
+{
+	int q = pool.next;
+	if (!pool.freeQuads.empty())
+	{
+		q = pool.freeQuads.back();
+		pool.freeQuads.pop_back();
+	}
+	else
+		pool.next++;
+	const int e = 4 * q;
+	g.next[e] = e;
+	g.next[e + 1] = e + 3;
+	g.next[e + 2] = e + 2;
+	g.next[e + 3] = e + 1;
+	g.origin[2 * q] = a;
+	g.origin[2 * q + 1] = b;
+	return e;
+}
+
+void splice(DelaunayGraph &g, const int &a, const int &b)
+{
+	const int alpha = rot(g.next[a]), beta = rot(g.next[b]);
+	std::swap(g.next[a], g.next[b]);
+	std::swap(g.next[alpha], g.next[beta]);
+}
+
+// Adds an edge from the end of a to the start of b, in the face left of both.
+int connect(DelaunayGraph &g, EdgePool &pool, const int &a, const int &b)
+{
+	const int e = makeEdge(g, pool, dest(g, a), org(g, b));
+	splice(g, e, lnext(g, a));
+	splice(g, sym(e), b);
+	return e;
+}
+
+void deleteEdge(DelaunayGraph &g, EdgePool &pool, const int &e)
+{
+	splice(g, e, oprev(g, e));
+	splice(g, sym(e), oprev(g, sym(e)));
+	g.origin[e >> 1] = g.origin[sym(e) >> 1] = -1;
+	pool.freeQuads.push_back(e >> 2);
+}
+
+// Triangulates the sites [lo, hi) with up to nThreads threads. Returns the counter-clockwise hull edge out of the leftmost site in left, and the clockwise
+// hull edge out of the rightmost site in right.
+void triangulateSites(DelaunayGraph &g, EdgePool &pool, const int &lo, const int &hi, const int &nThreads, int &left, int &right)
+{
+	const int n = hi - lo;
+	if (n == 2)
+	{
+		left = makeEdge(g, pool, lo, lo + 1);
+		right = sym(left);
+		return;
+	}
+	if (n == 3)
+	{
+		const int a = makeEdge(g, pool, lo, lo + 1), b = makeEdge(g, pool, lo + 1, lo + 2);
+		splice(g, sym(a), b);
+		const double turn = orient2d(g.sites[lo], g.sites[lo + 1], g.sites[lo + 2]);
+		if (turn > 0)
+		{
+			connect(g, pool, b, a);
+			left = a;
+			right = sym(b);
+		}
+		else if (turn < 0)
+		{
+			const int c = connect(g, pool, b, a);
+			left = sym(c);
+			right = c;
+		}
+		else // collinear: leave them a chain
+		{
+			left = a;
+			right = sym(b);
+		}
+		return;
+	}
+
+	const int mid = lo + n / 2;
+	int ldo, ldi, rdi, rdo;
+	if (nThreads > 1 && n >= DELAUNAY_PARALLEL_SITES)
+	{
+		EdgePool leftPool;
+		leftPool.next = 3 * lo;
+		leftPool.end = 3 * mid;
+		pool.next = std::max(pool.next, 3 * mid); // the right half takes over the rest of this pool
+		std::thread worker([&]()
+		{
+			triangulateSites(g, leftPool, lo, mid, nThreads / 2, ldo, ldi);
+		});
+		triangulateSites(g, pool, mid, hi, nThreads - nThreads / 2, rdi, rdo);
+		worker.join();
+		for (int q = leftPool.next; q < leftPool.end; q++)
+			pool.freeQuads.push_back(q);
+		pool.freeQuads.insert(pool.freeQuads.end(), leftPool.freeQuads.begin(), leftPool.freeQuads.end());
+	}
+	else
+	{
+		triangulateSites(g, pool, lo, mid, 1, ldo, ldi);
+		triangulateSites(g, pool, mid, hi, 1, rdi, rdo);
+	}
+
+	// the lower common tangent of the two halves
+	for (;;)
+	{
+		if (isLeftOf(g, org(g, rdi), ldi))
+			ldi = lnext(g, ldi);
+		else if (isRightOf(g, org(g, ldi), rdi))
+			rdi = rprev(g, rdi);
+		else
+			break;
+	}
+	int base = connect(g, pool, sym(rdi), ldi);
+	if (org(g, ldi) == org(g, ldo))
+		ldo = sym(base);
+	if (org(g, rdi) == org(g, rdo))
+		rdo = base;
+
+	// zip the halves together, up from the tangent
+	for (;;)
+	{
+		int lcand = onext(g, sym(base)), rcand = oprev(g, base);
+		const bool leftValid = isRightOf(g, dest(g, lcand), base);
+		if (leftValid)
+			while (isInCircle(g.sites[dest(g, base)], g.sites[org(g, base)], g.sites[dest(g, lcand)], g.sites[dest(g, onext(g, lcand))]))
+			{
+				const int t = onext(g, lcand);
+				deleteEdge(g, pool, lcand);
+				lcand = t;
+			}
+		const bool rightValid = isRightOf(g, dest(g, rcand), base);
+		if (rightValid)
+			while (isInCircle(g.sites[dest(g, base)], g.sites[org(g, base)], g.sites[dest(g, rcand)], g.sites[dest(g, oprev(g, rcand))]))
+			{
+				const int t = oprev(g, rcand);
+				deleteEdge(g, pool, rcand);
+				rcand = t;
+			}
+		if (!leftValid && !rightValid) // base is the upper common tangent
+			break;
+		if (!leftValid || (rightValid && isInCircle(g.sites[dest(g, lcand)], g.sites[org(g, lcand)], g.sites[org(g, rcand)], g.sites[dest(g, rcand)])))
+			base = connect(g, pool, rcand, sym(base));
+		else
+			base = connect(g, pool, sym(base), sym(lcand));
+	}
+	left = ldo;
+	right = rdo;
+}
+
+// Sorts with nThreads threads: each sorts a slice, then pairs of sorted runs are merged, in parallel, until one is left.
+template <class T, class Less>
+void parallelSort(std::vector<T> &items, const int &nThreads, const Less &less)
+{
+	std::vector<size_t> bounds;
+	for (int t = 0; t <= nThreads; t++)
+		bounds.push_back(items.size() * t / nThreads);
+	std::vector<std::thread> pool;
+	for (int t = 0; t < nThreads; t++)
+		pool.emplace_back([&, t]()
+		{
+			std::sort(items.begin() + bounds[t], items.begin() + bounds[t + 1], less);
+		});
+	for (auto &thread : pool)
+		thread.join();
+
+	std::vector<T> merged(items.size());
+	while (bounds.size() > 2)
+	{
+		std::vector<size_t> runs;
+		pool.clear();
+		for (size_t r = 0; r + 1 < bounds.size(); r += 2)
+		{
+			runs.push_back(bounds[r]);
+			const size_t first = bounds[r], middle = bounds[r + 1], last = bounds[std::min(r + 2, bounds.size() - 1)];
+			pool.emplace_back([&, first, middle, last]()
+			{
+				std::merge(items.begin() + first, items.begin() + middle, items.begin() + middle, items.begin() + last, merged.begin() + first, less);
+			});
+		}
+		runs.push_back(items.size());
+		for (auto &thread : pool)
+			thread.join();
+		items.swap(merged);
+		bounds = runs;
+	}
+}
+
+// Copies the sites into g, sorted by x and then y, with nThreads threads, and drops duplicates.
+void sortSites(DelaunayGraph &g, const std::vector<Point> &siteList, const int &nThreads)
+{
+	g.sites.resize(siteList.size());
+	for (size_t i = 0; i < siteList.size(); i++)
+		g.sites[i] = { siteList[i].x, siteList[i].y, (int)i };
+	parallelSort(g.sites, nThreads, [](const SortedSite &a, const SortedSite &b)
+	{
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+	g.sites.erase(std::unique(g.sites.begin(), g.sites.end(), [](const SortedSite &a, const SortedSite &b)
+	{
+		return a.x == b.x && a.y == b.y;
+	}), g.sites.end());
+}
+
+// Triangulates the sorted sites of g with nThreads threads.
+void linkSites(DelaunayGraph &g, const int &nThreads)
+{
+	const int n = (int)g.sites.size();
+	g.next.assign((size_t)12 * n, 0);
+	g.origin.assign((size_t)6 * n, -1);
+	if (n < 2)
+		return;
+	EdgePool pool;
+	pool.next = 0;
+	pool.end = 3 * n;
+	int left, right;
+	triangulateSites(g, pool, 0, n, nThreads, left, right);
+}
+
+// Delaunay triangulation, by divide and conquer on all cores
+std::vector<Triangle> triangulate(const std::vector<Point> &siteList)
+{
+	DelaunayGraph g;
+	std::vector<Triangle> meshList;
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	sortSites(g, siteList, nThreads);
+	linkSites(g, nThreads);
+
+	// every face left of an edge that closes after three steps counter-clockwise is a triangle; the outside of a triangular hull closes clockwise
+	std::vector<bool> visited(g.origin.size(), false);
+	for (int e = 0; e < (int)g.next.size(); e += 2)
+	{
+		if (visited[e >> 1] || g.origin[e >> 1] < 0)
+			continue;
+		const int e2 = lnext(g, e), e3 = lnext(g, e2);
+		if (lnext(g, e3) != e)
+			continue;
+		visited[e >> 1] = visited[e2 >> 1] = visited[e3 >> 1] = true;
+		const SortedSite &a = g.sites[org(g, e)], &b = g.sites[org(g, e2)], &c = g.sites[org(g, e3)];
+		if (orient2d(a, b, c) > 0)
+			meshList.push_back(Triangle(siteList[a.site], siteList[b.site], siteList[c.site]));
+	}
+	return meshList;
+}
+
+// Times the divide and conquer triangulation of ten million random sites on 1 to 32 threads, the sort and the recursion apart.
+void benchmarkTriangulation()
+{
+	const size_t n = 10000000;
+	std::default_random_engine engine(12345);
+	std::uniform_real_distribution<float> rndX(0, WIDTH), rndY(0, HEIGHT);
+	std::vector<Point> sites;
+	sites.reserve(n);
+	for (size_t i = 0; i < n; i++)
+		sites.push_back(Point(rndX(engine), rndY(engine)));
+	printf("%zu sites on %u cores.\n", n, std::thread::hardware_concurrency());
+	printf("%8s %14s %14s %10s\n", "threads", "total (ms)", "sort (ms)", "speed-up");
+	double single = 0;
+	for (int nThreads = 1; nThreads <= 32; nThreads *= 2)
+	{
+		DelaunayGraph g;
+		auto start = std::chrono::high_resolution_clock::now();
+		sortSites(g, sites, nThreads);
+		auto sorted = std::chrono::high_resolution_clock::now();
+		linkSites(g, nThreads);
+		auto stop = std::chrono::high_resolution_clock::now();
+		const double total = std::chrono::duration<double, std::milli>(stop - start).count();
+		if (nThreads == 1)
+			single = total;
+		printf("%8d %14.1f %14.1f %10.2f\n", nThreads, total, std::chrono::duration<double, std::milli>(sorted - start).count(), single / total);
+	}
+}
+
+// Poisson disk sampling with Bridson's algorithm: random points no closer than a radius r to each other, spread evenly with no visible pattern. A grid of
+// cells r / sqrt(2) wide, small enough to hold at most one sample each, tells which samples are near a candidate, so checking one takes a look at 21 cells
+// rather than every sample. New samples are tried around the ones already placed, in the ring between r and 2r, until none of them has room left.
+//
+// For millions of samples the grid is split into tiles, taken in four phases by their parity in x and y: tiles of one phase are a whole tile apart, so
+// threads can fill them at once without ever reading a cell another thread writes. The samples along the edges of the finished neighbouring tiles seed
+// each tile, so the phases leave no seams. Every tile draws its random numbers from a generator seeded by the seed and the tile, so the result does not
+// depend on the number of threads.
+#define SAMPLING_TRIES 30 // candidates tried around a sample before giving up on it
+#define SAMPLING_TILE 32 // cells across a tile of the parallel sampler
+
+struct Random // xorshift64*: fast, and unlike the std distributions gives the same numbers with every compiler
+{
+	uint64_t state;
+
+	Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+	float next() // uniform in [0, 1)
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return ((state * 0x2545F4914F6CDD1DULL) >> 40) * (1.0f / 16777216.0f);
+	}
+};
+
+struct Sample
+{
+	float x, y; // x < 0 for an empty cell
+};
+
+struct SamplingGrid
+{
+	float radius, cellSize, width, height;
+	int columns, rows;
+	std::vector<Sample> cells;
+};
+
+bool hasRoom(const SamplingGrid &grid, const float &x, const float &y)
+{
+	const int cx = (int)(x / grid.cellSize), cy = (int)(y / grid.cellSize);
+	for (int j = std::max(0, cy - 2); j <= std::min(grid.rows - 1, cy + 2); j++)
+		for (int i = std::max(0, cx - 2); i <= std::min(grid.columns - 1, cx + 2); i++)
+		{
+			if (abs(i - cx) == 2 && abs(j - cy) == 2) // a corner cell is at least r away
+				continue;
+			const Sample &s = grid.cells[(size_t)j * grid.columns + i];
+			if (s.x >= 0 && (s.x - x) * (s.x - x) + (s.y - y) * (s.y - y) < grid.radius * grid.radius)
+				return false;
+		}
+	return true;
+}
+
+// Puts s in its cell if that is one of [x0, x1) x [y0, y1) and nothing is too close.
+bool placeSample(SamplingGrid &grid, const Sample &s, const int &x0, const int &y0, const int &x1, const int &y1)
+{
+	if (s.x < 0 || s.y < 0 || s.x >= grid.width || s.y >= grid.height)
+		return false;
+	const int cx = (int)(s.x / grid.cellSize), cy = (int)(s.y / grid.cellSize);
+	if (cx < x0 || cx >= x1 || cy < y0 || cy >= y1 || !hasRoom(grid, s.x, s.y))
+		return false;
+	grid.cells[(size_t)cy * grid.columns + cx] = s;
+	return true;
+}
+
+// Fills the cells [x0, x1) x [y0, y1) of the grid. Cells outside them are only read.
+void sampleTile(SamplingGrid &grid, const int &x0, const int &y0, const int &x1, const int &y1, const uint64_t &seed)
+{
+	Random random(seed);
+	std::vector<Sample> active;
+
+	// the samples of the neighbouring tiles within reach of this one
+	for (int j = std::max(0, y0 - 2); j < std::min(grid.rows, y1 + 2); j++)
+		for (int i = std::max(0, x0 - 2); i < std::min(grid.columns, x1 + 2); i++)
+			if (grid.cells[(size_t)j * grid.columns + i].x >= 0)
+				active.push_back(grid.cells[(size_t)j * grid.columns + i]);
+	for (int n = 0; n < SAMPLING_TRIES && active.empty(); n++)
+	{
+		const Sample s = { (x0 + random.next() * (x1 - x0)) * grid.cellSize, (y0 + random.next() * (y1 - y0)) * grid.cellSize };
+		if (placeSample(grid, s, x0, y0, x1, y1))
+			active.push_back(s);
+	}
+
+	while (!active.empty())
+	{
+		const size_t a = std::min(active.size() - 1, (size_t)(random.next() * active.size()));
+		const Sample around = active[a];
+		bool placed = false;
+		for (int n = 0; n < SAMPLING_TRIES && !placed; n++)
+		{
+			const float angle = random.next() * 6.2831853f, distance = grid.radius * std::sqrt(1 + 3 * random.next()); // uniform over the ring
+			const Sample s = { around.x + distance * std::cos(angle), around.y + distance * std::sin(angle) };
+			if (placeSample(grid, s, x0, y0, x1, y1))
+			{
+				active.push_back(s);
+				placed = true;
+			}
+		}
+		if (!placed)
+		{
+			active[a] = active.back();
+			active.pop_back();
+		}
+	}
+}
+
+// Generates up to maxPoints sites at least radius apart inside the padded window; the same seed gives the same sites. Fewer come back only if no more fit.
+// When the radius leaves room for many more sites than asked for, it is raised so that the sampling fills the window with not much more than maxPoints
+// samples, and maxPoints of them are picked at random, so the sites are spread over the whole window and the time taken depends on maxPoints alone.
+std::vector<Point> generateSites(size_t maxPoints, float radius, const uint64_t &seed)
+{
+	std::vector<Point> siteList;
+	if (maxPoints == 0)
+		return siteList;
+
+	SamplingGrid grid;
+	grid.width = WIDTH - 2 * PADDING;
+	grid.height = HEIGHT - 2 * PADDING;
+	grid.radius = std::max(radius, std::sqrt(grid.width * grid.height / (2.0f * maxPoints))); // Bridson fills about 0.7 / r^2 samples per unit area
+	grid.cellSize = grid.radius / std::sqrt(2.0f);
+	grid.columns = (int)ceil(grid.width / grid.cellSize);
+	grid.rows = (int)ceil(grid.height / grid.cellSize);
+	grid.cells.assign((size_t)grid.columns * grid.rows, Sample({ -1, -1 }));
+
+	const int tilesX = (grid.columns + SAMPLING_TILE - 1) / SAMPLING_TILE, tilesY = (grid.rows + SAMPLING_TILE - 1) / SAMPLING_TILE;
+	if (tilesX * tilesY < 16) // too few tiles to be worth the threads
+		sampleTile(grid, 0, 0, grid.columns, grid.rows, seed);
+	else
+	{
+		const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (int phase = 0; phase < 4; phase++)
+		{
+			std::vector<int> tiles;
+			for (int ty = phase / 2; ty < tilesY; ty += 2)
+				for (int tx = phase % 2; tx < tilesX; tx += 2)
+					tiles.push_back(ty * tilesX + tx);
+			std::atomic<size_t> next(0);
+			std::vector<std::thread> pool;
+			for (int t = 0; t < nThreads; t++)
+				pool.emplace_back([&]()
+				{
+					for (size_t i = next++; i < tiles.size(); i = next++)
+					{
+						const int tx = tiles[i] % tilesX, ty = tiles[i] / tilesX;
+						sampleTile(grid, tx * SAMPLING_TILE, ty * SAMPLING_TILE, std::min(grid.columns, (tx + 1) * SAMPLING_TILE),
+							std::min(grid.rows, (ty + 1) * SAMPLING_TILE), seed + 0x100000000ULL * (tiles[i] + 1));
+					}
+				});
+			for (auto &thread : pool)
+				thread.join();
+		}
+	}
+
+	for (const Sample &s : grid.cells)
+		if (s.x >= 0)
+			siteList.push_back(Point(PADDING + s.x, PADDING + s.y));
+	if (siteList.size() > maxPoints)
+	{
+		Random random(seed);
+		for (size_t i = 0; i < maxPoints; i++) // the first maxPoints places of a Fisher-Yates shuffle
+			std::swap(siteList[i], siteList[i + std::min(siteList.size() - i - 1, (size_t)(random.next() * (siteList.size() - i)))]);
+		siteList.resize(maxPoints);
+	}
+	for (const auto &site : siteList)
+		site.draw(CYAN);
+	return siteList;
+}
+
+void drawMesh(const std::vector<Triangle> &meshList)
+{
+	for (const auto& triangle : meshList)
+		triangle.draw(LIGHTRED);
+}
+
+/**
+	The Vorornoi pattern is the dual graph of the Delaunay triangulation.
+	This function generates the resulting Voronoi pettern from the input
+	Delaunay triangulated mesh.
+*/
+void drawVoronoiPattern(const std::vector<Triangle>& mesh)
+{
+	for (size_t i = 0; i < mesh.size(); ++i)
+	{
+		Circle circumCircle = getCircumCircle(mesh[i]);
+		for (size_t j = 0; j < mesh.size(); ++j)
+		{
+			if (mesh[i].isNeighborOf(mesh[j]))
+			{
+				Circle circumCircleNeighbor = getCircumCircle(mesh[j]);
+
+#ifndef NDEBUG
+				circumCircle.draw(LIGHTBLUE); // for debugging
+				circumCircleNeighbor.draw(LIGHTBLUE); // for debugging
+#endif
+				setcolor(YELLOW);
+				line(circumCircle.center.x, circumCircle.center.y, circumCircleNeighbor.center.x, circumCircleNeighbor.center.y);
+			}
+		}
+	}
+}
+
+// Fortune's sweep-line algorithm: builds the Voronoi edges directly, in O(n log n), without the triangulation. A line sweeps down the window (y growing)
+// past the sites. Behind it, the diagram is final; along it runs the beach line, made of parabolic arcs, one per site that is closer to the points
+// just behind it than the sweep line is. The points where two arcs meet trace the Voronoi edges. A site reached by the sweep line splits the arc above it
+// (a site event), and an arc that shrinks to nothing leaves a Voronoi vertex, where its two breakpoints meet (a circle event, found when the three arcs
+// around it become neighbours).
+//
+// The arcs are kept in a treap ordered by their place along the beach line, so finding the arc above a site and inserting or removing one take O(log n)
+// expected steps; arcs hold no keys, since where an arc starts and ends depends on the position of the sweep line and is worked out while searching.
+// Circle events wait in a priority queue; an event whose arc changes before it happens is marked invalid and skipped when it comes up.
+struct Arc
+{
+	int site;
+	int left, right, parent; // the treap, in beach line order
+	int prev, next; // the neighbouring arcs along the beach line
+	unsigned priority; // the treap is a heap on these (smallest at the root)
+	int event; // the circle event that would remove this arc, or -1
+	int edge; // the edge traced by the breakpoint between this arc and the next
+};
+
+struct CircleEvent
+{
+	double y; // when it happens: the bottom of the circle
+	double x, cy; // the centre of the circle, the Voronoi vertex
+	int arc; // the arc it removes
+	bool valid;
+};
+
+struct SweepEdge // half of a Voronoi edge, traced by one breakpoint
+{
+	double x, y; // where it starts
+	double dx, dy; // the direction the breakpoint moves in
+	double ex, ey; // where it ends, once ended
+	bool ended;
+};
+
+struct BeachLine
+{
+	const std::vector<Point> *sites;
+	std::vector<Arc> arcs;
+	std::vector<int> freeArcs;
+	std::vector<CircleEvent> events;
+	std::vector<SweepEdge> edges;
+	std::vector<std::pair<double, int>> queue; // (when, event), a min-heap
+	int root;
+	float firstRow; // the y of the first site
+	uint32_t seed;
+};
+
+// The x where the arc of site a (on the left) meets the arc of site b (on the right) with the sweep line at y = l.
+double getBreakpointX(const Point &a, const Point &b, const double &l)
+{
+	if (a.y == b.y)
+		return ((double)a.x + b.x) / 2;
+	if (a.y == l)
+		return a.x;
+	if (b.y == l)
+		return b.x;
+	// arc of site f: y = ((x - f.x)^2 + f.y^2 - l^2) / (2 (f.y - l))
+	const double da = 2 * (a.y - l), db = 2 * (b.y - l);
+	const double qa = 1 / da - 1 / db, qb = -2 * (a.x / da - b.x / db), qc = (double)a.x * a.x / da - (double)b.x * b.x / db + ((double)a.y - b.y) / 2;
+	const double root = sqrt(std::max(0.0, qb * qb - 4 * qa * qc));
+	const double x1 = (-qb - root) / (2 * qa), x2 = (-qb + root) / (2 * qa);
+	// between the two crossings the narrower arc (the site nearer the sweep line) is the one on the beach line
+	return (a.y > b.y) ? std::max(x1, x2) : std::min(x1, x2);
+}
+
+int newArc(BeachLine &beach, const int site) // by value: the site may be read out of beach.arcs, which this can move
+{
+	int index = (int)beach.arcs.size();
+	if (!beach.freeArcs.empty())
+	{
+		index = beach.freeArcs.back();
+		beach.freeArcs.pop_back();
+	}
+	else
+		beach.arcs.push_back(Arc());
+	beach.seed ^= beach.seed << 13; // xorshift32
+	beach.seed ^= beach.seed >> 17;
+	beach.seed ^= beach.seed << 5;
+	Arc &arc = beach.arcs[index];
+	arc.site = site;
+	arc.left = arc.right = arc.parent = arc.prev = arc.next = -1;
+	arc.priority = beach.seed;
+	arc.event = -1;
+	arc.edge = -1;
+	return index;
+}
+
+int newEdge(BeachLine &beach, const double &x, const double &y, const Point &left, const Point &right)
+{
+	SweepEdge e;
+	e.x = x;
+	e.y = y;
+	e.dx = (double)left.y - right.y; // perpendicular to the two sites, turning the way the breakpoint moves
+	e.dy = (double)right.x - left.x;
+	e.ex = e.ey = 0;
+	e.ended = false;
+	beach.edges.push_back(e);
+	return (int)beach.edges.size() - 1;
+}
+
+void endEdge(BeachLine &beach, const int &edge, const double &x, const double &y)
+{
+	beach.edges[edge].ex = x;
+	beach.edges[edge].ey = y;
+	beach.edges[edge].ended = true;
+}
+
+// Makes arc x take the place of its parent in the treap.
+void rotateUp(BeachLine &beach, const int &x)
+{
+	std::vector<Arc> &arcs = beach.arcs;
+	const int p = arcs[x].parent, g = arcs[p].parent;
+	if (arcs[p].left == x)
+	{
+		arcs[p].left = arcs[x].right;
+		if (arcs[x].right >= 0)
+			arcs[arcs[x].right].parent = p;
+		arcs[x].right = p;
+	}
+	else
+	{
+		arcs[p].right = arcs[x].left;
+		if (arcs[x].left >= 0)
+			arcs[arcs[x].left].parent = p;
+		arcs[x].left = p;
+	}
+	arcs[p].parent = x;
+	arcs[x].parent = g;
+	if (g < 0)
+		beach.root = x;
+	else if (arcs[g].left == p)
+		arcs[g].left = x;
+	else
+		arcs[g].right = x;
+}
+
+// Puts arc n right after arc a along the beach line.
+void insertArcAfter(BeachLine &beach, const int &a, const int &n)
+{
+	std::vector<Arc> &arcs = beach.arcs;
+	arcs[n].prev = a;
+	arcs[n].next = arcs[a].next;
+	if (arcs[a].next >= 0)
+		arcs[arcs[a].next].prev = n;
+	arcs[a].next = n;
+	if (arcs[a].right < 0) // then n goes right below a, else right below a's old successor (which has no left child)
+	{
+		arcs[a].right = n;
+		arcs[n].parent = a;
+	}
+	else
+	{
+		arcs[arcs[n].next].left = n;
+		arcs[n].parent = arcs[n].next;
+	}
+	while (arcs[n].parent >= 0 && arcs[arcs[n].parent].priority > arcs[n].priority)
+		rotateUp(beach, n);
+}
+
+void removeArc(BeachLine &beach, const int &x)
+{
+	std::vector<Arc> &arcs = beach.arcs;
+	while (arcs[x].left >= 0 || arcs[x].right >= 0) // rotate it down to a leaf
+	{
+		const int l = arcs[x].left, r = arcs[x].right;
+		rotateUp(beach, (r < 0 || (l >= 0 && arcs[l].priority < arcs[r].priority)) ? l : r);
+	}
+	const int p = arcs[x].parent;
+	if (p < 0)
+		beach.root = -1;
+	else if (arcs[p].left == x)
+		arcs[p].left = -1;
+	else
+		arcs[p].right = -1;
+	if (arcs[x].prev >= 0)
+		arcs[arcs[x].prev].next = arcs[x].next;
+	if (arcs[x].next >= 0)
+		arcs[arcs[x].next].prev = arcs[x].prev;
+	beach.freeArcs.push_back(x);
+}
+
+// The arc above x with the sweep line at l.
+int findArc(const BeachLine &beach, const double &x, const double &l)
+{
+	const std::vector<Arc> &arcs = beach.arcs;
+	const std::vector<Point> &sites = *beach.sites;
+	int a = beach.root;
+	for (;;)
+	{
+		const Arc &arc = arcs[a];
+		if (arc.prev >= 0 && arc.left >= 0 && x < getBreakpointX(sites[arcs[arc.prev].site], sites[arc.site], l))
+			a = arc.left;
+		else if (arc.next >= 0 && arc.right >= 0 && x > getBreakpointX(sites[arc.site], sites[arcs[arc.next].site], l))
+			a = arc.right;
+		else
+			return a;
+	}
+}
+
+void cancelEvent(BeachLine &beach, const int &arc)
+{
+	if (beach.arcs[arc].event >= 0)
+		beach.events[beach.arcs[arc].event].valid = false;
+	beach.arcs[arc].event = -1;
+}
+
+// Queues the circle event of arc b, if its two breakpoints are heading towards each other.
+void checkCircleEvent(BeachLine &beach, const int &b, const double &l)
+{
+	const Arc &arc = beach.arcs[b];
+	if (arc.prev < 0 || arc.next < 0)
+		return;
+	const std::vector<Point> &sites = *beach.sites;
+	const Point &a = sites[beach.arcs[arc.prev].site], &p = sites[arc.site], &c = sites[beach.arcs[arc.next].site];
+	const double bx = (double)p.x - a.x, by = (double)p.y - a.y, cx = (double)c.x - a.x, cy = (double)c.y - a.y;
+	const double d = 2 * (bx * cy - by * cx);
+	if (d <= 0) // the breakpoints move apart (or in parallel)
+		return;
+	const double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+	const double ux = (cy * b2 - by * c2) / d, uy = (bx * c2 - cx * b2) / d;
+	const double y = a.y + uy + sqrt(ux * ux + uy * uy);
+	if (y < l - 1e-9 * std::max(1.0, fabs(l))) // already behind the sweep line
+		return;
+	CircleEvent event = { y, a.x + ux, a.y + uy, b, true };
+	beach.events.push_back(event);
+	beach.arcs[b].event = (int)beach.events.size() - 1;
+	beach.queue.push_back({ y, beach.arcs[b].event });
+	std::push_heap(beach.queue.begin(), beach.queue.end(), std::greater<std::pair<double, int>>());
+}
+
+void addSite(BeachLine &beach, const int &site)
+{
+	const std::vector<Point> &sites = *beach.sites;
+	const Point &p = sites[site];
+	if (beach.root < 0)
+	{
+		beach.root = newArc(beach, site);
+		beach.firstRow = p.y;
+		return;
+	}
+	if (beach.firstRow == p.y) // still on the first row of sites: every arc is a vertical line, so p goes at the right end
+	{
+		int last = beach.root;
+		while (beach.arcs[last].next >= 0)
+			last = beach.arcs[last].next;
+		const Point &q = sites[beach.arcs[last].site];
+		if (q == p)
+			return;
+		const int n = newArc(beach, site);
+		insertArcAfter(beach, last, n);
+		beach.arcs[last].edge = newEdge(beach, ((double)q.x + p.x) / 2, -1e30, q, p); // from far above the window
+		return;
+	}
+
+	const int a = findArc(beach, p.x, p.y);
+	const Point &q = sites[beach.arcs[a].site];
+	if (q == p)
+		return;
+	cancelEvent(beach, a);
+	const double y = (((double)p.x - q.x) * ((double)p.x - q.x) + (double)q.y * q.y - (double)p.y * p.y) / (2 * ((double)q.y - p.y));
+	const int b = newArc(beach, site), rest = newArc(beach, beach.arcs[a].site); // a is split in two, with b in between
+	insertArcAfter(beach, a, b);
+	insertArcAfter(beach, b, rest);
+	beach.arcs[rest].edge = beach.arcs[a].edge;
+	beach.arcs[a].edge = newEdge(beach, p.x, y, q, p);
+	beach.arcs[b].edge = newEdge(beach, p.x, y, p, q);
+	checkCircleEvent(beach, a, p.y);
+	checkCircleEvent(beach, rest, p.y);
+}
+
+void removeArcAt(BeachLine &beach, const CircleEvent &event)
+{
+	const std::vector<Point> &sites = *beach.sites;
+	const int b = event.arc, a = beach.arcs[b].prev, c = beach.arcs[b].next;
+	endEdge(beach, beach.arcs[a].edge, event.x, event.cy);
+	endEdge(beach, beach.arcs[b].edge, event.x, event.cy);
+	cancelEvent(beach, a);
+	cancelEvent(beach, c);
+	removeArc(beach, b);
+	beach.arcs[a].edge = newEdge(beach, event.x, event.cy, sites[beach.arcs[a].site], sites[beach.arcs[c].site]);
+	checkCircleEvent(beach, a, event.y);
+	checkCircleEvent(beach, c, event.y);
+}
+
+// Clips the segment from (x1, y1) to (x2, y2) to the rectangle (Liang-Barsky). Returns false if nothing is left.
+bool clipSegment(double &x1, double &y1, double &x2, double &y2, const double &left, const double &top, const double &right, const double &bottom)
+{
+	const double dx = x2 - x1, dy = y2 - y1;
+	const double p[4] = { -dx, dx, -dy, dy }, q[4] = { x1 - left, right - x1, y1 - top, bottom - y1 };
+	double t0 = 0, t1 = 1;
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0)
+		{
+			if (q[i] < 0)
+				return false;
+			continue;
+		}
+		const double t = q[i] / p[i];
+		if (p[i] < 0)
+			t0 = std::max(t0, t);
+		else
+			t1 = std::min(t1, t);
+	}
+	if (t0 > t1)
+		return false;
+	x2 = x1 + t1 * dx;
+	y2 = y1 + t1 * dy;
+	x1 += t0 * dx;
+	y1 += t0 * dy;
+	return true;
+}
+
+// The Voronoi edges of the sites, clipped to the rectangle.
+std::vector<Edge> fortuneVoronoi(const std::vector<Point> &siteList, const float &left, const float &top, const float &right, const float &bottom)
+{
+	BeachLine beach;
+	beach.sites = &siteList;
+	beach.root = -1;
+	beach.seed = 2463534242u;
+	std::vector<int> order(siteList.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (int)i;
+	std::sort(order.begin(), order.end(), [&](const int &i, const int &j)
+	{
+		return siteList[i].y < siteList[j].y || (siteList[i].y == siteList[j].y && siteList[i].x < siteList[j].x);
+	});
+
+	size_t next = 0;
+	while (next < order.size() || !beach.queue.empty())
+	{
+		if (!beach.queue.empty() && (next == order.size() || beach.queue.front().first <= siteList[order[next]].y))
+		{
+			std::pop_heap(beach.queue.begin(), beach.queue.end(), std::greater<std::pair<double, int>>());
+			const CircleEvent event = beach.events[beach.queue.back().second];
+			beach.queue.pop_back();
+			if (event.valid)
+				removeArcAt(beach, event);
+		}
+		else if (next > 0 && siteList[order[next]] == siteList[order[next - 1]]) // the same site twice
+			next++;
+		else
+			addSite(beach, order[next++]);
+	}
+
+	// The edges still growing run off to infinity; the rectangle cuts them off
+	std::vector<Edge> edgeList;
+	const double reach = 4.0 * (std::max(right - left, bottom - top) + fabs(left) + fabs(top) + fabs(right) + fabs(bottom));
+	for (const SweepEdge &e : beach.edges)
+	{
+		double x1 = e.x, y1 = e.y, x2 = e.ex, y2 = e.ey;
+		if (y1 < -1e29) // started far above (between sites of the first row): bring the start within reach, whether the edge ended or not
+			y1 = top - reach;
+		if (!e.ended)
+		{
+			const double length = sqrt(e.dx * e.dx + e.dy * e.dy);
+			if (length == 0)
+				continue;
+			x2 = x1 + e.dx / length * reach * 2;
+			y2 = y1 + e.dy / length * reach * 2;
+		}
+		if (clipSegment(x1, y1, x2, y2, left, top, right, bottom) && (x1 != x2 || y1 != y2))
+			edgeList.push_back(Edge(Point((float)x1, (float)y1), Point((float)x2, (float)y2)));
+	}
+	return edgeList;
+}
+
+void drawVoronoiEdges(const std::vector<Edge> &edgeList)
+{
+	setcolor(YELLOW);
+	for (const auto &edge : edgeList)
+		line(edge.src.x, edge.src.y, edge.dst.x, edge.dst.y);
+}
+
+// Draws the sites, triangles and Voronoi edges of the given triangles of the mesh (in increasing order) that reach into the rectangle (in window
+// coordinates, right and bottom included), clipped to it, in the viewport set on it. A site is drawn with the triangle it keeps, and a Voronoi edge with
+// the lower of its two triangles. The edges, whose ends may lie far outside the window, are first cut to a little more than the window: always the same
+// rectangle, so that an edge drawn in part is the same line of pixels as drawn whole.
+void drawMeshTriangles(const Mesh &mesh, const std::vector<int> &triangleList, const int &left, const int &top, const int &right, const int &bottom)
+{
+	setcolor(CYAN);
+	for (const int &k : triangleList)
+		for (const int &v : mesh.triangles[k].v)
+		{
+			const Point &p = mesh.points[v];
+			if (mesh.corners[v] == k && !isSuperCorner(mesh, v) && p.x + 6 >= left && p.x - 6 <= right && p.y + 6 >= top && p.y - 6 <= bottom)
+				circle((int)p.x - left, (int)p.y - top, 5);
+		}
+	for (const int &k : triangleList)
+	{
+		const MeshTriangle &t = mesh.triangles[k];
+		if (!isRealTriangle(mesh, t))
+			continue;
+		const Point &a = mesh.points[t.v[0]], &b = mesh.points[t.v[1]], &c = mesh.points[t.v[2]];
+		if (std::max({ a.x, b.x, c.x }) + 1 >= left && std::min({ a.x, b.x, c.x }) - 1 <= right &&
+			std::max({ a.y, b.y, c.y }) + 1 >= top && std::min({ a.y, b.y, c.y }) - 1 <= bottom)
 		{
+			setcolor(LIGHTRED);
+			line((int)a.x - left, (int)a.y - top, (int)b.x - left, (int)b.y - top);
+			line((int)b.x - left, (int)b.y - top, (int)c.x - left, (int)c.y - top);
+			line((int)c.x - left, (int)c.y - top, (int)a.x - left, (int)a.y - top);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			if (t.adj[i] <= k || !isRealTriangle(mesh, mesh.triangles[t.adj[i]])) // each pair once
+				continue;
+			double x1 = t.cx, y1 = t.cy, x2 = mesh.triangles[t.adj[i]].cx, y2 = mesh.triangles[t.adj[i]].cy;
+			if (clipSegment(x1, y1, x2, y2, -16, -16, getmaxx() + 16, getmaxy() + 16) && std::max(x1, x2) + 1 >= left && std::min(x1, x2) - 1 <= right &&
+				std::max(y1, y2) + 1 >= top && std::min(y1, y2) - 1 <= bottom)
+			{
+				setcolor(YELLOW);
+				line((int)x1 - left, (int)y1 - top, (int)x2 - left, (int)y2 - top);
+			}
+		}
+	}
+}
+
+// Clears the rectangle (in window coordinates, right and bottom included) and draws again everything of the mesh that reaches into it, looking at every
+// triangle. For drawing the whole mesh; redrawChange() finds what to draw around a change without.
+void drawMeshRegion(const Mesh &mesh, const int &left, const int &top, const int &right, const int &bottom)
+{
+	std::vector<int> triangleList;
+	for (size_t k = 0; k < mesh.triangles.size(); k++)
+		if (mesh.triangles[k].alive)
+			triangleList.push_back((int)k);
+	setviewport(left, top, right, bottom, 1);
+	clearviewport();
+	drawMeshTriangles(mesh, triangleList, left, top, right, bottom);
+	setviewport(0, 0, getmaxx(), getmaxy(), 1);
+}
+
+// Whether the circumcircle of t reaches into the rectangle; always for a triangle too thin to have one (see setCircumCentre()).
+inline bool isCircumCircleOver(const Mesh &mesh, const MeshTriangle &t, const double &left, const double &top, const double &right, const double &bottom)
+{
+	const Point &a = mesh.points[t.v[0]];
+	const double rx = a.x - t.cx, ry = a.y - t.cy, dx = t.cx - std::min(std::max(t.cx, left), right), dy = t.cy - std::min(std::max(t.cy, top), bottom);
+	return (rx == 0 && ry == 0) || dx * dx + dy * dy <= rx * rx + ry * ry;
+}
+
+// Gathers into mesh.cavity, in increasing order, the triangles (of the super triangle too) whose circumcircles reach into the rectangle, and their
+// neighbours, walking out across neighbours from the triangles the last change made. The walk misses none: a triangle whose circumcircle holds a point q
+// is in the cavity q would have (see insertSite()), which reaches the triangle q lies in, and the triangles the rectangle lies in are connected, as it
+// is convex. Everything drawn in the rectangle belongs to one of them: a site circle to the triangles around the site, a triangle to itself, and a
+// Voronoi edge, which lies between the circumcentres and the middle of the edge the two triangles share, to whichever of them reaches in.
+void findTrianglesNear(Mesh &mesh, const double &left, const double &top, const double &right, const double &bottom)
+{
+	const unsigned stamp = ++mesh.stamp;
+	mesh.stack.clear();
+	mesh.cavity.clear();
+	for (const int &t : mesh.change.created)
+		if (mesh.triangles[t].stamp != stamp)
+		{
+			mesh.triangles[t].stamp = stamp;
+			mesh.stack.push_back(t);
+			mesh.cavity.push_back(t);
+		}
+	while (!mesh.stack.empty())
+	{
+		const int t = mesh.stack.back();
+		mesh.stack.pop_back();
+		for (const int &n : mesh.triangles[t].adj)
+		{
+			if (n == NO_TRIANGLE || mesh.triangles[n].stamp == stamp)
+				continue;
+			mesh.triangles[n].stamp = stamp;
+			mesh.cavity.push_back(n);
+			if (isCircumCircleOver(mesh, mesh.triangles[n], left, top, right, bottom))
+				mesh.stack.push_back(n);
+		}
+	}
+	std::sort(mesh.cavity.begin(), mesh.cavity.end()); // the order the whole mesh is drawn in, for the same pixels where lines cross
+}
+
+// Redraws only the part of the window the last change to the mesh touched: the box around the sites of the triangles it took out and made, and around
+// the Voronoi edges it took away and made (see getChangedVoronoiEdges()), within the window. Only the triangles around it are looked at (see
+// findTrianglesNear()), so the cost grows with what lies around the change rather than with the size of the mesh.
+void redrawChange(Mesh &mesh, const std::vector<Edge> &removed, const std::vector<Edge> &added)
+{
+	double left = mesh.change.left - 6, top = mesh.change.top - 6, right = mesh.change.right + 6, bottom = mesh.change.bottom + 6; // with the circles
+	for (const std::vector<Edge> *edgeList : { &removed, &added })
+		for (const Edge &edge : *edgeList)
+		{
+			double x1 = edge.src.x, y1 = edge.src.y, x2 = edge.dst.x, y2 = edge.dst.y;
+			if (!clipSegment(x1, y1, x2, y2, 0, 0, getmaxx(), getmaxy()))
+				continue;
+			left = std::min({ left, x1 - 1, x2 - 1 });
+			top = std::min({ top, y1 - 1, y2 - 1 });
+			right = std::max({ right, x1 + 1, x2 + 1 });
+			bottom = std::max({ bottom, y1 + 1, y2 + 1 });
+		}
+	left = std::max(left, 0.0);
+	top = std::max(top, 0.0);
+	right = std::min(right, (double)getmaxx());
+	bottom = std::min(bottom, (double)getmaxy());
+	if (left > right || top > bottom)
+		return;
+	const int l = (int)left, t = (int)top, r = (int)right, b = (int)bottom;
+	findTrianglesNear(mesh, l - 8, t - 8, r + 8, b + 8); // what is drawn reaches 6 pixels out (a site circle), and a pixel more for rounding
+	setviewport(l, t, r, b, 1);
+	clearviewport();
+	drawMeshTriangles(mesh, mesh.cavity, l, t, r, b);
+	setviewport(0, 0, getmaxx(), getmaxy(), 1);
+}
+
+// Relaxes the sites for up to maxIterations iterations, or until they settle, in the padded window they were sampled in. If drawEach, every iteration is
+// drawn; otherwise nothing is. Returns the sites where they end up, in the same order.
+std::vector<Point> relaxVoronoi(const std::vector<Point> &siteList, const int &maxIterations, const bool &drawEach)
+{
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	Mesh mesh;
+	std::vector<Point> centroids;
+	buildMesh(mesh, siteList);
+	auto start = std::chrono::high_resolution_clock::now();
+	int iteration = 0;
+	float furthest = std::numeric_limits<float>::infinity();
+	while (iteration < maxIterations && furthest >= RELAX_TOLERANCE)
+	{
+		furthest = relaxSites(mesh, PADDING, PADDING, WIDTH - PADDING, HEIGHT - PADDING, nThreads, centroids);
+		iteration++;
+		if (drawEach)
+		{
+			cleardevice();
+			drawMeshRegion(mesh, 0, 0, getmaxx(), getmaxy());
+		}
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+	const double seconds = std::chrono::duration<double>(stop - start).count();
+	std::cout << iteration << " iterations in " << seconds * 1000 << " ms (" << iteration / seconds << " a second); the furthest a site moved in the last was "
+			  << furthest << " pixels." << std::endl;
+
+	std::vector<Point> relaxed = siteList;
+	for (size_t i = 0; i < relaxed.size(); i++)
+	{
+		relaxed[i].x = mesh.points[i].x;
+		relaxed[i].y = mesh.points[i].y;
+	}
+	return relaxed;
+}
+
+// Raster Voronoi by jump flooding: every pixel finds its nearest site by itself, filling the cells rather than tracing their edges. The pixels under the
+// sites are seeded with them, and then, for steps of half the image, a quarter, and so on down to one pixel, every pixel looks at the pixels a step away
+// in the eight directions and takes over the site of any of them that is nearer than its own. After log2(size) passes, and one more of a single pixel to
+// mend the few pixels the halving got wrong, each pixel holds its nearest site (nearly always). The work is the same whatever the number of sites, and so
+// is the time, as long as the loop of a pass is vectorized (with GCC that takes -O3); compiled as plain branches, it mispredicts more often the smaller
+// the cells are, and a 4K raster takes 2.2 s with a thousand sites but 4.3 s with a million, against about 1.5 s for either vectorized (one core).
+//
+// Each pixel keeps the position of its site next to the site's index, in separate arrays, so a pass reads the neighbours of a run of pixels from
+// contiguous memory and the compiler can vectorize it. The distance to the site is worked out again from the position whenever it is needed: a fourth
+// array to load and store costs more than the arithmetic, and is one stream too many for the vectorizer to check the arrays for overlap. The rows of a
+// pass are split among threads.
+struct FloodBuffer
+{
+	std::vector<int> ids; // the nearest site found so far, or -1
+	std::vector<float> siteX, siteY; // its position, or far away
+};
+
+// One pass over the rows [top, bottom): takes from src whatever pixel a step away has a nearer site, into dst.
+void floodRows(const FloodBuffer &src, FloodBuffer &dst, const int &width, const int &height, const int &step, const int &top, const int &bottom)
+{
+	for (int y = top; y < bottom; y++)
+	{
+		const size_t row = (size_t)y * width;
+		int *ids = &dst.ids[row];
+		float *siteX = &dst.siteX[row], *siteY = &dst.siteY[row];
+		std::copy(src.ids.begin() + row, src.ids.begin() + row + width, ids);
+		std::copy(src.siteX.begin() + row, src.siteX.begin() + row + width, siteX);
+		std::copy(src.siteY.begin() + row, src.siteY.begin() + row + width, siteY);
+		for (int dy = -step; dy <= step; dy += step)
+		{
+			if (y + dy < 0 || y + dy >= height)
+				continue;
+			for (int dx = -step; dx <= step; dx += step)
+			{
+				if (dx == 0 && dy == 0)
+					continue;
+				const float py = (float)y;
+				const int first = std::max(0, -dx), last = std::min(width, width - dx); // where x + dx is in the image
+				const size_t from = (size_t)(y + dy) * width + (first + dx); // the pixel x = first looks at; never before the start of the arrays
+				const int *fromIds = &src.ids[from];
+				const float *fromX = &src.siteX[from], *fromY = &src.siteY[from];
+				for (int x = first; x < last; x++) // every load and store unconditional, so that it vectorizes
+				{
+					const float px = (float)x, sx = fromX[x - first], sy = fromY[x - first], ox = siteX[x], oy = siteY[x];
+					const bool nearer = (px - sx) * (px - sx) + (py - sy) * (py - sy) < (px - ox) * (px - ox) + (py - oy) * (py - oy);
+					const int keep = (int)nearer - 1; // all ones to keep ids[x]: a select would let the compiler load fromIds[] only if nearer, in a branch
+					ids[x] = (fromIds[x - first] & ~keep) | (ids[x] & keep);
+					siteX[x] = nearer ? sx : ox;
+					siteY[x] = nearer ? sy : oy;
+				}
+			}
+		}
+	}
+}
+
+// Finds the nearest site of every pixel of a width x height raster, with the sites scaled by scale onto it. Returns the index of the site of each pixel
+// in ids, and the distance to it (in pixels) in distances, unless distances is NULL.
+void jumpFlood(const std::vector<Point> &siteList, const int &width, const int &height, const float &scale, std::vector<int> &ids, std::vector<float> *distances)
+{
+	const size_t nPixels = (size_t)width * height;
+	const int nThreads = std::max(1u, std::thread::hardware_concurrency());
+	FloodBuffer buffers[2];
+	for (FloodBuffer &buffer : buffers)
+	{
+		buffer.ids.assign(nPixels, -1);
+		buffer.siteX.assign(nPixels, 1e18f); // so far away that any site is nearer
+		buffer.siteY.assign(nPixels, 1e18f);
+	}
+	for (size_t i = 0; i < siteList.size(); i++)
+	{
+		const float sx = siteList[i].x * scale, sy = siteList[i].y * scale;
+		const int x = (int)sx, y = (int)sy;
+		if (x < 0 || y < 0 || x >= width || y >= height)
+			continue;
+		const size_t pixel = (size_t)y * width + x;
+		const float ox = buffers[0].siteX[pixel], oy = buffers[0].siteY[pixel];
+		if ((x - sx) * (x - sx) + (y - sy) * (y - sy) < (x - ox) * (x - ox) + (y - oy) * (y - oy)) // of two sites in one pixel, the nearer
+		{
+			buffers[0].ids[pixel] = (int)i;
+			buffers[0].siteX[pixel] = sx;
+			buffers[0].siteY[pixel] = sy;
+		}
+	}
+
+	std::vector<int> steps;
+	int size = 1;
+	while (size < std::max(width, height))
+		size *= 2;
+	for (int step = size / 2; step >= 1; step /= 2)
+		steps.push_back(step);
+	steps.push_back(1);
+
+	int current = 0;
+	for (const int &step : steps)
+	{
+		std::vector<std::thread> pool;
+		for (int t = 0; t < nThreads; t++)
+			pool.emplace_back([&, t]()
+			{
+				floodRows(buffers[current], buffers[1 - current], width, height, step, height * t / nThreads, height * (t + 1) / nThreads);
+			});
+		for (auto &thread : pool)
+			thread.join();
+		current = 1 - current;
+	}
+
+	const FloodBuffer &result = buffers[current];
+	if (distances != NULL)
+	{
+		distances->resize(nPixels);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				const size_t pixel = (size_t)y * width + x;
+				const float ex = x - result.siteX[pixel], ey = y - result.siteY[pixel];
+				(*distances)[pixel] = (result.ids[pixel] < 0) ? 0 : sqrt(ex * ex + ey * ey);
+			}
+	}
+	ids.swap(buffers[current].ids);
+}
+
+// Fills the window with the cells of the sites, each in a colour of its own, or with the distance to the nearest site, brighter farther away.
+void drawVoronoiCells(const std::vector<Point> &siteList, const bool &showDistance)
+{
+	std::vector<int> ids;
+	std::vector<float> distances;
+	auto start = std::chrono::high_resolution_clock::now();
+	jumpFlood(siteList, WIDTH, HEIGHT, 1, ids, showDistance ? &distances : NULL);
+	auto stop = std::chrono::high_resolution_clock::now();
+	std::cout << "Cells flooded in " << std::chrono::duration<double, std::milli>(stop - start).count() << " ms." << std::endl;
+
+	std::vector<unsigned int> colors(siteList.size());
+	for (size_t i = 0; i < siteList.size(); i++)
+	{
+		const uint32_t hash = (uint32_t)(i + 1) * 2654435761u;
+		colors[i] = bufferpixel(COLOR(64 + (hash >> 24) % 192, 64 + (hash >> 16) % 192, 64 + (hash >> 8) % 192));
+	}
+	float farthest = EPSILON;
+	for (const float &d : distances)
+		farthest = std::max(farthest, d);
+
+	int pitch = 0;
+	unsigned int *pixels = lockbuffer(&pitch);
+	for (int y = 0; y < HEIGHT; y++)
+		for (int x = 0; x < WIDTH; x++)
+		{
+			const size_t pixel = (size_t)y * WIDTH + x;
+			unsigned int color = bufferpixel(BLACK);
+			if (showDistance)
+			{
+				const int gray = (int)(255 * distances[pixel] / farthest);
+				color = bufferpixel(COLOR(gray, gray, gray));
+			}
+			else if (ids[pixel] >= 0)
+				color = colors[ids[pixel]];
+			pixels[(size_t)y * pitch + x] = color;
+		}
+	unlockbuffer(0, 0, WIDTH - 1, HEIGHT - 1);
+}
+
+// The same pairs of neighbouring triangles drawVoronoiPattern() draws, without the drawing, for timing.
+size_t countDualEdges(const std::vector<Triangle> &mesh)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < mesh.size(); ++i)
+	{
+		Circle circumCircle = getCircumCircle(mesh[i]);
+		for (size_t j = 0; j < mesh.size(); ++j)
+			if (mesh[i].isNeighborOf(mesh[j]))
+			{
+				Circle circumCircleNeighbor = getCircumCircle(mesh[j]);
+				count += (circumCircle.radius >= 0 && circumCircleNeighbor.radius >= 0);
+			}
+	}
+	return count;
+}
+
+// Times orient2d() and incircle() against the plain determinants they replace, in millions of tests a second, on random points and on points of a
+// small integer grid, where most of them are collinear or cocircular and the exact path decides.
+volatile int positiveTests; // each loop stores its count here before the clock is read again, so that it cannot be moved past the clock
+void benchmarkPredicates()
+{
+	const int n = 1000000;
+	std::default_random_engine engine(12345);
+	std::uniform_real_distribution<float> rndX(0, WIDTH), rndY(0, HEIGHT);
+	std::uniform_int_distribution<int> rndGrid(0, 3);
+	std::vector<Point> random, grid;
+	for (int i = 0; i < n + 3; i++)
+	{
+		random.push_back(Point(rndX(engine), rndY(engine)));
+		grid.push_back(Point((float)rndGrid(engine), (float)rndGrid(engine)));
+	}
+	auto plainOrient = [](const Point &a, const Point &b, const Point &c)
+	{
+		return ((double)b.x - a.x) * ((double)c.y - a.y) - ((double)b.y - a.y) * ((double)c.x - a.x);
+	};
+	auto plainIncircle = [](const Point &a, const Point &b, const Point &c, const Point &d)
+	{
+		const double adx = (double)a.x - d.x, ady = (double)a.y - d.y, bdx = (double)b.x - d.x, bdy = (double)b.y - d.y, cdx = (double)c.x - d.x, cdy = (double)c.y - d.y;
+		return (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) + (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) + (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+	};
+	printf("\n%10s %14s %14s %14s %14s\n", "points", "plain orient", "orient2d", "plain incircle", "incircle");
+	for (const std::vector<Point> *points : { &random, &grid })
+	{
+		const std::vector<Point> &p = *points;
+		int count = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < n; i++)
+			count += plainOrient(p[i], p[i + 1], p[i + 2]) > 0;
+		positiveTests = count;
+		auto plainOriented = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < n; i++)
+			count += orient2d(p[i], p[i + 1], p[i + 2]) > 0;
+		positiveTests = count;
+		auto oriented = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < n; i++)
+			count += plainIncircle(p[i], p[i + 1], p[i + 2], p[i + 3]) > 0;
+		positiveTests = count;
+		auto plainTested = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < n; i++)
+			count += incircle(p[i], p[i + 1], p[i + 2], p[i + 3]) > 0;
+		positiveTests = count;
+		auto tested = std::chrono::high_resolution_clock::now();
+		auto rate = [&](const std::chrono::high_resolution_clock::time_point &from, const std::chrono::high_resolution_clock::time_point &to)
+		{
+			return n / std::chrono::duration<double, std::micro>(to - from).count();
+		};
+		printf("%10s %14.1f %14.1f %14.1f %14.1f\n", points == &random ? "random" : "grid", rate(start, plainOriented), rate(plainOriented, oriented),
+			rate(oriented, plainTested), rate(plainTested, tested));
+	}
+}
+
+// Checks fortuneVoronoi() on square grids of 2 x 2 to 6 x 6 sites 80 pixels apart, whose Voronoi edges are the lines halfway between the rows and
+// columns, right across the window: the edges traced must add up to that length. Every row holds several sites at the same y, so the edges between the
+// sites of the first row start from far above the window and end at a Voronoi vertex, which is what lost their upper halves once.
+bool checkFortuneGrid()
+{
+	bool ok = true;
+	for (int k = 2; k <= 6; k++)
+	{
+		std::vector<Point> sites;
+		for (int i = 0; i < k; i++)
+			for (int j = 0; j < k; j++)
+				sites.push_back(Point((float)(100 + 80 * j), (float)(40 + 80 * i)));
+		double length = 0;
+		for (const auto &edge : fortuneVoronoi(sites, 0, 0, WIDTH, HEIGHT))
+			length += getEuclideanDist(edge.src, edge.dst);
+		const double expected = (k - 1) * (double)(WIDTH + HEIGHT);
+		if (fabs(length - expected) > 1)
+		{
+			printf("Fortune on a %d x %d grid: the edges add up to %.1f pixels, not %.1f.\n", k, k, length, expected);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Times Fortune's algorithm against the triangulation (both ways) and its dual on random sites, from a thousand to a million. The dual, which compares every
+// pair of triangles, is left out beyond 20000 sites, where it takes minutes. Then times the geometric predicates, and jump flooding a 4K raster with as
+// many sites.
+void benchmarkVoronoi()
+{
+	printf("Fortune on square grids of sites: %s\n\n", checkFortuneGrid() ? "correct" : "WRONG");
+
+	std::default_random_engine engine(12345);
+	std::uniform_real_distribution<float> rndX(0, WIDTH), rndY(0, HEIGHT);
+	printf("%10s %14s %14s %14s %14s\n", "sites", "Fortune (ms)", "triangulate", "Bowyer-Watson", "+ dual");
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+	{
+		std::vector<Point> sites;
+		for (size_t i = 0; i < n; i++)
+			sites.push_back(Point(rndX(engine), rndY(engine)));
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<Edge> edgeList = fortuneVoronoi(sites, 0, 0, WIDTH, HEIGHT);
+		auto swept = std::chrono::high_resolution_clock::now();
+		std::vector<Triangle> mesh = triangulate(sites);
+		auto triangulated = std::chrono::high_resolution_clock::now();
+		triangulateIncrementally(sites);
+		auto inserted = std::chrono::high_resolution_clock::now();
+		printf("%10zu %14.1f %14.1f %14.1f", n, std::chrono::duration<double, std::milli>(swept - start).count(),
+			std::chrono::duration<double, std::milli>(triangulated - swept).count(), std::chrono::duration<double, std::milli>(inserted - triangulated).count());
+		if (n <= 20000)
+		{
+			auto dualStart = std::chrono::high_resolution_clock::now();
+			countDualEdges(mesh);
+			auto dual = std::chrono::high_resolution_clock::now();
+			printf(" %14.1f\n", std::chrono::duration<double, std::milli>(dual - dualStart).count());
+		}
+		else
+			printf(" %14s\n", "-");
+	}
+
+	benchmarkPredicates();
+
+	printf("\n%10s %14s\n", "sites", "jump flooding at 3840 x 2160 (ms)");
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+	{
+		std::vector<Point> sites;
+		for (size_t i = 0; i < n; i++)
+			sites.push_back(Point(rndX(engine), rndY(engine)));
+		std::vector<int> ids;
+		auto start = std::chrono::high_resolution_clock::now();
+		jumpFlood(sites, 3840, 2160, std::min(3840.0f / WIDTH, 2160.0f / HEIGHT), ids, NULL);
+		auto stop = std::chrono::high_resolution_clock::now();
+		printf("%10zu %14.1f\n", n, std::chrono::duration<double, std::milli>(stop - start).count());
+	}
+}
+
+// Times inserting, removing and moving single sites of a mesh of a thousand to a million random sites, against building the mesh again. Sites are
+// inserted anywhere, and moved by up to 5 pixels, as a drag with the mouse would; each move is then drawn as editSites() does (see redrawChange()),
+// against drawing the whole mesh.
+void benchmarkDynamicMesh()
+{
+	const int nOps = 10000;
+	std::default_random_engine engine(12345);
+	std::uniform_real_distribution<float> rndX(0, WIDTH), rndY(0, HEIGHT), rndStep(-5, 5);
+	std::vector<Edge> removedEdges, addedEdges;
+	printf("%10s %14s %14s %14s %14s %14s %14s\n", "sites", "insert (us)", "remove (us)", "move (us)", "redraw (us)", "rebuild (ms)", "draw all (ms)");
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+	{
+		std::vector<Point> sites;
+		for (size_t i = 0; i < n; i++)
+			sites.push_back(Point(rndX(engine), rndY(engine)));
+		Mesh mesh;
+		auto start = std::chrono::high_resolution_clock::now();
+		buildMesh(mesh, sites);
+		auto built = std::chrono::high_resolution_clock::now();
+
+		std::vector<int> added;
+		std::vector<Point> targets;
+		for (int i = 0; i < nOps; i++)
+			targets.push_back(Point(rndX(engine), rndY(engine)));
+		auto insertStart = std::chrono::high_resolution_clock::now();
+		for (const Point &p : targets)
+			added.push_back(addSite(mesh, p));
+		auto inserted = std::chrono::high_resolution_clock::now();
+		for (const int &site : added)
+			if (site >= 0)
+				removeSite(mesh, site);
+		auto removed = std::chrono::high_resolution_clock::now();
+
+		std::vector<int> moved;
+		targets.clear();
+		for (int i = 0; i < nOps; i++)
+		{
+			const int site = (int)(engine() % n);
+			moved.push_back(site);
+			targets.push_back(Point(std::min(std::max(sites[site].x + rndStep(engine), 0.0f), (float)WIDTH), std::min(std::max(sites[site].y + rndStep(engine), 0.0f), (float)HEIGHT)));
+			sites[site] = targets.back();
+		}
+		auto drawStart = std::chrono::high_resolution_clock::now();
+		cleardevice();
+		drawMeshRegion(mesh, 0, 0, getmaxx(), getmaxy());
+		auto drawn = std::chrono::high_resolution_clock::now();
+		double moving = 0, redrawing = 0;
+		for (int i = 0; i < nOps; i++)
+		{
+			auto moveStart = std::chrono::high_resolution_clock::now();
+			const bool changed = moveSite(mesh, moved[i], targets[i]);
+			auto moveStop = std::chrono::high_resolution_clock::now();
+			if (changed)
+			{
+				getChangedVoronoiEdges(mesh, removedEdges, addedEdges);
+				redrawChange(mesh, removedEdges, addedEdges);
+			}
+			auto redrawn = std::chrono::high_resolution_clock::now();
+			moving += std::chrono::duration<double, std::micro>(moveStop - moveStart).count();
+			redrawing += std::chrono::duration<double, std::micro>(redrawn - moveStop).count();
+		}
+		printf("%10zu %14.2f %14.2f %14.2f %14.2f %14.1f %14.1f\n", n, std::chrono::duration<double, std::micro>(inserted - insertStart).count() / nOps,
+			std::chrono::duration<double, std::micro>(removed - inserted).count() / nOps, moving / nOps, redrawing / nOps,
+			std::chrono::duration<double, std::milli>(built - start).count(), std::chrono::duration<double, std::milli>(drawn - drawStart).count());
+	}
+	cleardevice();
+}
+
+// Lets the sites of the mesh be edited with the mouse until a key is pressed: a left click adds a site, or, on a site, drags it along; a right click
+// removes the site nearest to it. Only the part of the window each change touches is drawn again.
+void editSites(Mesh &mesh)
+{
+	std::vector<Edge> removed, added;
+	int dragged = -1, x = 0, y = 0;
+	clearmouseclick(WM_LBUTTONDOWN);
+	clearmouseclick(WM_LBUTTONUP);
+	clearmouseclick(WM_RBUTTONDOWN);
+	while (!kbhit())
+	{
+		bool changed = false;
+		const char *what = "";
+		auto start = std::chrono::high_resolution_clock::now();
+		if (ismouseclick(WM_LBUTTONDOWN))
+		{
+			getmouseclick(WM_LBUTTONDOWN, x, y);
+			const Point p((float)x, (float)y);
+			const int site = findNearestSite(mesh, p);
+			if (site >= 0 && getEuclideanDist(mesh.points[site], p) <= 5)
+				dragged = site;
+			else
+			{
+				start = std::chrono::high_resolution_clock::now();
+				changed = addSite(mesh, p) >= 0;
+				what = "Inserted";
+			}
+		}
+		else if (ismouseclick(WM_RBUTTONDOWN))
+		{
+			getmouseclick(WM_RBUTTONDOWN, x, y);
+			const int site = findNearestSite(mesh, Point((float)x, (float)y));
+			start = std::chrono::high_resolution_clock::now();
+			changed = site >= 0 && removeSite(mesh, site);
+			what = "Removed";
+		}
+		else if (dragged >= 0)
+		{
+			if (ismouseclick(WM_LBUTTONUP))
+			{
+				getmouseclick(WM_LBUTTONUP, x, y);
+				dragged = -1;
+			}
+			else
+			{
+				x = mousex();
+				y = mousey();
+			}
+			const Point &p = mesh.points[dragged >= 0 ? dragged : 0];
+			if (dragged >= 0 && ((int)p.x != x || (int)p.y != y))
+				changed = moveSite(mesh, dragged, Point((float)x, (float)y));
+		}
+		auto stop = std::chrono::high_resolution_clock::now();
+		if (!changed)
+		{
+			delay(10);
+			continue;
+		}
+		getChangedVoronoiEdges(mesh, removed, added);
+		redrawChange(mesh, removed, added);
+		auto redrawn = std::chrono::high_resolution_clock::now();
+		if (*what)
+			std::cout << what << " a site in " << std::chrono::duration<double, std::micro>(stop - start).count() << " us: " << mesh.change.removed.size()
+					  << " triangles taken out, " << mesh.change.created.size() << " made; drawn again in "
+					  << std::chrono::duration<double, std::micro>(redrawn - stop).count() << " us." << std::endl;
+	}
+	getch();
+}
+
+// Times Lloyd's relaxation of 100000 random sites, in iterations a second: warm, moving the sites in the mesh of the last iteration, against building the
+// mesh again every time. The first iterations move the sites far, so more of them leave the triangles around them and are moved by removing and
+// inserting them; later, most only need a few flips.
+void benchmarkRelaxation()
+{
+	const int n = 100000, nThreads = std::max(1u, std::thread::hardware_concurrency());
+	const int blocks[] = { 1, 5, 20, 50 }; // the iterations after which to report
+	std::default_random_engine engine(12345);
+	std::uniform_real_distribution<float> rndX(PADDING, WIDTH - PADDING), rndY(PADDING, HEIGHT - PADDING);
+	std::vector<Point> sites;
+	for (int i = 0; i < n; i++)
+		sites.push_back(Point(rndX(engine), rndY(engine)));
+
+	double warm[4], rebuilt[4];
+	float furthest[4];
+	Mesh mesh;
+	std::vector<Point> centroids, positions = sites;
+	buildMesh(mesh, sites);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 1, block = 0; block < 4; iteration++)
+	{
+		furthest[block] = relaxSites(mesh, PADDING, PADDING, WIDTH - PADDING, HEIGHT - PADDING, nThreads, centroids);
+		if (iteration == blocks[block])
+		{
+			auto stop = std::chrono::high_resolution_clock::now();
+			warm[block++] = std::chrono::duration<double>(stop - start).count();
+			start = stop;
+		}
+	}
+	start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 1, block = 0; block < 4; iteration++)
+	{
+		buildMesh(mesh, positions);
+		getCellCentroids(mesh, PADDING, PADDING, WIDTH - PADDING, HEIGHT - PADDING, nThreads, centroids);
+		for (int i = 0; i < n; i++)
+			positions[i] = centroids[i];
+		if (iteration == blocks[block])
+		{
+			auto stop = std::chrono::high_resolution_clock::now();
+			rebuilt[block++] = std::chrono::duration<double>(stop - start).count();
+			start = stop;
+		}
+	}
+
+	printf("%10s %14s %14s %14s\n", "iterations", "warm (it/s)", "rebuilt (it/s)", "furthest move");
+	for (int block = 0; block < 4; block++)
+	{
+		const int count = blocks[block] - (block ? blocks[block - 1] : 0);
+		printf("%4d to %2d %14.2f %14.2f %14.3f\n", block ? blocks[block - 1] + 1 : 1, blocks[block], count / warm[block], count / rebuilt[block], furthest[block]);
+	}
+}
+
+// has basic input validation for negative values
+// does not consider other invalid input like characters
+int main()
+{
+	initwindow(WIDTH, HEIGHT, "Voronoi");
+	float minSiteDist = 0, radius = 0;
+	size_t maxPoints = 0, ch = 0;
+	int input = 0;
+	uint64_t seed = 0;
+
+	std::cout << "Do you want to time the Voronoi algorithms first? (1 = Yes / 0 = No)" << std::endl;
+	std::cin >> ch;
+	if (ch)
+		benchmarkVoronoi();
+	std::cout << "Do you want to time the triangulation of ten million sites on 1 to 32 threads? (1 = Yes / 0 = No)" << std::endl;
+	std::cin >> ch;
+	if (ch)
+		benchmarkTriangulation();
+	std::cout << "Do you want to time inserting, removing and moving single sites? (1 = Yes / 0 = No)" << std::endl;
+	std::cin >> ch;
+	if (ch)
+		benchmarkDynamicMesh();
+	std::cout << "Do you want to time Lloyd's relaxation of a hundred thousand sites? (1 = Yes / 0 = No)" << std::endl;
+	std::cin >> ch;
+	if (ch)
+		benchmarkRelaxation();
+
+	while (true)
+	{
+
+#ifndef NDEBUG
+		std::cout << "Running in DEBUG mode..." << std::endl;		
+		std::cout << "Circumcircles will be visible in renders." << std::endl;
+		std::cout << "Compile in RELEASE mode to remove them.\n" << std::endl;
+#endif
+		std::cout << "This program creates a Voronoi partition pattern." << std::endl;
+		std::cout << "How many sites (points) would you like to have on your partition?" << std::endl;
+		std::cin >> input;
+
+		if (input < 0)
+		{
+			std::cout << "Invalid input. Try again." << std::endl;
+			continue;
+		}
+
+		maxPoints = input;
+
+		std::cout << "Please enter the minimum site distance between points(radius)." << std::endl;
+		std::cin >> radius;
+
+		if (radius < 0)
+		{
+			std::cout << "Invalid input. Try again." << std::endl;
+			continue;
+		}
+
+		minSiteDist = radius;
+
+		std::cout << "Please enter a seed for the random sites (the same seed gives the same sites)." << std::endl;
+		std::cin >> seed;
+
+		std::cout << "Generating random points using Poisson disk sampling." << std::endl;
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<Point> sites = generateSites(maxPoints, minSiteDist, seed);
+		auto stop = std::chrono::high_resolution_clock::now();
+		std::cout << sites.size() << " sites generated in " << std::chrono::duration<double, std::milli>(stop - start).count() << " ms." << std::endl;
+		if (sites.size() < maxPoints)
+			std::cout << "No more sites fit in the window that far apart." << std::endl;
+
+		std::cout << "Do you want to relax the sites towards the centroids of their cells (Lloyd's algorithm)? (1 = Yes / 0 = No)" << std::endl;
+		std::cin >> ch;
+		if (ch)
+		{
+			std::cout << "How many iterations at most?" << std::endl;
+			std::cin >> input;
+			std::cout << "Draw every iteration, rather than only the final state? (1 = Yes / 0 = No)" << std::endl;
+			std::cin >> ch;
+			sites = relaxVoronoi(sites, std::max(input, 0), ch != 0);
+			cleardevice();
+			for (const auto &site : sites)
+				site.draw(CYAN);
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<Triangle> mesh = triangulate(sites);
+		stop = std::chrono::high_resolution_clock::now();
+		std::cout << mesh.size() << " triangles generated after triangulation in "
+				  << std::chrono::duration<double, std::milli>(stop - start).count() << " ms." << std::endl;
+
+		std::cout << "Do you want to fill the Voronoi cells pixel by pixel (jump flooding)? (1 = Yes / 0 = No)" << std::endl;
+		std::cin >> ch;
+		if (ch)
+		{
+			std::cout << "Show the distance to the nearest site instead of the cells? (1 = Yes / 0 = No)" << std::endl;
+			std::cin >> ch;
+			drawVoronoiCells(sites, ch != 0);
+		}
+
+		std::cout << "Do you want to draw the generated mesh? (1 = Yes / 0 = No)" << std::endl;
+		std::cin >> ch;
+		if (ch)
+		{
+			std::cout << "Drawing generated mesh." << std::endl;
+			drawMesh(mesh);
+		}
+
+		std::cout << "Do you want to draw the generated Voronoi partition? (1 = Yes / 0 = No)" << std::endl;
+		std::cin >> ch;
+		if (ch)
+		{
+			std::cout << "Trace it with Fortune's sweep line instead of the triangulation? (1 = Yes / 0 = No)" << std::endl;
+			std::cin >> ch;
 			std::cout << "Drawing the generated Voronoi partition." << std::endl;
-			drawVoronoiPattern(mesh);
+			if (ch)
+			{
+				start = std::chrono::high_resolution_clock::now();
+				std::vector<Edge> edgeList = fortuneVoronoi(sites, 0, 0, WIDTH, HEIGHT);
+				stop = std::chrono::high_resolution_clock::now();
+				std::cout << edgeList.size() << " edges traced in " << std::chrono::duration<double, std::milli>(stop - start).count() << " ms." << std::endl;
+				drawVoronoiEdges(edgeList);
+			}
+			else
+				drawVoronoiPattern(mesh);
+		}
+
+		std::cout << "Do you want to edit the sites with the mouse? (1 = Yes / 0 = No)" << std::endl;
+		std::cin >> ch;
+		if (ch)
+		{
+			std::cout << "Left click adds a site, or drags one; right click removes the nearest site. Press any key in the window to stop." << std::endl;
+			Mesh editable;
+			buildMesh(editable, sites);
+			drawMeshRegion(editable, 0, 0, getmaxx(), getmaxy());
+			editSites(editable);
 		}
 
 		std::cout << "Continue? (1 = Yes / 0 = No)" << std::endl;
@@ -1,6 +1,5 @@
 #include <iostream>
 #include <cmath>
-#include "windows.h"
 #include "graphics.h"
 
 typedef struct point
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <windows.h>
 #include "graphics.h"
 
 int main()
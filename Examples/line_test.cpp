@@ -1,5 +1,4 @@
 #include <iostream>
-#include <windows.h>
 #include "graphics.h"
 #include "primitives.h"
 
@@ -1,6 +1,5 @@
 #include <iostream>
 #include "graphics.h"
-#include "windows.h"
 #include "primitives.h"
 
 void midpointCircle(const Circle &);
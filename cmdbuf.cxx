@@ -0,0 +1,417 @@
+// File: cmdbuf.cxx
+//
+// Command buffers: drawing calls recorded by many threads at once and drawn
+// later, all together, by flushrecordedbgi.  Each thread appends to a buffer
+// of its own, with a drawing state (color, fill and line style) of its own,
+// so recording takes no lock and threads never wait for each other.  Only
+// the flush takes the window lock, once, and replays the buffers through the
+// ordinary drawing functions, so it works the same with either backend.
+//
+// The buffers are kept until the next flush that does not keep them, which
+// means a recorded frame can be drawn again (for example to time the drawing
+// apart from the work of producing it).
+//
+
+#include "winbgi.h"             // API routines (and BGI_HEADLESS)
+#include <limits.h>             // Provides INT_MAX and INT_MIN
+#include <algorithm>            // Provides std::stable_sort
+#include <memory>               // Provides std::unique_ptr
+#include <mutex>                // Provides std::mutex
+#include <vector>               // Provides STL vector class
+#ifdef BGI_HEADLESS
+#include "headless.h"           // Internal structure data
+#else
+#include <windows.h>            // Provides the Win32 API
+#include "winbgitypes.h"        // Internal structure data
+#endif
+
+
+/*****************************************************************************
+*
+*   Structures
+*
+*****************************************************************************/
+
+enum { CMD_PUTPIXEL, CMD_LINE, CMD_BAR, CMD_CIRCLE, CMD_FILLPOLY };
+
+// The state a command is drawn with.
+struct DrawState
+{
+    int color;
+    int fillpattern, fillcolor;
+    int linestyle;
+    unsigned upattern;
+    int thickness;
+};
+
+
+// One recorded call.  For fillpoly, a is where its points start in the
+// buffer's points and b is how many there are.
+struct Command
+{
+    int op;                     // One of the CMD_ values
+    int key;                    // Replay order (setrecordorder)
+    int state;                  // Index of its state in the buffer's states
+    int a, b, c, d;             // Arguments of the call
+};
+
+
+// Everything one thread has recorded.
+struct CommandBuffer
+{
+    std::vector<Command> commands;
+    std::vector<int> points;    // The points of the fillpoly commands
+    std::vector<DrawState> states; // The last one is the current state
+    int key;                    // Key given to new commands
+    bool orphaned;              // The thread has exited (guarded by registry_mutex)
+};
+
+
+// Marks the calling thread's buffer as orphaned when the thread exits, so
+// the next flush can draw what it left behind and then free it.
+struct ThreadBuffer
+{
+    CommandBuffer* buffer;
+    ~ThreadBuffer( );
+};
+
+
+/*****************************************************************************
+*
+*   Global variables
+*
+*****************************************************************************/
+
+// Every buffer in the order its thread first recorded something
+static std::mutex registry_mutex;
+static std::vector< std::unique_ptr<CommandBuffer> > registry;
+
+static thread_local ThreadBuffer thread_buffer = { NULL };
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+ThreadBuffer::~ThreadBuffer( )
+{
+    if ( buffer != NULL )
+    {
+        std::lock_guard<std::mutex> guard( registry_mutex );
+        buffer->orphaned = true;
+    }
+}
+
+
+// Returns the state the current window draws with now.
+//
+static DrawState WindowState( )
+{
+    DrawState s;
+    fillsettingstype fill;
+    linesettingstype lines;
+
+    getfillsettings( &fill );
+    getlinesettings( &lines );
+    s.color = getcolor( );
+    s.fillpattern = fill.pattern;
+    s.fillcolor = fill.color;
+    s.linestyle = lines.linestyle;
+    s.upattern = lines.upattern;
+    s.thickness = lines.thickness;
+    return s;
+}
+
+
+// Returns the calling thread's buffer, registering a new one the first time.
+// A new buffer starts with the state of the window.
+//
+static CommandBuffer* CurrentBuffer( )
+{
+    CommandBuffer* b = thread_buffer.buffer;
+
+    if ( b == NULL )
+    {
+        b = new CommandBuffer;
+        b->key = 0;
+        b->orphaned = false;
+        b->states.push_back( WindowState( ) );
+
+        std::lock_guard<std::mutex> guard( registry_mutex );
+        registry.push_back( std::unique_ptr<CommandBuffer>( b ) );
+        thread_buffer.buffer = b;
+    }
+    return b;
+}
+
+
+// Makes s the current state of the calling thread.  A state no command has
+// used yet is simply replaced, so a run of setters costs one entry.
+//
+static void SetState( const DrawState& s )
+{
+    CommandBuffer* b = CurrentBuffer( );
+    int last = (int)b->states.size( ) - 1;
+
+    if ( !b->commands.empty( ) && b->commands.back( ).state == last )
+        b->states.push_back( s );
+    else
+        b->states[last] = s;
+}
+
+
+static void Record( int op, int a, int b, int c, int d )
+{
+    CommandBuffer* buf = CurrentBuffer( );
+    Command cmd = { op, buf->key, (int)buf->states.size( ) - 1, a, b, c, d };
+
+    buf->commands.push_back( cmd );
+}
+
+
+// Makes the window draw with state s, given that it draws with applied now.
+//
+static void ApplyState( const DrawState& s, const DrawState& applied )
+{
+    if ( s.color != applied.color )
+        setcolor( s.color );
+    if ( s.fillpattern != applied.fillpattern || s.fillcolor != applied.fillcolor )
+        setfillstyle( s.fillpattern, s.fillcolor );
+    if ( s.linestyle != applied.linestyle || s.upattern != applied.upattern ||
+         s.thickness != applied.thickness )
+        setlinestyle( s.linestyle, s.upattern, s.thickness );
+}
+
+
+// Grows the rectangle r (inclusive, viewport coordinates) to hold the
+// square of half-width pad around (x, y).
+//
+static void Include( viewporttype& r, int x, int y, int pad )
+{
+    if ( x - pad < r.left ) r.left = x - pad;
+    if ( y - pad < r.top ) r.top = y - pad;
+    if ( x + pad > r.right ) r.right = x + pad;
+    if ( y + pad > r.bottom ) r.bottom = y + pad;
+}
+
+
+// Draws one command and grows changed to hold what it touched.
+//
+static void Replay( CommandBuffer* b, const Command& cmd, viewporttype& changed )
+{
+    int pad = b->states[cmd.state].thickness;
+
+    switch ( cmd.op )
+    {
+    case CMD_PUTPIXEL:
+        putpixel( cmd.a, cmd.b, cmd.c );
+        Include( changed, cmd.a, cmd.b, 0 );
+        break;
+    case CMD_LINE:
+        line( cmd.a, cmd.b, cmd.c, cmd.d );
+        Include( changed, cmd.a, cmd.b, pad );
+        Include( changed, cmd.c, cmd.d, pad );
+        break;
+    case CMD_BAR:
+        bar( cmd.a, cmd.b, cmd.c, cmd.d );
+        Include( changed, cmd.a, cmd.b, 0 );
+        Include( changed, cmd.c, cmd.d, 0 );
+        break;
+    case CMD_CIRCLE:
+        circle( cmd.a, cmd.b, cmd.c );
+        Include( changed, cmd.a, cmd.b, cmd.c + pad );
+        break;
+    case CMD_FILLPOLY:
+    {
+        int* p = &b->points[cmd.a];
+        fillpoly( cmd.b, p );
+        for ( int i = 0; i < cmd.b; i++ )
+            Include( changed, p[2*i], p[2*i + 1], pad );
+        break;
+    }
+    }
+}
+
+
+/*****************************************************************************
+*
+*   Recording
+*
+*****************************************************************************/
+
+void setrecordorder( int key )
+{
+    CurrentBuffer( )->key = key;
+}
+
+
+void recordsetcolor( int color )
+{
+    DrawState s = CurrentBuffer( )->states.back( );
+
+    s.color = color;
+    SetState( s );
+}
+
+
+void recordsetfillstyle( int pattern, int color )
+{
+    DrawState s = CurrentBuffer( )->states.back( );
+
+    s.fillpattern = pattern;
+    s.fillcolor = color;
+    SetState( s );
+}
+
+
+void recordsetlinestyle( int linestyle, unsigned upattern, int thickness )
+{
+    DrawState s = CurrentBuffer( )->states.back( );
+
+    s.linestyle = linestyle;
+    s.upattern = upattern;
+    s.thickness = thickness;
+    SetState( s );
+}
+
+
+void recordputpixel( int x, int y, int color )
+{
+    Record( CMD_PUTPIXEL, x, y, color, 0 );
+}
+
+
+void recordline( int x1, int y1, int x2, int y2 )
+{
+    Record( CMD_LINE, x1, y1, x2, y2 );
+}
+
+
+void recordbar( int left, int top, int right, int bottom )
+{
+    Record( CMD_BAR, left, top, right, bottom );
+}
+
+
+void recordcircle( int x, int y, int radius )
+{
+    Record( CMD_CIRCLE, x, y, radius, 0 );
+}
+
+
+void recordfillpoly( int n_points, const int* points )
+{
+    if ( n_points <= 0 )
+        return;
+
+    CommandBuffer* b = CurrentBuffer( );
+    int start = (int)b->points.size( );
+
+    b->points.insert( b->points.end( ), points, points + 2*n_points );
+    Record( CMD_FILLPOLY, start, n_points, 0, 0 );
+}
+
+
+/*****************************************************************************
+*
+*   Replaying
+*
+*****************************************************************************/
+
+// The commands are cut into runs of equal key.  The runs of each buffer are
+// listed in order, buffer after buffer, and a stable sort by key then gives
+// the replay order: by key, then by buffer, then as recorded.  The window is
+// locked and its automatic refresh turned off for the whole replay, and the
+// rectangle that holds everything drawn is refreshed once at the end.
+//
+int flushrecordedbgi( bool keep )
+{
+    struct Run
+    {
+        int key;
+        CommandBuffer* buffer;
+        size_t begin, end;
+    };
+    std::vector<Run> runs;
+    std::lock_guard<std::mutex> guard( registry_mutex );
+    int count = 0;
+
+    for ( size_t i = 0; i < registry.size( ); i++ )
+    {
+        CommandBuffer* b = registry[i].get( );
+        size_t n = b->commands.size( );
+
+        for ( size_t begin = 0, end; begin < n; begin = end )
+        {
+            int key = b->commands[begin].key;
+            for ( end = begin + 1; end < n && b->commands[end].key == key; end++ )
+                ;
+            Run run = { key, b, begin, end };
+            runs.push_back( run );
+        }
+        count += (int)n;
+    }
+    std::stable_sort( runs.begin( ), runs.end( ),
+                      []( const Run& x, const Run& y ) { return x.key < y.key; } );
+
+    if ( count > 0 )
+    {
+        WindowData* pWndData = BGI__GetWindowDataPtr( );
+        DrawState saved, applied;
+        char upattern[8];
+        bool refreshing;
+        viewporttype changed = { INT_MAX, INT_MAX, INT_MIN, INT_MIN, 0 };
+
+        BGI__LockWindow( pWndData );
+        saved = applied = WindowState( );
+        if ( saved.fillpattern == USER_FILL )
+            getfillpattern( upattern );
+        refreshing = getrefreshingbgi( );
+        setrefreshingbgi( false );
+
+        for ( size_t r = 0; r < runs.size( ); r++ )
+        {
+            CommandBuffer* b = runs[r].buffer;
+            for ( size_t i = runs[r].begin; i < runs[r].end; i++ )
+            {
+                const DrawState& s = b->states[b->commands[i].state];
+                ApplyState( s, applied );
+                applied = s;
+                Replay( b, b->commands[i], changed );
+            }
+        }
+
+        if ( saved.fillpattern == USER_FILL )
+        {
+            setfillpattern( upattern, saved.fillcolor );
+            applied.fillpattern = USER_FILL;
+            applied.fillcolor = saved.fillcolor;
+        }
+        ApplyState( saved, applied );
+        setrefreshingbgi( refreshing );
+        BGI__UnlockWindow( pWndData );
+
+        // refreshbgi leaves out the right and bottom edges
+        if ( refreshing )
+            refreshbgi( changed.left, changed.top, changed.right + 1, changed.bottom + 1 );
+    }
+
+    if ( !keep )
+    {
+        size_t kept = 0;
+        for ( size_t i = 0; i < registry.size( ); i++ )
+        {
+            CommandBuffer* b = registry[i].get( );
+            if ( b->orphaned )
+                continue;
+            b->commands.clear( );
+            b->points.clear( );
+            b->states.erase( b->states.begin( ), b->states.end( ) - 1 );
+            registry[kept++].swap( registry[i] );
+        }
+        registry.resize( kept );
+    }
+    return count;
+}
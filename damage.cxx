@@ -0,0 +1,140 @@
+// File: damage.cxx
+//
+// The damage tracker.  See damage.h for how the backends use it.
+//
+
+#include "damage.h"         // Our own declarations
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+static inline long long Area( const BGI__Rect& r )
+{
+    return (long long)( r.right - r.left ) * ( r.bottom - r.top );
+}
+
+
+static inline BGI__Rect Union( const BGI__Rect& a, const BGI__Rect& b )
+{
+    BGI__Rect u;
+
+    u.left = a.left < b.left ? a.left : b.left;
+    u.top = a.top < b.top ? a.top : b.top;
+    u.right = a.right > b.right ? a.right : b.right;
+    u.bottom = a.bottom > b.bottom ? a.bottom : b.bottom;
+    return u;
+}
+
+
+/*****************************************************************************
+*
+*   The tracker
+*
+*****************************************************************************/
+
+void BGI__DamageInit( BGI__Damage* d, int width, int height, int rate )
+{
+    d->width = width;
+    d->height = height;
+    d->count = 0;
+    d->changes = d->merged = d->presents = 0;
+    d->bytes = 0;
+    d->last_present = std::chrono::steady_clock::now( );
+    BGI__DamageSetRate( d, rate );
+}
+
+
+void BGI__DamageSetRate( BGI__Damage* d, int rate )
+{
+    d->interval = ( rate > 0 ) ? 1000 / rate : 0;
+}
+
+
+// A new rectangle is merged with every region whose union with it wastes no
+// more area than the two have in common (overlapping or touching rectangles,
+// such as the pieces of a polyline).  Merging may grow it into further
+// regions, so the search starts over after each merge.  If it still stands
+// alone and there is no room left, it goes into the region it enlarges least.
+//
+void BGI__DamageAdd( BGI__Damage* d, const BGI__Rect* rect )
+{
+    BGI__Rect r = { 0, 0, d->width, d->height };
+    int i;
+
+    d->changes++;
+    if ( rect != NULL )
+    {
+        if ( rect->left > r.left ) r.left = rect->left;
+        if ( rect->top > r.top ) r.top = rect->top;
+        if ( rect->right < r.right ) r.right = rect->right;
+        if ( rect->bottom < r.bottom ) r.bottom = rect->bottom;
+        if ( r.left >= r.right || r.top >= r.bottom )
+            return;
+    }
+
+    for ( i = 0; i < d->count; i++ )
+    {
+        BGI__Rect u = Union( d->regions[i], r );
+        if ( Area( u ) <= Area( d->regions[i] ) + Area( r ) )
+        {
+            // Take region i out and keep looking with the bigger rectangle
+            r = u;
+            d->regions[i] = d->regions[--d->count];
+            d->merged++;
+            i = -1;
+        }
+    }
+
+    if ( d->count < BGI__MAX_DAMAGE )
+    {
+        d->regions[d->count++] = r;
+        return;
+    }
+
+    int best = 0;
+    long long best_growth = -1;
+    for ( i = 0; i < d->count; i++ )
+    {
+        long long growth = Area( Union( d->regions[i], r ) ) - Area( d->regions[i] );
+        if ( best_growth < 0 || growth < best_growth )
+        {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    d->regions[best] = Union( d->regions[best], r );
+    d->merged++;
+}
+
+
+bool BGI__DamageDue( const BGI__Damage* d )
+{
+    if ( d->count == 0 )
+        return false;
+    if ( d->interval == 0 )
+        return true;
+    return std::chrono::steady_clock::now( ) - d->last_present >= std::chrono::milliseconds( d->interval );
+}
+
+
+int BGI__DamageTake( BGI__Damage* d, BGI__Rect* out )
+{
+    int n = d->count;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        out[i] = d->regions[i];
+        d->bytes += (unsigned long long) Area( out[i] ) * sizeof( uint32_t );
+    }
+    d->count = 0;
+    if ( n > 0 )
+    {
+        d->presents++;
+        d->last_present = std::chrono::steady_clock::now( );
+    }
+    return n;
+}
@@ -0,0 +1,63 @@
+// File: damage.h
+//
+// Keeps track of the parts of a window that have changed since they were
+// last shown ("damage").  Drawing functions report one rectangle per call;
+// the tracker merges them into at most BGI__MAX_DAMAGE regions and says when
+// it is time to present them, so that the cost of bringing the screen up to
+// date depends on how much changed rather than on how many calls were made.
+// Both backends use it.  The caller does the locking.
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <chrono>               // Provides std::chrono::steady_clock
+#include "surface.h"            // Provides BGI__Rect
+
+// The most regions kept apart.  Past this, a new rectangle is merged with the
+// region it enlarges least.
+#define BGI__MAX_DAMAGE 8
+
+// The default limit on how often changes are presented (setrefreshratebgi).
+#define BGI__DEFAULT_REFRESH_RATE 60
+
+// ---------------------------------------------------------------------------
+//                              Structures
+// ---------------------------------------------------------------------------
+struct BGI__Damage
+{
+    int width, height;          // Size of the window; rectangles are clipped to it
+    BGI__Rect regions[BGI__MAX_DAMAGE]; // Changed areas not yet presented
+    int count;                  // Number of regions in use
+    int interval;               // Least time between presents in ms (0: present every change)
+    std::chrono::steady_clock::time_point last_present;
+
+    // Counters reported by getrefreshstatsbgi
+    unsigned long changes;      // Rectangles reported
+    unsigned long merged;       // Rectangles merged into another region
+    unsigned long presents;     // Times the regions were presented
+    unsigned long long bytes;   // Pixel bytes in the presented regions
+};
+
+
+// ---------------------------------------------------------------------------
+//                              Prototypes
+// ---------------------------------------------------------------------------
+// Sets up an empty tracker for a width x height window presenting at most
+// rate times a second.
+void BGI__DamageInit( BGI__Damage* d, int width, int height, int rate );
+
+// Sets the most presents per second; 0 or less presents every change.
+void BGI__DamageSetRate( BGI__Damage* d, int rate );
+
+// Records a changed rectangle (device coordinates).  NULL means the whole
+// window.
+void BGI__DamageAdd( BGI__Damage* d, const BGI__Rect* rect );
+
+// True if there is something to present and the rate allows it now.
+bool BGI__DamageDue( const BGI__Damage* d );
+
+// Copies the regions to be presented into out (room for BGI__MAX_DAMAGE),
+// empties the tracker and updates the counters.  Returns how many there are.
+int BGI__DamageTake( BGI__Damage* d, BGI__Rect* out );
+
+#endif // DAMAGE_H
@@ -25,6 +25,7 @@
 #include "winbgi.h"         // API routines
 #include "winbgitypes.h"    // Internal structure data
 #include "dibapi.h"         // DIB functions from Microsoft
+#include "surface.h"        // Provides BGI__ColorrefToPixel
 #include <iostream>
 
 #ifndef M_PI
@@ -67,6 +68,24 @@ WindowData* BGI__GetWindowDataPtr( HWND hWnd )
 }
 
 
+// These functions take and release the lock that guards the pages of a
+// window (lock.h).  A drawing call never goes ahead without the lock: if it
+// has waited BGI__LOCK_TIMEOUT ms, the wait is reported to the debugger and
+// counted in the window's lock statistics, and the call keeps waiting.
+//
+void BGI__LockWindow( WindowData* pWndData )
+{
+    while ( !BGI__LockAcquire( &pWndData->hDCLock, BGI__LOCK_TIMEOUT ) )
+        OutputDebugStringA( "WinBGIm: still waiting for the window lock after 5 seconds\n" );
+}
+
+
+void BGI__UnlockWindow( WindowData* pWndData )
+{
+    BGI__LockRelease( &pWndData->hDCLock );
+}
+
+
 // This function returns the device context of the active page for the window
 // given by hWnd.  This device context can be used for GDI drawing commands.
 //
@@ -79,10 +98,10 @@ HDC BGI__GetWinbgiDC( HWND hWnd )
     // This gets the address of the WindowData structure associated with the window
     WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
 
-    // MGM: Added mutex to prevent conflict with OnPaint thread.
+    // MGM: Added lock to prevent conflict with OnPaint thread.
     // Anyone who calls BGI_GetWinbgiDC must later call
     // BGI_ReleaseWinbgiDC.
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     // This is the device context we want to draw to
     return pWndData->hDC[pWndData->ActivePage];
 }
@@ -97,10 +116,10 @@ void BGI__ReleaseWinbgiDC( HWND hWnd )
     // This gets the address of the WindowData structure associated with the window
     WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
 
-    // MGM: Added mutex to prevent conflict with OnPaint thread.
+    // MGM: Added lock to prevent conflict with OnPaint thread.
     // Anyone who calls BGI_GetWinbgiDC must later call
     // BGI_ReleaseWinbgiDC.
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 
@@ -118,6 +137,31 @@ void CenterToBox( int x, int y, int xradius, int yradius,
 }
 
 
+// This function refreshes the bounding box of n_points (x,y) pairs, widened
+// by the line thickness so the whole outline is included.
+//
+static void RefreshPoints( int n_points, int* points )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    int pad = pWndData->lineInfo.thickness / 2 + 1;
+    RECT rect;
+
+    if ( n_points <= 0 )
+        return;
+    rect.left = rect.right = points[0];
+    rect.top = rect.bottom = points[1];
+    for ( int i = 1; i < n_points; i++ )
+    {
+        rect.left = min( rect.left, points[2*i] );
+        rect.right = max( rect.right, points[2*i] );
+        rect.top = min( rect.top, points[2*i + 1] );
+        rect.bottom = max( rect.bottom, points[2*i + 1] );
+    }
+    InflateRect( &rect, pad, pad );
+    RefreshWindow( &rect );
+}
+
+
 // This function converts coordinates of an arc, specified by a center, radii,
 // and start and end angle to actual coordinates of the window of the start
 // and end of the arc.
@@ -145,13 +189,17 @@ void ArcEndPoints( int x, int y, int xradius, int yradius, int stangle,
 // POSTCONDITION: The parameter rect has been updated to now refer to
 //                device coordinates instead of logical coordinates.  Also,
 //                if we are refreshing, then the region specified by rect
-//                (in device coordinates) has been marked to repaint
+//                (in device coordinates) has been added to the window's
+//                damage, which is presented at the refresh rate (by the
+//                next call that finds it due, or by the window's timer).
 void RefreshWindow( RECT* rect )
 {
     HDC hDC;
     WindowData* pWndData = BGI__GetWindowDataPtr( );
     POINT p[2];
+    bool due = false;
 
+    hDC = BGI__GetWinbgiDC( );
     if ( rect != NULL )
     {
         p[0].x = rect->left;
@@ -160,9 +208,7 @@ void RefreshWindow( RECT* rect )
         p[1].y = rect->bottom;
 
         // Convert from the device points to logical points (viewport relative)
-	hDC = BGI__GetWinbgiDC( );
         LPtoDP( hDC, p, 2 );
-        BGI__ReleaseWinbgiDC( );
 	
         // Copy back into the rectangle
         rect->left = p[0].x;
@@ -174,10 +220,71 @@ void RefreshWindow( RECT* rect )
     if (pWndData->refreshing || rect == NULL)
     {    
 	// Only invalidate the window if we are viewing what we are drawing.
-	// The call to InvalidateRect can fail, but I don't know what to do if it does.
 	if ( pWndData->VisualPage == pWndData->ActivePage )
-	    InvalidateRect( pWndData->hWnd, rect, FALSE );
+	{
+	    BGI__Rect damage;
+	    if ( rect != NULL )
+	    {
+		damage.left = rect->left;
+		damage.top = rect->top;
+		damage.right = rect->right;
+		damage.bottom = rect->bottom;
+	    }
+	    BGI__DamageAdd( &pWndData->damage, rect ? &damage : NULL );
+	    due = BGI__DamageDue( &pWndData->damage );
+	}
     }
+    BGI__ReleaseWinbgiDC( );
+
+    if ( due )
+	BGI__PresentDamage( pWndData, false );
+}
+
+
+// This function invalidates the damaged regions of the window so the paint
+// method copies them to the screen.  Unless force is set, nothing happens
+// until the refresh rate allows another present.
+//
+void BGI__PresentDamage( WindowData* pWndData, bool force )
+{
+    BGI__Rect regions[BGI__MAX_DAMAGE];
+    int n = 0;
+
+    BGI__LockWindow( pWndData );
+    if ( force || BGI__DamageDue( &pWndData->damage ) )
+        n = BGI__DamageTake( &pWndData->damage, regions );
+    BGI__UnlockWindow( pWndData );
+
+    // The call to InvalidateRect can fail, but I don't know what to do if it does.
+    for ( int i = 0; i < n; i++ )
+    {
+        RECT rect = { regions[i].left, regions[i].top, regions[i].right, regions[i].bottom };
+        InvalidateRect( pWndData->hWnd, &rect, FALSE );
+    }
+}
+
+
+// These functions collect the bounds of whatever GDI draws into hDC between
+// them (GetBoundsRect), for calls whose extent is hard to predict, such as
+// text and flood fills.  BGI__RefreshBounds refreshes what was drawn, or the
+// whole window if GDI did not report anything.
+//
+void BGI__BeginBounds( HDC hDC )
+{
+    SetBoundsRect( hDC, NULL, DCB_ENABLE | DCB_RESET );
+}
+
+
+void BGI__RefreshBounds( HDC hDC )
+{
+    RECT rect;
+    UINT result = GetBoundsRect( hDC, &rect, DCB_RESET );
+
+    SetBoundsRect( hDC, NULL, DCB_DISABLE );
+    if ( result == DCB_SET )
+        RefreshWindow( &rect );
+    else
+        RefreshWindow( NULL );
 }
 
 bool getrefreshingbgi( )
@@ -194,6 +301,51 @@ void setrefreshingbgi(bool value)
 void refreshallbgi( )
 {
     RefreshWindow(NULL);
+    flushbgi( );
+}
+
+
+void setrefreshratebgi( int hz )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    BGI__LockWindow( pWndData );
+    BGI__DamageSetRate( &pWndData->damage, hz );
+    BGI__UnlockWindow( pWndData );
+}
+
+
+void flushbgi( )
+{
+    BGI__PresentDamage( BGI__GetWindowDataPtr( ), true );
+}
+
+
+void getrefreshstatsbgi( refreshstatstype *stats )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    BGI__LockWindow( pWndData );
+    stats->changes = pWndData->damage.changes;
+    stats->merged = pWndData->damage.merged;
+    stats->presents = pWndData->damage.presents;
+    stats->bytes = pWndData->damage.bytes;
+    BGI__UnlockWindow( pWndData );
+}
+
+
+void getlockstatsbgi( lockstatstype *stats )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Lock* l = &pWndData->hDCLock;
+
+    BGI__LockWindow( pWndData );
+    stats->acquisitions = l->acquisitions;
+    stats->contended = l->contended;
+    stats->timeouts = l->timeouts;
+    stats->wait_ms = l->wait_ns / 1e6;
+    stats->max_wait_ms = l->max_wait_ns / 1e6;
+    BGI__UnlockWindow( pWndData );
 }
 
 void refreshbgi(int left, int top, int right, int bottom)
@@ -482,9 +634,7 @@ void drawpoly(int n_points, int* points)
     Polyline(hDC, (POINT*)points, n_points);
     BGI__ReleaseWinbgiDC( );
     
-    // One could compute the convex hull of these points and create the
-    // associated region to update...
-    RefreshWindow( NULL );
+    RefreshPoints( n_points, points );
 }
 
 
@@ -572,7 +722,7 @@ void fillpoly(int n_points, int* points)
     SetTextColor( hDC, color );
     BGI__ReleaseWinbgiDC( );
 
-    RefreshWindow( NULL );
+    RefreshPoints( n_points, points );
 }
 
 
@@ -593,13 +743,13 @@ void floodfill( int x, int y, int border )
     border = converttorgb( border );
     hDC = BGI__GetWinbgiDC( );
     SetTextColor( hDC, color );
+    BGI__BeginBounds( hDC );
     FloodFill( hDC, x, y, border );
+    BGI__RefreshBounds( hDC );
     // Reset the text color to the drawing color
     color = converttorgb( pWndData->drawColor );
     SetTextColor( hDC, color );
     BGI__ReleaseWinbgiDC( );
-
-    RefreshWindow( NULL );
 }
 
 
@@ -736,6 +886,149 @@ void putpixel( int x, int y, int color )
 }
 
 
+// Plots n_points pixels with a single trip through the DC mutex and a single
+// refresh of the smallest rectangle holding all of them.  Each pixel gets
+// colors[i], or color when colors is NULL.  The pixels are written straight
+// into the bits of the active page's DIB section, as lockbuffer hands them
+// out, rather than with a SetPixelV call each, so they are clipped here the
+// way the clipping region of setviewport would: to the viewport if it clips,
+// else to the page.  When the box around all the points lies inside that,
+// as it does for a fill, the loop needs no test per pixel.
+//
+static void PlotPixels( int n_points, const int* xs, const int* ys, const int* colors, int color )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    RECT clip = { 0, 0, pWndData->width, pWndData->height };
+    RECT rect = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    int left = xs[0], top = ys[0], right = xs[0], bottom = ys[0];
+    DWORD palette[16];
+    DWORD pixel = BGI__ColorrefToPixel( converttorgb( color ) );
+
+    if ( pWndData->viewportInfo.clip != 0 )
+    {
+        clip.left = max( clip.left, pWndData->viewportInfo.left );
+        clip.top = max( clip.top, pWndData->viewportInfo.top );
+        clip.right = min( clip.right, pWndData->viewportInfo.right );
+        clip.bottom = min( clip.bottom, pWndData->viewportInfo.bottom );
+    }
+    for ( int i = 0; i < 16; i++ )
+        palette[i] = BGI__ColorrefToPixel( BGI__Colors[i] );
+    for ( int i = 1; i < n_points; i++ )
+    {
+        left = min( left, xs[i] );
+        right = max( right, xs[i] );
+        top = min( top, ys[i] );
+        bottom = max( bottom, ys[i] );
+    }
+
+    BGI__GetWinbgiDC( );
+    // GDI may still have drawing queued for the bitmap
+    GdiFlush( );
+    DWORD* pixels = pWndData->pixels[pWndData->ActivePage];
+    long pitch = pWndData->width;
+    if ( left + dx >= clip.left && right + dx < clip.right && top + dy >= clip.top && bottom + dy < clip.bottom )
+    {
+        long origin = dy * pitch + dx;
+
+        if ( colors == NULL )
+            for ( int i = 0; i < n_points; i++ )
+                pixels[origin + ys[i] * pitch + xs[i]] = pixel;
+        else
+            for ( int i = 0; i < n_points; i++ )
+                pixels[origin + ys[i] * pitch + xs[i]] = IS_BGI_COLOR( colors[i] ) ? palette[colors[i]] :
+                                                         BGI__ColorrefToPixel( colors[i] & 0xFFFFFF );
+        rect.left = left;
+        rect.top = top;
+        rect.right = right + 1;
+        rect.bottom = bottom + 1;
+    }
+    else
+    {
+        for ( int i = 0; i < n_points; i++ )
+        {
+            int x = xs[i] + dx;
+            int y = ys[i] + dy;
+            if ( x < clip.left || x >= clip.right || y < clip.top || y >= clip.bottom )
+                continue;
+            if ( colors != NULL )
+                pixel = IS_BGI_COLOR( colors[i] ) ? palette[colors[i]] : BGI__ColorrefToPixel( colors[i] & 0xFFFFFF );
+            pixels[y * pitch + x] = pixel;
+            // RefreshWindow takes logical (viewport relative) coordinates
+            rect.left = min( rect.left, xs[i] );
+            rect.top = min( rect.top, ys[i] );
+            rect.right = max( rect.right, xs[i] + 1 );
+            rect.bottom = max( rect.bottom, ys[i] + 1 );
+        }
+    }
+    BGI__ReleaseWinbgiDC( );
+
+    if ( rect.left < rect.right )
+        RefreshWindow( &rect );
+}
+
+
+void putpixels( int n_points, const int* xs, const int* ys, const int* colors )
+{
+    if ( n_points > 0 )
+        PlotPixels( n_points, xs, ys, colors, 0 );
+}
+
+
+void putpixelscolor( int n_points, const int* xs, const int* ys, int color )
+{
+    if ( n_points > 0 )
+        PlotPixels( n_points, xs, ys, NULL, color );
+}
+
+
+// This function gives the caller the pixels of the active page, which is a
+// top-down 32-bit DIB section.  The DC mutex is held until unlockbuffer, so
+// the paint thread cannot copy a half-written page to the screen.
+//
+unsigned int* lockbuffer( int* pitch )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    BGI__GetWinbgiDC( );
+    // GDI may still have drawing queued for the bitmap
+    GdiFlush( );
+    if ( pitch != NULL )
+        *pitch = pWndData->width;
+    return (unsigned int*) pWndData->pixels[pWndData->ActivePage];
+}
+
+
+// This function releases the page taken by lockbuffer and refreshes the
+// given rectangle (device coordinates, inclusive).
+//
+void unlockbuffer( int left, int top, int right, int bottom )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    RECT rect;
+
+    BGI__ReleaseWinbgiDC( );
+
+    rect.left = max( 0, min(left, right) );
+    rect.top = max( 0, min(top, bottom) );
+    rect.right = min( pWndData->width - 1, max(left, right) ) + 1;
+    rect.bottom = min( pWndData->height - 1, max(top, bottom) ) + 1;
+    if ( rect.left >= rect.right || rect.top >= rect.bottom )
+        return;
+
+    // RefreshWindow expects logical (viewport relative) coordinates
+    OffsetRect( &rect, -pWndData->viewportInfo.left, -pWndData->viewportInfo.top );
+    RefreshWindow( &rect );
+}
+
+
+unsigned int bufferpixel( int color )
+{
+    return BGI__ColorrefToPixel( converttorgb( color ) );
+}
+
+
 // This function draws a rectangle border in the current line style, thickness, and color
 //
 void rectangle( int left, int top, int right, int bottom )
@@ -932,7 +1225,8 @@ void putimage( int left, int top, void *bitmap, int op )
 	BitBlt(hDC, left, top, width, height, hMemoryDC, 0, 0, NOTSRCCOPY);
 	break;
     }
-    RefreshWindow( NULL );
+    RECT rect = { left, top, left + width, top + height };
+    RefreshWindow( &rect );
 
     
     // Delete resources
@@ -1112,7 +1406,7 @@ void writeimagefile(
 
     // Preliminary computations
     pWndData = BGI__GetWindowDataPtr(hwnd);
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     if (active)
 	hDC = pWndData->hDC[pWndData->ActivePage];
     else
@@ -1147,7 +1441,7 @@ void writeimagefile(
 	SaveDIB(hDIB, filename);
     
     // Delete resources
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     DestroyDIB(hDIB);
     SelectObject(hMemoryDC, hOldBitmap); // Restore original bmp so it's deleted
     DeleteObject(hBitmap);               // Delete the bitmap we used
@@ -1195,7 +1489,7 @@ void printimage(
 
     // Get the window's hDC, width and height
     pWndData = BGI__GetWindowDataPtr(hwnd);
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     if (active)
 	hDC = pWndData->hDC[pWndData->ActivePage];
     else
@@ -1259,7 +1553,7 @@ void printimage(
     }
 
     // Delete the resources
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     SelectObject(hMemoryDC, hOldBitmap); // Restore original bmp so it's deleted
     DeleteObject(hBitmap);               // Delete the bitmap we used
     DeleteDC(hMemoryDC);                 // Delete the memory dc and it's bmp
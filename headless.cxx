@@ -0,0 +1,2130 @@
+// File: headless.cxx
+//
+// The headless backend: the whole graphics.h API implemented on top of
+// in-memory surfaces (surface.h) instead of Win32 windows and GDI.  There is
+// no message thread and no screen.  initwindow allocates the pages, every
+// drawing call rasterizes straight into the active page, and writeimagefile
+// saves a page as a .bmp, so BGI programs can run unattended (for example in
+// batch jobs on machines without a display).
+//
+// This file is only compiled into the library when BGI_HEADLESS is defined,
+// which graphics.h does automatically on platforms without the Win32 API.
+// The Win32 sources (drawing.cxx, misc.cxx, text.cxx, ...) are left out of
+// such builds.
+//
+
+#include "winbgi.h"             // API routines (and BGI_HEADLESS)
+#ifdef BGI_HEADLESS
+
+#define _USE_MATH_DEFINES       // Actually use the definitions in math.h
+#include <math.h>               // For mathematical functions
+#include <stdio.h>              // Provides fopen, sprintf and getchar
+#include <stdlib.h>             // Provides abs
+#include <string.h>             // Provides memcpy and strlen
+#include <errno.h>              // Provides errno for showerrorbox
+#include <limits.h>             // Provides INT_MAX and UINT_MAX
+#include <chrono>               // Provides std::chrono::milliseconds
+#include <thread>               // Provides std::this_thread::sleep_for
+#include <sstream>              // Provides ostringstream
+#include <vector>               // Provides STL vector class
+#include "headless.h"           // Internal structure data
+#include "surface.h"            // The software rasterizers
+#include "damage.h"             // Provides the damage tracker
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef min
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#endif
+
+// Value returned by getpixel for a point outside the window, as in GDI.
+#define CLR_INVALID 0xFFFFFFFF
+
+
+/*****************************************************************************
+*
+*   Global Variables
+*
+*****************************************************************************/
+// The table of windows, indexed by the value initwindow returns.  Each HWND
+// is really the WindowData* of the window.
+std::vector<HWND> BGI__WindowTable;
+int BGI__WindowCount = 0;                    // Number of windows currently in use
+int BGI__CurrentWindow = NO_CURRENT_WINDOW;  // Index to current window
+
+// The RGB values of the 16 BGI colors.  These are set in graphdefaults.
+COLORREF BGI__Colors[16];
+
+// The exported definition of bgiout.
+std::ostringstream bgiout;
+
+// Line styles as 16-bit patterns, first pixel in bit 0.  USERBIT_LINE uses
+// the pattern given to setlinestyle.
+static const unsigned line_patterns[] =
+{
+    0xFFFF,     // SOLID_LINE
+    0xCCCC,     // DOTTED_LINE
+    0xF1F8,     // CENTER_LINE
+    0xF8F8      // DASHED_LINE
+};
+
+// Fill styles as 8x8 patterns, leftmost pixel in the high bit.  These follow
+// the hatch brushes and bitmaps that setfillstyle in misc.cxx creates, so the
+// two backends produce the same pictures.  USER_FILL uses the pattern given
+// to setfillpattern.
+static const unsigned char fill_patterns[USER_FILL][8] =
+{
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },     // EMPTY_FILL
+    { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },     // SOLID_FILL
+    { 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },     // LINE_FILL
+    { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 },     // LTSLASH_FILL
+    { 0xE0, 0xC1, 0x83, 0x07, 0x0E, 0x1C, 0x38, 0x70 },     // SLASH_FILL
+    { 0x07, 0x83, 0xC1, 0xE0, 0x70, 0x38, 0x1C, 0x0E },     // BKSLASH_FILL
+    { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 },     // LTBKSLASH_FILL
+    { 0xFF, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },     // HATCH_FILL
+    { 0x81, 0x42, 0x24, 0x18, 0x18, 0x24, 0x42, 0x81 },     // XHATCH_FILL
+    { 0xCC, 0x33, 0xCC, 0x33, 0xCC, 0x33, 0xCC, 0x33 },     // INTERLEAVE_FILL
+    { 0x80, 0x00, 0x08, 0x00, 0x80, 0x00, 0x08, 0x00 },     // WIDE_DOT_FILL
+    { 0x88, 0x00, 0x22, 0x00, 0x88, 0x00, 0x22, 0x00 }      // CLOSE_DOT_FILL
+};
+
+// The header at the front of the buffer used by getimage and putimage.  The
+// pixels follow, row by row, in surface format.
+struct ImageHeader
+{
+    int width;
+    int height;
+};
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+// This function returns a pointer to the internal data structure holding all
+// necessary data for the window specified by hWnd.
+//
+WindowData* BGI__GetWindowDataPtr( HWND hWnd )
+{
+    // Get the handle to the current window from the table if none is
+    // specified.  Otherwise, use the specified value
+    if ( hWnd == NULL && BGI__CurrentWindow >= 0 && BGI__CurrentWindow < BGI__WindowCount)
+        hWnd = BGI__WindowTable[BGI__CurrentWindow];
+    if (hWnd == NULL)
+    {
+	showerrorbox("Drawing operation was attempted when there was no current window.");
+	exit(0);
+    }
+    return (WindowData*)hWnd;
+}
+
+
+// These functions take and release the lock that guards the pages of a
+// window (lock.h).  A drawing call never goes ahead without the lock: if it
+// has waited BGI__LOCK_TIMEOUT ms, the wait is reported on stderr and
+// counted in the window's lock statistics, and the call keeps waiting.
+//
+void BGI__LockWindow( WindowData* pWndData )
+{
+    while ( !BGI__LockAcquire( &pWndData->surfaceLock, BGI__LOCK_TIMEOUT ) )
+        fprintf( stderr, "WinBGIm: still waiting for the window lock after 5 seconds\n" );
+}
+
+
+void BGI__UnlockWindow( WindowData* pWndData )
+{
+    BGI__LockRelease( &pWndData->surfaceLock );
+}
+
+
+// Holds the lock of a window for the rest of the enclosing block.
+struct WindowLock
+{
+    WindowData* pWndData;
+    WindowLock( WindowData* p ) : pWndData( p ) { BGI__LockWindow( pWndData ); }
+    ~WindowLock( ) { BGI__UnlockWindow( pWndData ); }
+};
+
+
+// This function returns the surface of a page, allocating its pixels the
+// first time the page is used.  Most programs only ever touch one or two of
+// the MAX_PAGES pages, so there is no point paying for all of them up front.
+// The caller must hold the surface mutex.
+//
+static BGI__Surface* PageSurface( WindowData* pWndData, int page )
+{
+    BGI__Surface* s = &pWndData->page[page];
+
+    if ( s->pixels == NULL )
+    {
+        if ( !BGI__SurfaceCreate( s, pWndData->width, pWndData->height ) )
+        {
+            showerrorbox( "Insufficient memory for the window's pages" );
+            exit( 0 );
+        }
+        // A fresh page starts out in the background color
+        BGI__Rect all = { 0, 0, s->width, s->height };
+        BGI__SurfaceFill( s, &all, BGI__ColorrefToPixel( converttorgb( pWndData->bgColor ) ) );
+    }
+    return s;
+}
+
+
+// This function locks the pages of the window given by hWnd and returns the
+// active page.  Anyone who calls BGI__GetWinbgiSurface must later call
+// BGI__ReleaseWinbgiSurface.
+//
+BGI__Surface* BGI__GetWinbgiSurface( HWND hWnd )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
+
+    BGI__LockWindow( pWndData );
+    return PageSurface( pWndData, pWndData->ActivePage );
+}
+
+
+void BGI__ReleaseWinbgiSurface( HWND hWnd )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
+
+    BGI__UnlockWindow( pWndData );
+}
+
+
+// Presents the damaged regions of the window if the refresh rate allows it
+// or force is set.  There is no screen to copy them to, so presenting only
+// empties the tracker and updates its counters.
+//
+static void PresentDamage( WindowData* pWndData, bool force )
+{
+    BGI__Rect regions[BGI__MAX_DAMAGE];
+    WindowLock lock( pWndData );
+
+    if ( force || BGI__DamageDue( &pWndData->damage ) )
+        BGI__DamageTake( &pWndData->damage, regions );
+}
+
+
+// Adds rect (device coordinates; NULL for the whole window) to the damage
+// of the current window, as the Win32 RefreshWindow does, and presents it if
+// it is due.  Pages are otherwise only looked at when the program reads them
+// back (getpixel, getimage, writeimagefile).
+//
+void RefreshWindow( BGI__Rect* rect )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    if ( !pWndData->refreshing && rect != NULL )
+        return;
+    // Only changes to the page being viewed count.
+    if ( pWndData->VisualPage != pWndData->ActivePage )
+        return;
+
+    WindowLock lock( pWndData );
+    BGI__DamageAdd( &pWndData->damage, rect );
+    if ( BGI__DamageDue( &pWndData->damage ) )
+        PresentDamage( pWndData, false );
+}
+
+
+// Shows the whole visual page at once, as after a page flip.
+//
+static void PresentAll( WindowData* pWndData )
+{
+    WindowLock lock( pWndData );
+    BGI__DamageAdd( &pWndData->damage, NULL );
+    PresentDamage( pWndData, true );
+}
+
+
+// Converts a color the user gave us to the pixel value stored in a surface.
+//
+static inline uint32_t ToPixel( int color )
+{
+    return BGI__ColorrefToPixel( converttorgb( color ) );
+}
+
+
+// Returns the clipping rectangle of the current viewport in device
+// coordinates.  Without clipping this is the whole window.
+//
+static BGI__Rect ClipRect( WindowData* pWndData )
+{
+    BGI__Rect clip = { 0, 0, pWndData->width, pWndData->height };
+
+    if ( pWndData->viewportInfo.clip != 0 )
+    {
+        clip.left = max( 0, pWndData->viewportInfo.left );
+        clip.top = max( 0, pWndData->viewportInfo.top );
+        clip.right = min( pWndData->width, pWndData->viewportInfo.right );
+        clip.bottom = min( pWndData->height, pWndData->viewportInfo.bottom );
+        if ( clip.right < clip.left ) clip.right = clip.left;
+        if ( clip.bottom < clip.top ) clip.bottom = clip.top;
+    }
+    return clip;
+}
+
+
+// Builds the pen for the current color and line settings.
+//
+static BGI__Pen CurrentPen( WindowData* pWndData )
+{
+    BGI__Pen pen;
+
+    pen.color = ToPixel( pWndData->drawColor );
+    if ( pWndData->lineInfo.linestyle == USERBIT_LINE )
+        pen.pattern = pWndData->lineInfo.upattern & 0xFFFF;
+    else if ( pWndData->lineInfo.linestyle >= SOLID_LINE && pWndData->lineInfo.linestyle <= DASHED_LINE )
+        pen.pattern = line_patterns[pWndData->lineInfo.linestyle];
+    else
+        pen.pattern = 0xFFFF;
+    pen.thickness = pWndData->lineInfo.thickness;
+    pen.writemode = pWndData->writeMode;
+    return pen;
+}
+
+
+// Builds the brush for the current fill settings.
+//
+static BGI__Brush CurrentBrush( WindowData* pWndData )
+{
+    BGI__Brush brush;
+    int pattern = pWndData->fillInfo.pattern;
+
+    brush.color = ToPixel( pWndData->fillInfo.color );
+    brush.bkcolor = ToPixel( pWndData->bgColor );
+    if ( pattern == USER_FILL )
+        memcpy( brush.pattern, pWndData->uPattern, 8 );
+    else if ( pattern >= EMPTY_FILL && pattern < USER_FILL )
+        memcpy( brush.pattern, fill_patterns[pattern], 8 );
+    else
+        memcpy( brush.pattern, fill_patterns[SOLID_FILL], 8 );
+    return brush;
+}
+
+
+// Draws the connected line segments through n_points (x,y) pairs.
+//
+static void Polyline( BGI__Surface* s, const BGI__Rect* clip, int dx, int dy,
+                      int n_points, const int* points, const BGI__Pen* pen )
+{
+    for ( int i = 0; i + 1 < n_points; i++ )
+        BGI__SurfaceLine( s, clip, points[2*i] + dx, points[2*i + 1] + dy,
+                          points[2*i + 2] + dx, points[2*i + 3] + dy, pen );
+}
+
+
+// Refreshes the bounding box of n_points (x,y) pairs moved by (dx,dy),
+// widened by the line thickness so the whole outline is included.
+//
+static void RefreshPoints( WindowData* pWndData, int n_points, const int* points, int dx, int dy )
+{
+    int pad = pWndData->lineInfo.thickness / 2 + 1;
+    BGI__Rect rect;
+
+    if ( n_points <= 0 )
+        return;
+    rect.left = rect.right = points[0];
+    rect.top = rect.bottom = points[1];
+    for ( int i = 1; i < n_points; i++ )
+    {
+        rect.left = min( rect.left, points[2*i] );
+        rect.right = max( rect.right, points[2*i] );
+        rect.top = min( rect.top, points[2*i + 1] );
+        rect.bottom = max( rect.bottom, points[2*i + 1] );
+    }
+    rect.left += dx - pad;
+    rect.right += dx + pad;
+    rect.top += dy - pad;
+    rect.bottom += dy + pad;
+    RefreshWindow( &rect );
+}
+
+
+// This function converts coordinates of an arc, specified by a center, radii,
+// and start and end angle to actual coordinates of the window of the start
+// and end of the arc (the same computation as drawing.cxx).
+//
+static void ArcEndPoints( int x, int y, int xradius, int yradius, int stangle,
+                          int endangle, int* xstart, int* ystart, int* xend, int* yend )
+{
+    *xstart = x + int( xradius * cos( stangle  * M_PI / 180 ) );
+    *ystart = y - int( yradius * sin( stangle  * M_PI / 180 ) );
+    *xend   = x + int( xradius * cos( endangle * M_PI / 180 ) );
+    *yend   = y - int( yradius * sin( endangle * M_PI / 180 ) );
+}
+
+
+// Draws a filled, outlined pie slice (or a whole ellipse) for fillellipse,
+// pieslice and sector.
+//
+static void FilledPie( int x, int y, int stangle, int endangle, int xradius, int yradius, bool edges )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    BGI__Brush brush = CurrentBrush( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    int xstart, ystart, xend, yend;
+
+    ArcEndPoints( x + dx, y + dy, xradius, yradius, stangle, endangle, &xstart, &ystart, &xend, &yend );
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceFillPie( s, &clip, x + dx, y + dy, xradius, yradius, stangle, endangle, &brush );
+    BGI__SurfaceArc( s, &clip, x + dx, y + dy, xradius, yradius, stangle, endangle, &pen );
+    if ( edges )
+    {
+        BGI__SurfaceLine( s, &clip, x + dx, y + dy, xstart, ystart, &pen );
+        BGI__SurfaceLine( s, &clip, x + dx, y + dy, xend, yend, &pen );
+    }
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { x + dx - xradius, y + dy - yradius, x + dx + xradius + 1, y + dy + yradius + 1 };
+    RefreshWindow( &rect );
+}
+
+
+/*****************************************************************************
+*
+*   Window creation and graphics manipulation
+*
+*****************************************************************************/
+
+void showerrorbox( const char* msg )
+{
+    if ( msg == NULL )
+        msg = strerror( errno );
+    fprintf( stderr, "Error: %s\n", msg );
+}
+
+
+void graphdefaults( )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    // Set viewport to the entire screen and move current position to (0,0)
+    setviewport( 0, 0, pWndData->width, pWndData->height, 0 );
+    pWndData->mouse.x = 0;
+    pWndData->mouse.y = 0;
+
+    // Turn on autorefreshing
+    pWndData->refreshing = true;
+
+    // The same colors as graphdefaults in winbgi.cxx
+    BGI__Colors[0] = RGB( 0, 0, 0 );         // Black
+    BGI__Colors[1] = RGB( 0, 0, 128);        // Blue
+    BGI__Colors[2] = RGB( 0, 128, 0 );       // Green
+    BGI__Colors[3] = RGB( 0, 128, 128 );     // Cyan
+    BGI__Colors[4] = RGB( 128, 0, 0 );       // Red
+    BGI__Colors[5] = RGB( 128, 0, 128 );     // Magenta
+    BGI__Colors[6] = RGB( 128, 128, 0 );     // Brown
+    BGI__Colors[7] = RGB( 192, 192, 192 );   // Light Gray
+    BGI__Colors[8] = RGB( 128, 128, 128 );   // Dark Gray
+    BGI__Colors[9] = RGB( 128, 128, 255 );   // Light Blue
+    BGI__Colors[10] = RGB( 128, 255, 128 );  // Light Green
+    BGI__Colors[11] = RGB( 128, 255, 255 );  // Light Cyan
+    BGI__Colors[12] = RGB( 255, 128, 128 );  // Light Red
+    BGI__Colors[13] = RGB( 255, 128, 255 );  // Light Magenta
+    BGI__Colors[14] = RGB( 255, 255, 0 );    // Yellow
+    BGI__Colors[15] = RGB( 255, 255, 255 );  // White
+
+    // Set background color to default (black)
+    setbkcolor( BLACK );
+
+    // Set drawing color to default (white)
+    pWndData->drawColor = WHITE;
+    pWndData->writeMode = COPY_PUT;
+    // Set fill style and pattern to default (white solid)
+    pWndData->fillInfo.pattern = SOLID_FILL;
+    pWndData->fillInfo.color = WHITE;
+
+    // Set text font and justification to default
+    pWndData->textInfo.horiz = LEFT_TEXT;
+    pWndData->textInfo.vert = TOP_TEXT;
+    pWndData->textInfo.font = DEFAULT_FONT;
+    pWndData->textInfo.direction = HORIZ_DIR;
+    pWndData->textInfo.charsize = 1;
+
+    pWndData->t_scale[0] = 1; // multx
+    pWndData->t_scale[1] = 1; // divx
+    pWndData->t_scale[2] = 1; // multy
+    pWndData->t_scale[3] = 1; // divy
+
+    // Set the error code to Ok: There is no error
+    pWndData->error_code = grOk;
+
+    // Line style as well?
+    pWndData->lineInfo.linestyle = SOLID_LINE;
+    pWndData->lineInfo.upattern = 0xFFFF;
+    pWndData->lineInfo.thickness = NORM_WIDTH;
+
+    // Set the default active and visual page
+    if ( pWndData->DoubleBuffer )
+    {
+        pWndData->ActivePage = 1;
+        pWndData->VisualPage = 0;
+    }
+    else
+    {
+        pWndData->ActivePage = 0;
+        pWndData->VisualPage = 0;
+    }
+
+    pWndData->x_aspect_ratio = 10000;
+    pWndData->y_aspect_ratio = 10000;
+}
+
+
+// The initwindow function is typicaly the first function called by the
+// application.  In the headless backend it only allocates the window's
+// structure; the pages are allocated as they are first drawn on.
+// RETURN VALUE: If the window is successfully created, a nonnegative integer
+//                  uniquely identifing the window.
+//               On failure, -1.
+//
+int initwindow
+( int width, int height, const char* title, int left, int top, bool dbflag , bool closeflag)
+{
+    int index;                          // Index of current window in the table
+
+    if ( width <= 0 || height <= 0 )
+        return -1;
+
+    WindowData* pWndData = new WindowData;
+    pWndData->width = width;
+    pWndData->height = height;
+    pWndData->title = title; // Converts to a string object
+    pWndData->DoubleBuffer = dbflag;
+    pWndData->CloseBehavior = closeflag;
+    pWndData->bgColor = BLACK;
+    memset( pWndData->page, 0, sizeof( pWndData->page ) );
+    memset( pWndData->uPattern, 0xFF, sizeof( pWndData->uPattern ) );
+    memset( pWndData->mouse_handlers, 0, sizeof( pWndData->mouse_handlers ) );
+    memset( &pWndData->arcInfo, 0, sizeof( pWndData->arcInfo ) );
+    BGI__DamageInit( &pWndData->damage, width, height, BGI__DEFAULT_REFRESH_RATE );
+
+    // Set index to the next available position
+    index = BGI__WindowCount;
+    // Increment the count
+    ++BGI__WindowCount;
+    // Store the window in the next position of the vector
+    BGI__WindowTable.push_back( (HWND)pWndData );
+    // Set the current window to the newly created window
+    BGI__CurrentWindow = index;
+
+    // Set up the defaults for the window
+    graphdefaults( );
+
+    // Make sure the first page can be allocated now rather than failing in
+    // the middle of a drawing call.
+    BGI__GetWinbgiSurface( );
+    BGI__ReleaseWinbgiSurface( );
+
+    // Everything went well!  Return the window index to the user.
+    return index;
+}
+
+
+void closegraph(int wid)
+{
+    if (wid == CURRENT_WINDOW)
+	closegraph(BGI__CurrentWindow);
+    else if (wid == ALL_WINDOWS)
+    {
+	for ( int i = 0; i < BGI__WindowCount; i++ )
+	    closegraph(i);
+    }
+    else if (wid >= 0 && wid < BGI__WindowCount && BGI__WindowTable[wid] != NULL)
+    {
+        WindowData* pWndData = (WindowData*)BGI__WindowTable[wid];
+
+        for ( int i = 0; i < MAX_PAGES; i++ )
+            BGI__SurfaceDestroy( &pWndData->page[i] );
+        delete pWndData;
+
+	// Remove the window from the BGI__WindowTable vector:
+	BGI__WindowTable[wid] = NULL;
+
+	// Reset the global BGI__CurrentWindow if needed:
+	if (BGI__CurrentWindow == wid)
+	    BGI__CurrentWindow = NO_CURRENT_WINDOW;
+    }
+}
+
+
+// This fuction detects the graphics driver and returns the highest resolution
+// mode possible.  This is always VGA/VGAHI
+//
+void detectgraph( int *graphdriver, int *graphmode )
+{
+    *graphdriver = VGA;
+    *graphmode = VGAHI;
+}
+
+
+void getaspectratio( int *xasp, int *yasp )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+    *xasp = pWndData->x_aspect_ratio;
+    *yasp = pWndData->y_aspect_ratio;
+}
+
+
+// There is no window to type into, so keys come from standard input.  At
+// the end of the input, getch returns 0 instead of waiting forever.
+//
+int getch( )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+    int c;
+
+    if ( pWndData->kbd_queue.empty( ) )
+    {
+        c = getchar( );
+        return c == EOF ? 0 : c;
+    }
+
+    c = pWndData->kbd_queue.front( );             // Obtain the next element in the queue
+    pWndData->kbd_queue.pop( );                   // Remove the element from the queue
+    return c;
+}
+
+
+int kbhit( )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    return !pWndData->kbd_queue.empty( );
+}
+
+
+char *getdrivername( )
+{
+    return (char*) "EGAVGA";
+}
+
+
+int getgraphmode( )
+{
+    return VGAHI;
+}
+
+
+int getmaxmode( )
+{
+    return VGAHI;
+}
+
+
+char *getmodename( int mode_number )
+{
+    static char mode[32];
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    sprintf( mode, "%d*%d VGAHI", pWndData->width, pWndData->height );
+    return mode;
+}
+
+
+void getmoderange( int graphdriver, int *lomode, int *himode )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+    int graphmode;
+
+    // Use current driver modes
+    if ( graphdriver == -1 )
+        detectgraph( &graphdriver, &graphmode );
+
+    switch ( graphdriver )
+    {
+    case CGA:      *lomode = CGAC0;     *himode = CGAHI;     break;
+    case MCGA:     *lomode = MCGAC0;    *himode = MCGAHI;    break;
+    case EGA:      *lomode = EGALO;     *himode = EGAHI;     break;
+    case EGA64:    *lomode = EGA64LO;   *himode = EGA64HI;   break;
+    case EGAMONO:  *lomode = *himode = EGAMONOHI;            break;
+    case HERCMONO: *lomode = *himode = HERCMONOHI;           break;
+    case ATT400:   *lomode = ATT400C0;  *himode = ATT400HI;  break;
+    case VGA:      *lomode = VGALO;     *himode = VGAHI;     break;
+    case PC3270:   *lomode = *himode = PC3270HI;             break;
+    case IBM8514:  *lomode = IBM8514LO; *himode = IBM8514HI; break;
+    default:
+        *lomode = *himode = -1;
+        pWndData->error_code = grInvalidDriver;
+        break;
+    }
+}
+
+
+char *grapherrormsg( int errorcode )
+{
+    static const char *msg[16] = { "No error", "Graphics not installed",
+        "Graphics hardware not detected", "Device driver not found",
+        "Invalid device driver file", "Insufficient memory to load driver",
+        "Out of memory in scan fill", "Out of memory in flood fill",
+        "Font file not found", "Not enough meory to load font",
+        "Invalid mode for selected driver", "Graphics error",
+        "Graphics I/O error", "Invalid font file",
+        "Invalid font number", "Invalid device number" };
+
+    if ( ( errorcode < -15 ) || ( errorcode > 0 ) )
+        return NULL;
+    else
+        return (char*) msg[-errorcode];
+}
+
+
+int graphresult( )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+    int code;
+
+    code = pWndData->error_code;
+    pWndData->error_code = grOk;
+    return code;
+}
+
+
+// This function uses the information in graphdriver and graphmode to select
+// the appropriate size for the window to be created.  Only the common modes
+// are distinguished; anything else gets a 640x480 window.
+//
+void initgraph( int *graphdriver, int *graphmode, char *pathtodriver )
+{
+    int width = 640, height = 480;
+
+    if ( *graphdriver == DETECT )
+        detectgraph( graphdriver, graphmode );
+
+    switch ( *graphdriver )
+    {
+    case CGA:
+    case MCGA:
+    case ATT400:
+        width = ( *graphmode == CGAHI || *graphmode == MCGAMED ) ? 640 : 320;
+        height = 200;
+        if ( *graphdriver == MCGA && *graphmode == MCGAHI ) { width = 640; height = 480; }
+        if ( *graphdriver == ATT400 && *graphmode == ATT400HI ) { width = 640; height = 400; }
+        break;
+    case EGA:
+    case EGA64:
+        height = ( *graphmode == EGALO ) ? 200 : 350;
+        break;
+    case EGAMONO:
+        height = 350;
+        break;
+    case HERCMONO:
+        width = 720;
+        height = 348;
+        break;
+    case VGA:
+        height = ( *graphmode == VGALO ) ? 200 : ( *graphmode == VGAMED ) ? 350 : 480;
+        break;
+    case PC3270:
+        width = 720;
+        height = 350;
+        break;
+    case IBM8514:
+        if ( *graphmode == IBM8514HI ) { width = 1024; height = 768; }
+        break;
+    }
+
+    initwindow( width, height );
+    if ( *graphdriver < DETECT || *graphdriver > PC3270 )
+        BGI__GetWindowDataPtr( )->error_code = grInvalidDriver;
+}
+
+
+void restorecrtmode( )
+{ }
+
+
+void setaspectratio( int xasp, int yasp )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    pWndData->x_aspect_ratio = xasp;
+    pWndData->y_aspect_ratio = yasp;
+}
+
+
+void setgraphmode( int mode )
+{
+    // Reset graphics stuff to default
+    graphdefaults( );
+    // Clear the screen
+    cleardevice( );
+}
+
+
+// Not available in WinBGI
+int installuserdriver( char *name, int *fp ) { return grError; }
+int installuserfont( char *name ) { return grError; }
+int registerbgidriver( void *driver ) { return grError; }
+int registerbgifont( void *font ) { return grError; }
+unsigned setgraphbufsize( unsigned bufsize ) { return 0; }
+
+
+int getcurrentwindow( )
+{
+    return BGI__CurrentWindow;
+}
+
+
+void setcurrentwindow( int window )
+{
+    if ( (window < 0) || (window >= BGI__WindowCount) || BGI__WindowTable[window] == NULL)
+        return;
+
+    BGI__CurrentWindow = window;
+}
+
+
+/*****************************************************************************
+*
+*   Double buffering support
+*
+*****************************************************************************/
+
+int getactivepage( )
+{
+    return BGI__GetWindowDataPtr( )->ActivePage;
+}
+
+
+int getvisualpage( )
+{
+    return BGI__GetWindowDataPtr( )->VisualPage;
+}
+
+
+void setactivepage( int page )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    if ( (page < 0) || (page >= MAX_PAGES) )
+        return;
+
+    pWndData->ActivePage = page;
+}
+
+
+void setvisualpage( int page )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    if ( (page < 0) || (page >= MAX_PAGES) )
+        return;
+
+    pWndData->VisualPage = page;
+    PresentAll( pWndData );
+}
+
+
+void swapbuffers( )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+
+    if ( pWndData->ActivePage == 0 )
+    {
+        pWndData->VisualPage = 0;
+        pWndData->ActivePage = 1;
+    }
+    else    // Active page is 1
+    {
+        pWndData->VisualPage = 1;
+        pWndData->ActivePage = 0;
+    }
+    PresentAll( pWndData );
+}
+
+
+/*****************************************************************************
+*
+*   Refreshing
+*
+*****************************************************************************/
+
+bool getrefreshingbgi( )
+{
+    return BGI__GetWindowDataPtr( )->refreshing;
+}
+
+
+void setrefreshingbgi(bool value)
+{
+    BGI__GetWindowDataPtr( )->refreshing = value;
+}
+
+
+void refreshallbgi( )
+{
+    RefreshWindow( NULL );
+    flushbgi( );
+}
+
+
+void refreshbgi(int left, int top, int right, int bottom)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect rect;
+
+    rect.left = min(left, right) + pWndData->viewportInfo.left;
+    rect.top = min(top, bottom) + pWndData->viewportInfo.top;
+    rect.right = max(left, right) + pWndData->viewportInfo.left;
+    rect.bottom = max(top, bottom) + pWndData->viewportInfo.top;
+
+    // Only refresh if we are viewing what we are drawing.
+    if ( pWndData->VisualPage != pWndData->ActivePage )
+        return;
+    WindowLock lock( pWndData );
+    BGI__DamageAdd( &pWndData->damage, &rect );
+    PresentDamage( pWndData, true );
+}
+
+
+void setrefreshratebgi( int hz )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    WindowLock lock( pWndData );
+
+    BGI__DamageSetRate( &pWndData->damage, hz );
+}
+
+
+void flushbgi( )
+{
+    PresentDamage( BGI__GetWindowDataPtr( ), true );
+}
+
+
+void getrefreshstatsbgi( refreshstatstype *stats )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    WindowLock lock( pWndData );
+
+    stats->changes = pWndData->damage.changes;
+    stats->merged = pWndData->damage.merged;
+    stats->presents = pWndData->damage.presents;
+    stats->bytes = pWndData->damage.bytes;
+}
+
+
+void getlockstatsbgi( lockstatstype *stats )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Lock* l = &pWndData->surfaceLock;
+    WindowLock lock( pWndData );
+
+    stats->acquisitions = l->acquisitions;
+    stats->contended = l->contended;
+    stats->timeouts = l->timeouts;
+    stats->wait_ms = l->wait_ns / 1e6;
+    stats->max_wait_ms = l->max_wait_ns / 1e6;
+}
+
+
+/*****************************************************************************
+*
+*   Drawing functions
+*
+*****************************************************************************/
+
+// This function draws a circular arc, centered at (x,y) with the given radius.
+// The arc travels from angle stangle to angle endangle.
+// POSTCONDITION: The arccoords variable (arcinfo) for the current window
+//                is set with data resulting from this call.
+//                The current position is not modified.
+//
+void arc( int x, int y, int stangle, int endangle, int radius )
+{
+    ellipse( x, y, stangle, endangle, radius, radius );
+}
+
+
+// This function draws a 2D bar.  Like FillRect in the Win32 backend, the
+// right and bottom edges are not included.
+//
+void bar( int left, int top, int right, int bottom )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Brush brush = CurrentBrush( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    BGI__Rect rect = { left + dx, top + dy, right + dx, bottom + dy };
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceFillRect( s, &clip, &rect, &brush );
+    BGI__ReleaseWinbgiSurface( );
+
+    RefreshWindow( &rect );
+}
+
+
+// This function draws a bar with a 3D outline.  The angle of the bar background is
+// 30 degrees.
+void bar3d( int left, int top, int right, int bottom, int depth, int topflag )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    BGI__Brush brush = CurrentBrush( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    int ddy = (int)(depth * tan( 30.0 * M_PI / 180.0 ));
+    BGI__Rect inside = { left + 1, top + 1, right - 1, bottom - 1 };
+    int box[10] = { left, top, right - 1, top, right - 1, bottom - 1, left, bottom - 1, left, top };
+    int side[8] = { right, bottom, right + depth, bottom - ddy, right + depth, top - ddy, right, top };
+    int lid[6] = { right + depth, top - ddy, left + depth, top - ddy, left, top };
+
+    inside.left += dx; inside.right += dx;
+    inside.top += dy; inside.bottom += dy;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceFillRect( s, &clip, &inside, &brush );
+    Polyline( s, &clip, dx, dy, 5, box, &pen );
+    // A depth of zero is a way to draw a 2D bar with an outline.
+    if ( depth != 0 )
+        Polyline( s, &clip, dx, dy, 4, side, &pen );
+    if ( topflag != 0 )
+        Polyline( s, &clip, dx, dy, 3, lid, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { left + dx, top - ddy + dy, right + depth + 1 + dx, bottom + 1 + dy };
+    RefreshWindow( &rect );
+}
+
+
+// Thus function draws a circle centered at (x,y) of given radius.
+//
+void circle( int x, int y, int radius )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceArc( s, &clip, x + dx, y + dy, radius, radius, 0, 360, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { x + dx - radius, y + dy - radius, x + dx + radius + 1, y + dy + radius + 1 };
+    RefreshWindow( &rect );
+}
+
+
+// This function clears the graphics screen (with the background color) and
+// moves the current point to (0,0)
+//
+void cleardevice( )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    uint32_t color = ToPixel( pWndData->bgColor );
+
+    // Even though a viewport may be set, this function clears the entire screen.
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__Rect all = { 0, 0, s->width, s->height };
+    BGI__SurfaceFill( s, &all, color );
+    BGI__ReleaseWinbgiSurface( );
+
+    // Move the CP back to (0,0) (NOT viewport relative)
+    moveto( -pWndData->viewportInfo.left, -pWndData->viewportInfo.top );
+
+    RefreshWindow( NULL );
+}
+
+
+// This function clears the current viewport (with the background color) and
+// moves the current point to (0,0 (relative to the viewport)
+//
+void clearviewport( )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    uint32_t color = ToPixel( pWndData->bgColor );
+    BGI__Rect rect = { pWndData->viewportInfo.left, pWndData->viewportInfo.top,
+                       pWndData->viewportInfo.right, pWndData->viewportInfo.bottom };
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    if ( BGI__SurfaceClipRect( s, &rect ) )
+        BGI__SurfaceFill( s, &rect, color );
+    BGI__ReleaseWinbgiSurface( );
+    moveto( 0, 0 );
+
+    RefreshWindow( NULL );
+}
+
+
+void drawpoly(int n_points, int* points)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    Polyline( s, &clip, pWndData->viewportInfo.left, pWndData->viewportInfo.top, n_points, points, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    RefreshPoints( pWndData, n_points, points, pWndData->viewportInfo.left, pWndData->viewportInfo.top );
+}
+
+
+// This function draws an elliptical arc with the current drawing color,
+// centered at (x,y) with major and minor axes given by xradius and yradius.
+// The arc travels from angle stangle to angle endangle.
+//
+void ellipse( int x, int y, int stangle, int endangle, int xradius, int yradius )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceArc( s, &clip, x + dx, y + dy, xradius, yradius, stangle, endangle, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { x + dx - xradius, y + dy - yradius, x + dx + xradius + 1, y + dy + yradius + 1 };
+    RefreshWindow( &rect );
+
+    // Set the arccoords structure to relevant data.
+    pWndData->arcInfo.x = x;
+    pWndData->arcInfo.y = y;
+    ArcEndPoints( x, y, xradius, yradius, stangle, endangle,
+                  &pWndData->arcInfo.xstart, &pWndData->arcInfo.ystart,
+                  &pWndData->arcInfo.xend, &pWndData->arcInfo.yend );
+}
+
+
+void fillellipse( int x, int y, int xradius, int yradius )
+{
+    FilledPie( x, y, 0, 360, xradius, yradius, false );
+}
+
+
+void fillpoly(int n_points, int* points)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    BGI__Brush brush = CurrentBrush( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    std::vector<int> device( points, points + 2 * n_points );
+
+    if ( n_points <= 0 )
+        return;
+    for ( int i = 0; i < n_points; i++ )
+    {
+        device[2*i] += dx;
+        device[2*i + 1] += dy;
+    }
+    // Close the outline like GDI's Polygon does
+    device.push_back( device[0] );
+    device.push_back( device[1] );
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceFillPolygon( s, &clip, n_points, &device[0], &brush );
+    Polyline( s, &clip, 0, 0, n_points + 1, &device[0], &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    RefreshPoints( pWndData, n_points, &device[0], 0, 0 );
+}
+
+
+// This function fills an enclosed area bordered by a given color.  If the
+// reference point (x,y) is within the closed area, the area is filled.  If
+// it is outside the closed area, the outside area will be filled.  The
+// current fill pattern and style is used.
+//
+void floodfill( int x, int y, int border )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Brush brush = CurrentBrush( pWndData );
+    BGI__Rect filled;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceFloodFill( s, &clip, x + pWndData->viewportInfo.left, y + pWndData->viewportInfo.top,
+                           ToPixel( border ), &brush, &filled );
+    BGI__ReleaseWinbgiSurface( );
+
+    if ( filled.left < filled.right )
+        RefreshWindow( &filled );
+}
+
+
+// This function draws a line from (x1,y1) to (x2,y2) using the current line
+// style and thickness.  It does not update the current point.
+//
+void line( int x1, int y1, int x2, int y2 )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceLine( s, &clip, x1 + dx, y1 + dy, x2 + dx, y2 + dy, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    // The update rectangle does not contain the right or bottom edge.  Thus
+    // add 1 so the entire region is included.
+    BGI__Rect rect = { min(x1,x2) + dx, min(y1,y2) + dy, max(x1,x2) + 1 + dx, max(y1,y2) + 1 + dy };
+    RefreshWindow( &rect );
+}
+
+
+// This function draws a line from the current point to a point that is a
+// relative distance (dx,dy) away.  The current point is updated to the final
+// point.
+//
+void linerel( int dx, int dy )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    lineto( pWndData->cp.x + dx, pWndData->cp.y + dy );
+}
+
+
+// This function draws a line from the current point to (x,y).  The current
+// point is updated to (x,y)
+//
+void lineto( int x, int y )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    line( pWndData->cp.x, pWndData->cp.y, x, y );
+    pWndData->cp.x = x;
+    pWndData->cp.y = y;
+}
+
+
+void pieslice( int x, int y, int stangle, int endangle, int radius )
+{
+    FilledPie( x, y, stangle, endangle, radius, radius, true );
+}
+
+
+// This function plots a pixel in the specified color at point (x,y)
+//
+void putpixel( int x, int y, int color )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+
+    x += pWndData->viewportInfo.left;
+    y += pWndData->viewportInfo.top;
+    if ( x < clip.left || x >= clip.right || y < clip.top || y >= clip.bottom )
+        return;
+
+    // One lock for the pixel and its refresh; the second take is recursive.
+    uint32_t pixel = ToPixel( color );
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceRow( s, y )[x] = pixel;
+
+    BGI__Rect rect = { x, y, x+1, y+1 };
+    RefreshWindow( &rect );
+    BGI__ReleaseWinbgiSurface( );
+}
+
+
+// Plots n_points pixels while holding the lock once, and refreshes the
+// smallest rectangle holding all of them.  Each pixel gets colors[i], or
+// color when colors is NULL.  The 16 BGI colors are converted up front so
+// the loop does no function calls, and the box around all the points is
+// found first: when it lies inside the clip rectangle, as it does for a
+// fill, the loop plots without testing each pixel or growing the refresh
+// rectangle.
+//
+static void PlotPixels( int n_points, const int* xs, const int* ys, const int* colors, int color )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Rect rect = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+    int left = xs[0], top = ys[0], right = xs[0], bottom = ys[0];
+    uint32_t palette[16];
+    uint32_t pixel = ToPixel( color );
+
+    for ( int i = 0; i < 16; i++ )
+        palette[i] = BGI__ColorrefToPixel( BGI__Colors[i] );
+    for ( int i = 1; i < n_points; i++ )
+    {
+        left = min( left, xs[i] );
+        right = max( right, xs[i] );
+        top = min( top, ys[i] );
+        bottom = max( bottom, ys[i] );
+    }
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    if ( left + dx >= clip.left && right + dx < clip.right && top + dy >= clip.top && bottom + dy < clip.bottom )
+    {
+        uint32_t* pixels = s->pixels;
+        long pitch = s->pitch;
+        long origin = dy * pitch + dx;
+
+        if ( colors == NULL )
+            for ( int i = 0; i < n_points; i++ )
+                pixels[origin + ys[i] * pitch + xs[i]] = pixel;
+        else
+            for ( int i = 0; i < n_points; i++ )
+                pixels[origin + ys[i] * pitch + xs[i]] = IS_BGI_COLOR( colors[i] ) ? palette[colors[i]] :
+                                                         BGI__ColorrefToPixel( colors[i] & 0xFFFFFF );
+        rect.left = left + dx;
+        rect.top = top + dy;
+        rect.right = right + dx + 1;
+        rect.bottom = bottom + dy + 1;
+    }
+    else
+    {
+        for ( int i = 0; i < n_points; i++ )
+        {
+            int x = xs[i] + dx;
+            int y = ys[i] + dy;
+            if ( x < clip.left || x >= clip.right || y < clip.top || y >= clip.bottom )
+                continue;
+            if ( colors != NULL )
+                pixel = IS_BGI_COLOR( colors[i] ) ? palette[colors[i]] : BGI__ColorrefToPixel( colors[i] & 0xFFFFFF );
+            BGI__SurfaceRow( s, y )[x] = pixel;
+            rect.left = min( rect.left, x );
+            rect.top = min( rect.top, y );
+            rect.right = max( rect.right, x + 1 );
+            rect.bottom = max( rect.bottom, y + 1 );
+        }
+    }
+    BGI__ReleaseWinbgiSurface( );
+
+    if ( rect.left < rect.right )
+        RefreshWindow( &rect );
+}
+
+
+void putpixels( int n_points, const int* xs, const int* ys, const int* colors )
+{
+    if ( n_points > 0 )
+        PlotPixels( n_points, xs, ys, colors, 0 );
+}
+
+
+void putpixelscolor( int n_points, const int* xs, const int* ys, int color )
+{
+    if ( n_points > 0 )
+        PlotPixels( n_points, xs, ys, NULL, color );
+}
+
+
+// The pages already are plain arrays of pixels in the format lockbuffer
+// promises, so the active page is handed out as it is.  The surface mutex is
+// held until unlockbuffer.
+//
+unsigned int* lockbuffer( int* pitch )
+{
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+
+    if ( pitch != NULL )
+        *pitch = s->pitch;
+    return (unsigned int*) s->pixels;
+}
+
+
+void unlockbuffer( int left, int top, int right, int bottom )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect rect;
+
+    BGI__ReleaseWinbgiSurface( );
+
+    rect.left = max( 0, min(left, right) );
+    rect.top = max( 0, min(top, bottom) );
+    rect.right = min( pWndData->width - 1, max(left, right) ) + 1;
+    rect.bottom = min( pWndData->height - 1, max(top, bottom) ) + 1;
+    if ( rect.left < rect.right && rect.top < rect.bottom )
+        RefreshWindow( &rect );
+}
+
+
+unsigned int bufferpixel( int color )
+{
+    return ToPixel( color );
+}
+
+
+// This function draws a rectangle border in the current line style, thickness, and color
+//
+void rectangle( int left, int top, int right, int bottom )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    BGI__Pen pen = CurrentPen( pWndData );
+    int endpoints[10] = { left, top, right, top, right, bottom, left, bottom, left, top };
+    int dx = pWndData->viewportInfo.left;
+    int dy = pWndData->viewportInfo.top;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    Polyline( s, &clip, dx, dy, 5, endpoints, &pen );
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { left + dx, top + dy, right + 1 + dx, bottom + 1 + dy };
+    RefreshWindow( &rect );
+}
+
+
+void sector( int x, int y, int stangle, int endangle, int xradius, int yradius )
+{
+    FilledPie( x, y, stangle, endangle, xradius, yradius, true );
+}
+
+
+/*****************************************************************************
+*
+*   Miscellaneous functions
+*
+*****************************************************************************/
+
+// This function converts a given color (specified by the user) into a
+// COLORREF (0x00BBGGRR).
+//
+int converttorgb( int color )
+{
+    // Convert from BGI color to RGB color
+    if ( IS_BGI_COLOR( color ) )
+        color = BGI__Colors[color];
+    else
+        color &= 0x0FFFFFF;
+
+    return color;
+}
+
+
+int COLOR(int r, int g, int b)
+{
+    COLORREF color = RGB(r,g,b);
+    int i;
+
+    for (i = 0; i <= WHITE; i++)
+    {
+	if ( color == BGI__Colors[i] )
+	    return i;
+    }
+
+    return ( 0x03000000 | color );
+}
+
+
+int getdisplaycolor( int color )
+{
+    // Every color can be stored exactly in a 32-bit page
+    if ( IS_BGI_COLOR( color ) )
+        return color;
+    return COLOR( RED_VALUE( color ), GREEN_VALUE( color ), BLUE_VALUE( color ) );
+}
+
+
+void delay( int msec )
+{
+    std::this_thread::sleep_for( std::chrono::milliseconds( msec ) );
+}
+
+
+void getarccoords( arccoordstype *arccoords )
+{
+    *arccoords = BGI__GetWindowDataPtr( )->arcInfo;
+}
+
+
+int getbkcolor( )
+{
+    return BGI__GetWindowDataPtr( )->bgColor;
+}
+
+
+int getcolor( )
+{
+    return BGI__GetWindowDataPtr( )->drawColor;
+}
+
+
+void getfillpattern( char *pattern )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    memcpy( pattern, pWndData->uPattern, sizeof( pWndData->uPattern ) );
+}
+
+
+void getfillsettings( fillsettingstype *fillinfo )
+{
+    *fillinfo = BGI__GetWindowDataPtr( )->fillInfo;
+}
+
+
+void getlinesettings( linesettingstype *lineinfo )
+{
+    *lineinfo = BGI__GetWindowDataPtr( )->lineInfo;
+}
+
+
+int getmaxcolor( )
+{
+    return WHITE;
+}
+
+
+int getmaxx( )
+{
+    return BGI__GetWindowDataPtr( )->width - 1;
+}
+
+
+int getmaxy( )
+{
+    return BGI__GetWindowDataPtr( )->height - 1;
+}
+
+
+// There is no screen, so report the size of a typical one.  The size can be
+// changed with BGI_HEADLESS_SCREEN_WIDTH and BGI_HEADLESS_SCREEN_HEIGHT.
+int getmaxheight( )
+{
+    return BGI_HEADLESS_SCREEN_HEIGHT;
+}
+
+
+int getmaxwidth( )
+{
+    return BGI_HEADLESS_SCREEN_WIDTH;
+}
+
+
+// A headless window has no borders or caption.
+int getwindowheight( )
+{
+    return BGI__GetWindowDataPtr( )->height;
+}
+
+
+int getwindowwidth( )
+{
+    return BGI__GetWindowDataPtr( )->width;
+}
+
+
+int getpixel( int x, int y )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    COLORREF color;
+    int i;
+
+    x += pWndData->viewportInfo.left;
+    y += pWndData->viewportInfo.top;
+    if ( x < 0 || x >= pWndData->width || y < 0 || y >= pWndData->height )
+        return CLR_INVALID;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    color = BGI__PixelToColorref( BGI__SurfaceRow( s, y )[x] );
+    BGI__ReleaseWinbgiSurface( );
+
+    // If the color is a BGI color, return the index rather than the RGB value.
+    for ( i = 0; i <= WHITE; i++ )
+    {
+        if ( color == BGI__Colors[i] )
+            return i;
+    }
+
+    // If we got here, the color didn't match a BGI color.  Thus, convert to
+    // our RGB format.
+    return color | 0x03000000;
+}
+
+
+void getviewsettings( viewporttype *viewport )
+{
+    *viewport = BGI__GetWindowDataPtr( )->viewportInfo;
+}
+
+
+int getx( )
+{
+    return BGI__GetWindowDataPtr( )->cp.x;
+}
+
+
+int gety( )
+{
+    return BGI__GetWindowDataPtr( )->cp.y;
+}
+
+
+void moverel( int dx, int dy )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    pWndData->cp.x += dx;
+    pWndData->cp.y += dy;
+}
+
+
+void moveto( int x, int y )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    pWndData->cp.x = x;
+    pWndData->cp.y = y;
+}
+
+
+void setbkcolor( int color )
+{
+    BGI__GetWindowDataPtr( )->bgColor = color;
+}
+
+
+void setcolor( int color )
+{
+    BGI__GetWindowDataPtr( )->drawColor = color;
+}
+
+
+void setlinestyle( int linestyle, unsigned upattern, int thickness )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    pWndData->lineInfo.linestyle = linestyle;
+    pWndData->lineInfo.upattern = upattern;
+    pWndData->lineInfo.thickness = thickness;
+}
+
+
+void setfillpattern( char *upattern, int color )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    memcpy( pWndData->uPattern, upattern, sizeof( pWndData->uPattern ) );
+    pWndData->fillInfo.pattern = USER_FILL;
+    pWndData->fillInfo.color = color;
+}
+
+
+// If the USER_FILL pattern is passed, nothing is changed.
+//
+void setfillstyle( int pattern, int color )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    if ( pattern == USER_FILL )
+        return;
+    if ( pattern < EMPTY_FILL || pattern > USER_FILL )
+    {
+        pWndData->error_code = grError;
+        return;
+    }
+
+    pWndData->fillInfo.pattern = pattern;
+    pWndData->fillInfo.color = color;
+}
+
+
+void setviewport( int left, int top, int right, int bottom, int clip )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    // Store the viewport information in the structure
+    pWndData->viewportInfo.left = left;
+    pWndData->viewportInfo.top = top;
+    pWndData->viewportInfo.right = right;
+    pWndData->viewportInfo.bottom = bottom;
+    pWndData->viewportInfo.clip = clip;
+
+    // Move to the new origin
+    moveto( 0, 0 );
+}
+
+
+void setwritemode( int mode )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    if ( mode == COPY_PUT || mode == XOR_PUT )
+        pWndData->writeMode = mode;
+}
+
+
+/*****************************************************************************
+*
+*   Image functions
+*
+*****************************************************************************/
+
+unsigned int imagesize(int left, int top, int right, int bottom)
+{
+    double answer = sizeof( ImageHeader ) +
+        (1.0 + abs(right - left)) * (1.0 + abs(bottom - top)) * sizeof( uint32_t );
+
+    if ( answer > UINT_MAX ) answer = 0;
+    return (unsigned int) answer;
+}
+
+
+void getimage(int left, int top, int right, int bottom, void *bitmap)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    ImageHeader* header = (ImageHeader*) bitmap;
+    uint32_t* pixels = (uint32_t*) (header + 1);
+    int x0 = min(left, right) + pWndData->viewportInfo.left;
+    int y0 = min(top, bottom) + pWndData->viewportInfo.top;
+    int x, y;
+
+    header->width = 1 + abs(right - left);
+    header->height = 1 + abs(bottom - top);
+
+    // Anything outside the window comes back black
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    for ( y = 0; y < header->height; y++ )
+    {
+        uint32_t* out = pixels + (long) y * header->width;
+        if ( y0 + y < 0 || y0 + y >= s->height )
+        {
+            memset( out, 0, header->width * sizeof( uint32_t ) );
+            continue;
+        }
+        const uint32_t* row = BGI__SurfaceRow( s, y0 + y );
+        for ( x = 0; x < header->width; x++ )
+            out[x] = ( x0 + x >= 0 && x0 + x < s->width ) ? row[x0 + x] : 0;
+    }
+    BGI__ReleaseWinbgiSurface( );
+}
+
+
+void putimage( int left, int top, void *bitmap, int op )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    const ImageHeader* header = (const ImageHeader*) bitmap;
+    int x = left + pWndData->viewportInfo.left;
+    int y = top + pWndData->viewportInfo.top;
+
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    BGI__SurfaceBlit( s, &clip, x, y, (const uint32_t*) (header + 1),
+                      header->width, header->height, header->width, op );
+    BGI__ReleaseWinbgiSurface( );
+
+    BGI__Rect rect = { x, y, x + header->width, y + header->height };
+    RefreshWindow( &rect );
+}
+
+
+// Helpers for the little-endian fields of a .bmp file
+static void PutLE( unsigned char* p, unsigned value, int bytes )
+{
+    for ( int i = 0; i < bytes; i++ )
+        p[i] = (unsigned char)( value >> (8 * i) );
+}
+
+static unsigned GetLE( const unsigned char* p, int bytes )
+{
+    unsigned value = 0;
+    for ( int i = bytes - 1; i >= 0; i-- )
+        value = (value << 8) | p[i];
+    return value;
+}
+
+
+// Reads an uncompressed 24 or 32-bit .bmp file and draws it into the
+// rectangle given.  When right or bottom is INT_MAX, the picture is drawn at
+// its own size.  Other formats set the error code to grIOerror.
+//
+void readimagefile(
+    const char* filename,
+    int left, int top, int right, int bottom
+    )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    BGI__Rect clip = ClipRect( pWndData );
+    unsigned char header[54];
+    std::vector<unsigned char> data;
+    FILE* f;
+    long offset, width, height, bpp, stride;
+    bool bottomup;
+
+    if ( filename == NULL || ( f = fopen( filename, "rb" ) ) == NULL )
+    {
+        pWndData->error_code = grFileNotFound;
+        return;
+    }
+    if ( fread( header, 1, sizeof( header ), f ) != sizeof( header ) || header[0] != 'B' || header[1] != 'M' )
+    {
+        fclose( f );
+        pWndData->error_code = grIOerror;
+        return;
+    }
+    offset = GetLE( header + 10, 4 );
+    width = (int) GetLE( header + 18, 4 );
+    height = (int) GetLE( header + 22, 4 );
+    bpp = GetLE( header + 28, 2 );
+    bottomup = height > 0;
+    if ( height < 0 ) height = -height;
+    stride = ( ( width * bpp + 31 ) / 32 ) * 4;
+    if ( width <= 0 || ( bpp != 24 && bpp != 32 ) || ( GetLE( header + 30, 4 ) != 0 && bpp != 32 ) )
+    {
+        fclose( f );
+        pWndData->error_code = grIOerror;
+        return;
+    }
+    data.resize( (size_t) stride * height );
+    if ( fseek( f, offset, SEEK_SET ) != 0 || fread( &data[0], 1, data.size( ), f ) != data.size( ) )
+    {
+        fclose( f );
+        pWndData->error_code = grIOerror;
+        return;
+    }
+    fclose( f );
+
+    if ( right == INT_MAX ) right = left + width - 1;
+    if ( bottom == INT_MAX ) bottom = top + height - 1;
+    int dw = 1 + abs(right - left), dh = 1 + abs(bottom - top);
+    int x0 = min(left, right) + pWndData->viewportInfo.left;
+    int y0 = min(top, bottom) + pWndData->viewportInfo.top;
+
+    // Scale to the requested size by picking the nearest source pixel
+    BGI__Surface* s = BGI__GetWinbgiSurface( );
+    for ( int y = max( 0, clip.top - y0 ); y < dh && y0 + y < clip.bottom; y++ )
+    {
+        long sy = (long)( (double) y * height / dh );
+        const unsigned char* src = &data[(size_t)( bottomup ? height - 1 - sy : sy ) * stride];
+        uint32_t* row = BGI__SurfaceRow( s, y0 + y );
+        for ( int x = max( 0, clip.left - x0 ); x < dw && x0 + x < clip.right; x++ )
+        {
+            const unsigned char* p = src + (long)( (double) x * width / dw ) * (bpp / 8);
+            row[x0 + x] = ( (uint32_t) p[2] << 16 ) | ( (uint32_t) p[1] << 8 ) | p[0];
+        }
+    }
+    BGI__ReleaseWinbgiSurface( );
+
+    RefreshWindow( NULL );
+}
+
+
+// Saves part of a page as a 24-bit .bmp file.  Without a file name (there is
+// no dialog to ask for one) the window title is used.
+//
+void writeimagefile(
+    const char* filename,
+    int left, int top, int right, int bottom,
+    bool active, HWND hwnd
+    )
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( hwnd );
+    std::string name = filename ? filename : ( pWndData->title.size( ) ? pWndData->title : "image" ) + ".bmp";
+    unsigned char header[54] = { 'B', 'M' };
+    std::vector<unsigned char> row;
+    long width, height, stride;
+    FILE* f;
+
+    if (left < 0) left = 0;
+    else if (left >= pWndData->width) left = pWndData->width - 1;
+    if (right < 0) right = 0;
+    else if (right >= pWndData->width) right = pWndData->width - 1;
+    if (bottom < 0) bottom = 0;
+    else if (bottom >= pWndData->height) bottom = pWndData->height - 1;
+    if (top < 0) top = 0;
+    else if (top >= pWndData->height) top = pWndData->height - 1;
+    if (right < left) std::swap( left, right );
+    if (bottom < top) std::swap( top, bottom );
+    width = 1 + right - left;
+    height = 1 + bottom - top;
+    stride = ( width * 3 + 3 ) & ~3;
+
+    if ( ( f = fopen( name.c_str( ), "wb" ) ) == NULL )
+    {
+        pWndData->error_code = grIOerror;
+        return;
+    }
+
+    PutLE( header + 2, 54 + stride * height, 4 );   // File size
+    PutLE( header + 10, 54, 4 );                    // Offset to the pixels
+    PutLE( header + 14, 40, 4 );                    // BITMAPINFOHEADER
+    PutLE( header + 18, width, 4 );
+    PutLE( header + 22, height, 4 );                // Positive: bottom-up
+    PutLE( header + 26, 1, 2 );                     // Planes
+    PutLE( header + 28, 24, 2 );                    // Bits per pixel
+    PutLE( header + 34, stride * height, 4 );       // Image size
+    PutLE( header + 38, 2835, 4 );                  // 72 dpi
+    PutLE( header + 42, 2835, 4 );
+    fwrite( header, 1, sizeof( header ), f );
+
+    row.assign( stride, 0 );
+    BGI__LockWindow( pWndData );
+    BGI__Surface* s = PageSurface( pWndData, active ? pWndData->ActivePage : pWndData->VisualPage );
+    for ( long y = bottom; y >= top; y-- )
+    {
+        const uint32_t* src = BGI__SurfaceRow( s, y ) + left;
+        for ( long x = 0; x < width; x++ )
+        {
+            row[3*x] = (unsigned char) src[x];
+            row[3*x + 1] = (unsigned char)( src[x] >> 8 );
+            row[3*x + 2] = (unsigned char)( src[x] >> 16 );
+        }
+        fwrite( &row[0], 1, stride, f );
+    }
+    BGI__UnlockWindow( pWndData );
+
+    if ( fclose( f ) != 0 )
+        pWndData->error_code = grIOerror;
+}
+
+
+// There is no printer to send anything to.
+//
+void printimage(
+    const char* title,
+    double width_inches, double border_left_inches, double border_top_inches,
+    int left, int top, int right, int bottom, bool active, HWND hwnd
+    )
+{
+    BGI__GetWindowDataPtr( hwnd )->error_code = grError;
+}
+
+
+/*****************************************************************************
+*
+*   Text functions
+*
+*   The headless backend has no fonts, so no glyphs are drawn.  The settings
+*   are kept, the sizes are those of the 8x8 default font, and outtext moves
+*   the current position as if the text had been drawn.
+*
+*****************************************************************************/
+
+void gettextsettings(struct textsettingstype *texttypeinfo)
+{
+    if (!texttypeinfo)
+	return;
+
+    *texttypeinfo = BGI__GetWindowDataPtr( )->textInfo;
+}
+
+
+void outtext(char *textstring)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    if ( pWndData->textInfo.horiz != LEFT_TEXT )
+        return;
+    if ( pWndData->textInfo.direction == HORIZ_DIR )
+        pWndData->cp.x += textwidth( textstring );
+    else
+        pWndData->cp.y -= textwidth( textstring );
+}
+
+
+void outtextxy(int x, int y, char *textstring)
+{
+}
+
+
+void settextjustify(int horiz, int vert)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    pWndData->textInfo.horiz = horiz;
+    pWndData->textInfo.vert  = vert;
+}
+
+
+void settextstyle(int font, int direction, int charsize)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    pWndData->textInfo.font = font;
+    pWndData->textInfo.direction = direction;
+    pWndData->textInfo.charsize = charsize;
+}
+
+
+void setusercharsize(int multx, int divx, int multy, int divy)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    pWndData->t_scale[0] = multx;
+    pWndData->t_scale[1] = divx;
+    pWndData->t_scale[2] = multy;
+    pWndData->t_scale[3] = divy;
+}
+
+
+int textheight(char *textstring)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+
+    if ( pWndData->textInfo.charsize == USER_CHAR_SIZE )
+        return 8 * pWndData->t_scale[2] / max( 1, pWndData->t_scale[3] );
+    return 8 * pWndData->textInfo.charsize;
+}
+
+
+int textwidth(char *textstring)
+{
+    WindowData* pWndData = BGI__GetWindowDataPtr( );
+    int n = (int) strlen( textstring );
+
+    if ( pWndData->textInfo.charsize == USER_CHAR_SIZE )
+        return 8 * n * pWndData->t_scale[0] / max( 1, pWndData->t_scale[1] );
+    return 8 * n * pWndData->textInfo.charsize;
+}
+
+
+void outstreamxy(int x, int y, std::ostringstream& out)
+{
+    std::string all, line;
+    int i;
+    int startx = x;
+
+    all = out.str( );
+    out.str("");
+
+    moveto(x,y);
+    for (i = 0; i < (int) all.length( ); i++)
+    {
+	if (all[i] == '\n')
+	{
+	    if (line.length( ) > 0)
+	    	outtext((char *) line.c_str( ));
+	    y += textheight((char *) "X");
+	    x = startx;
+	    line.clear( );
+	    moveto(x,y);
+	}
+	else
+	    line += all[i];
+    }
+    if (line.length( ) > 0)
+	outtext((char *) line.c_str( ));
+}
+
+
+void outstream(std::ostringstream& out)
+{
+    outstreamxy(getx( ), gety( ), out);
+}
+
+
+/*****************************************************************************
+*
+*   Mouse functions
+*
+*   There is no mouse, so there are never any events.
+*
+*****************************************************************************/
+
+static bool MouseKindInRange( int kind )
+{
+    return ( (kind >= WM_MOUSEFIRST) && (kind <= WM_MOUSELAST) );
+}
+
+
+bool ismouseclick( int kind )
+{
+    return false;
+}
+
+
+void clearmouseclick( int kind )
+{
+}
+
+
+void clearresizeevent( )
+{
+}
+
+
+void getmouseclick( int kind, int& x, int& y )
+{
+    if ( MouseKindInRange( kind ) )
+        x = y = NO_CLICK;
+}
+
+
+bool isresizeevent( )
+{
+    return false;
+}
+
+
+int mousex( )
+{
+    return BGI__GetWindowDataPtr( )->mouse.x;
+}
+
+
+int mousey( )
+{
+    return BGI__GetWindowDataPtr( )->mouse.y;
+}
+
+
+void registermousehandler( int kind, void h( int, int ) )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( );
+    if ( MouseKindInRange( kind ) )
+        pWndData->mouse_handlers[kind - WM_MOUSEFIRST] = h;
+}
+
+
+void setmousequeuestatus( int kind, bool status )
+{
+}
+
+
+/*****************************************************************************
+*
+*   Palette functions (as in palette.cxx)
+*
+*****************************************************************************/
+
+palettetype *getdefaultpalette( )
+{
+    static palettetype default_palette = { 16,
+                       { BLACK, BLUE, GREEN, CYAN, RED, MAGENTA, BROWN, LIGHTGRAY,
+                         DARKGRAY, LIGHTBLUE, LIGHTGREEN, LIGHTCYAN, LIGHTRED,
+                         LIGHTMAGENTA, YELLOW, WHITE } };
+
+    return &default_palette;
+}
+
+
+void getpalette( palettetype *palette )
+{
+}
+
+
+int getpalettesize( )
+{
+    return MAXCOLORS + 1;
+}
+
+
+void setallpalette( palettetype *palette )
+{
+}
+
+
+void setpalette( int colornum, int color )
+{
+}
+
+
+void setrgbpalette( int colornum, int red, int green, int blue )
+{
+}
+
+#endif // BGI_HEADLESS
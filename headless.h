@@ -0,0 +1,102 @@
+// File: headless.h
+//
+// Internal structures and routines of the headless backend.  This plays the
+// part of winbgitypes.h when the library is built with BGI_HEADLESS: each
+// "window" is just a set of in-memory pages that the drawing functions
+// rasterize into with the routines in surface.h.
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <queue>                // Provides STL queue class
+#include <string>               // Provides STL string class
+#include <vector>               // Provides STL vector class
+#include "winbgi.h"             // Provides other structures
+#include "surface.h"            // Provides BGI__Surface
+#include "damage.h"             // Provides BGI__Damage
+#include "lock.h"               // Provides BGI__Lock
+
+// Define maximum pages used for drawing.
+#define MAX_PAGES 4
+typedef void (*Handler)(int, int);
+
+// The size of the pretend screen reported by getmaxwidth and getmaxheight.
+#ifndef BGI_HEADLESS_SCREEN_WIDTH
+#define BGI_HEADLESS_SCREEN_WIDTH 1920
+#endif
+#ifndef BGI_HEADLESS_SCREEN_HEIGHT
+#define BGI_HEADLESS_SCREEN_HEIGHT 1080
+#endif
+
+// ---------------------------------------------------------------------------
+//                              Structures
+// ---------------------------------------------------------------------------
+// Everything we know about one headless window.  The fields mirror the
+// WindowData of the Win32 backend; the device contexts are replaced by one
+// surface per page and the state GDI used to keep for us (current position,
+// write mode) is kept here.
+struct WindowData
+{
+    int width;                  // Width of the window
+    int height;                 // Height of the window
+    std::string title;          // Title given to initwindow
+    std::queue<char> kbd_queue; // Queue of keyboard characters
+    arccoordstype arcInfo;      // Information about the last arc drawn
+    fillsettingstype fillInfo;  // Information about the fill style
+    char uPattern[8];           // A user-defined fill style
+    linesettingstype lineInfo;  // Information about the line style
+    textsettingstype textInfo;  // Information about the text style
+    viewporttype viewportInfo;  // Information about the viewport
+    BGI__Surface page[MAX_PAGES]; // The pixels of each page
+    int VisualPage;             // The page that would be on the screen
+    int ActivePage;             // The page used for drawing
+    bool DoubleBuffer;          // Whether the user wants a double buffered window (DOUBLE_BUFFER in initwindow)
+    bool CloseBehavior;         // Unused: there is no window to close
+    int drawColor;              // The current drawing color (That the user gave us)
+    int bgColor;                // The current background color (That the user gave us)
+    int writeMode;              // COPY_PUT or XOR_PUT (setwritemode)
+    struct { int x, y; } cp;    // The current position, viewport relative
+    int error_code;             // Error code used by graphresult (usually grOk)
+    int x_aspect_ratio;         // Horizontal Aspect Ratio
+    int y_aspect_ratio;         // Vertical Aspect Ratio
+    int t_scale[4];             // scaling factor for fonts multx, divx, multy, divy
+    struct { int x, y; } mouse; // There is no mouse; always (0,0)
+    Handler mouse_handlers[WM_MOUSELAST - WM_MOUSEFIRST + 1]; // Registered, never called
+    bool refreshing;            // True if autorefershing should be done after each drawing event
+    BGI__Lock surfaceLock;      // Only one thread at a time may draw into the pages
+    BGI__Damage damage;         // Changed areas not yet presented (guarded by surfaceLock)
+};
+
+
+// ---------------------------------------------------------------------------
+//                              Prototypes
+// ---------------------------------------------------------------------------
+// Returns a pointer to the window data structure associated with hWnd.
+// If hWnd is NULL, the current window is used (headless.cxx)
+WindowData* BGI__GetWindowDataPtr( HWND hWnd = NULL );
+
+// Takes and releases the lock on the pages of a window (headless.cxx)
+void BGI__LockWindow( WindowData* pWndData );
+void BGI__UnlockWindow( WindowData* pWndData );
+
+// Locks the pages of the window given by hWnd (or the current window) and
+// returns the active one.  Every call must be paired with a call to
+// BGI__ReleaseWinbgiSurface, just as BGI__GetWinbgiDC is paired with
+// BGI__ReleaseWinbgiDC in the Win32 backend.
+BGI__Surface* BGI__GetWinbgiSurface( HWND hWnd = NULL );
+void BGI__ReleaseWinbgiSurface( HWND hWnd = NULL );
+
+// Marks an area (in device coordinates) of the current window as changed.
+// NULL means the whole window.
+void RefreshWindow( BGI__Rect* rect );
+
+// ---------------------------------------------------------------------------
+//                            Global Variables
+// ---------------------------------------------------------------------------
+extern std::vector<HWND> BGI__WindowTable;  // headless.cxx
+extern int BGI__WindowCount;         // Number of windows currently in use, headless.cxx
+extern int BGI__CurrentWindow;       // Index to current window, headless.cxx
+extern COLORREF BGI__Colors[16];     // The RGB values for the Borland 16 colors, headless.cxx
+
+
+#endif  // HEADLESS_H
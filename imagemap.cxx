@@ -0,0 +1,359 @@
+// File: imagemap.cxx
+//
+// Memory-mapped images: pictures too large for a window, or for memory, drawn
+// straight into a file.  The file is a PAM image (the P7 format of netpbm) of
+// RGBA pixels, which most image tools read.  Nothing of it is read into
+// memory: lockimagetile maps just the rows of one tile, and once they are
+// unlocked they are unmapped again, leaving the system to write the changed
+// pages back.  So the memory a render takes depends on how many tiles are
+// locked at once, not on the size of the image.
+//
+// A page of a wide image holds a short piece of one row, so the tiles along a
+// band of rows each touch the same pages.  Mapping every tile on its own would
+// fault each page in again for every tile (about ten times slower, measured on
+// a 30000 x 30000 image), so the last IMAGEMAP_IDLE mappings nobody uses are
+// kept, and a tile that lies within the rows of one of them uses it.
+//
+// The header is padded with a comment to IMAGEMAP_HEADER bytes, so that the
+// pixels start on a page boundary, and each row is padded to a multiple of
+// IMAGEMAP_ALIGN pixels (64 bytes), so that every row starts on a cache line
+// and no aligned vector store into it can straddle two pages.  The padding is
+// part of the picture: an image asked for 1000 pixels wide is 1008 wide in
+// the file, the extra columns transparent.
+//
+
+#include "winbgi.h"             // API routines
+#include <stdio.h>              // Provides snprintf
+#include <string.h>             // Provides memset
+#include <stdint.h>             // Provides uint64_t
+#include <mutex>                // Provides std::mutex
+#include <vector>               // Provides STL vector class
+#ifdef _WIN32
+#include <windows.h>            // Provides the Win32 API
+#else
+#include <fcntl.h>              // Provides open
+#include <sys/mman.h>           // Provides mmap and munmap
+#include <unistd.h>             // Provides pwrite, ftruncate and sysconf
+#endif
+
+
+/*****************************************************************************
+*
+*   Structures
+*
+*****************************************************************************/
+
+#define IMAGEMAP_MAX 16         // Images open at once
+#define IMAGEMAP_HEADER 4096    // Bytes before the first pixel
+#define IMAGEMAP_ALIGN 16       // Each row is a multiple of this many pixels
+#define IMAGEMAP_IDLE 4         // Unused mappings kept for reuse
+
+// A mapping of rows top to bottom of the file.
+struct MappedRows
+{
+    void* base;
+    size_t length;
+    uint64_t start;             // Offset in the file of base
+    int top, bottom;
+    int users;                  // Tiles locked in it
+    uint64_t lastUsed;
+};
+
+
+// One locked tile: the pixel handed out and the mapping it lies in.
+struct MappedTile
+{
+    unsigned int* pixels;
+    void* base;
+};
+
+
+struct ImageMap
+{
+    bool open;
+    int width, height;          // Of the file, so width is already padded
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int file;
+#endif
+    std::vector<MappedRows> mappings;
+    std::vector<MappedTile> tiles;
+    uint64_t clock;             // Counts locks and unlocks, for lastUsed
+};
+
+
+/*****************************************************************************
+*
+*   Global variables
+*
+*****************************************************************************/
+
+static std::mutex imagemap_mutex;
+static ImageMap imagemaps[IMAGEMAP_MAX];
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+// Returns the alignment the offset of a mapping must have.
+//
+static size_t Granularity( )
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    return info.dwAllocationGranularity;
+#else
+    return (size_t)sysconf( _SC_PAGESIZE );
+#endif
+}
+
+
+// Fills header (IMAGEMAP_HEADER bytes) with the PAM header of a width x
+// height image, padded with a comment line.
+//
+static void MakeHeader( char* header, int width, int height )
+{
+    int n = snprintf( header, IMAGEMAP_HEADER,
+                      "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n#",
+                      width, height );
+    const char end[] = "\nENDHDR\n";
+
+    memset( header + n, ' ', IMAGEMAP_HEADER - n );
+    memcpy( header + IMAGEMAP_HEADER - (sizeof(end) - 1), end, sizeof(end) - 1 );
+}
+
+
+static void Unmap( const MappedRows& r )
+{
+#ifdef _WIN32
+    UnmapViewOfFile( r.base );
+#else
+    munmap( r.base, r.length );
+#endif
+}
+
+
+// Unmaps the least recently used mappings nobody uses until only
+// IMAGEMAP_IDLE of those are left.
+//
+static void TrimIdle( ImageMap* m )
+{
+    for ( ;; )
+    {
+        int idle = 0;
+        size_t oldest = 0;
+
+        for ( size_t i = 0; i < m->mappings.size( ); i++ )
+        {
+            if ( m->mappings[i].users > 0 )
+                continue;
+            if ( idle++ == 0 || m->mappings[i].lastUsed < m->mappings[oldest].lastUsed )
+                oldest = i;
+        }
+        if ( idle <= IMAGEMAP_IDLE )
+            return;
+        Unmap( m->mappings[oldest] );
+        m->mappings[oldest] = m->mappings.back( );
+        m->mappings.pop_back( );
+    }
+}
+
+
+// Returns the image for a handle, or NULL if it is not open.  The caller
+// holds imagemap_mutex.
+//
+static ImageMap* Lookup( int image )
+{
+    if ( image < 0 || image >= IMAGEMAP_MAX || !imagemaps[image].open )
+        return NULL;
+    return &imagemaps[image];
+}
+
+
+/*****************************************************************************
+*
+*   The API
+*
+*****************************************************************************/
+
+int createimagemapbgi( const char* filename, int width, int height )
+{
+    std::lock_guard<std::mutex> guard( imagemap_mutex );
+    char header[IMAGEMAP_HEADER];
+    int image;
+
+    if ( width <= 0 || height <= 0 || width > INT_MAX - IMAGEMAP_ALIGN )
+        return -1;
+    for ( image = 0; image < IMAGEMAP_MAX && imagemaps[image].open; image++ )
+        ;
+    if ( image == IMAGEMAP_MAX )
+        return -1;
+
+    ImageMap& m = imagemaps[image];
+    uint64_t size;
+
+    m.width = ( width + IMAGEMAP_ALIGN - 1 ) / IMAGEMAP_ALIGN * IMAGEMAP_ALIGN;
+    m.height = height;
+    size = IMAGEMAP_HEADER + (uint64_t)m.width * height * 4;
+    MakeHeader( header, m.width, height );
+
+#ifdef _WIN32
+    DWORD written = 0;
+
+    m.file = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( m.file == INVALID_HANDLE_VALUE )
+        return -1;
+    // Creating the mapping makes the file its full size, filled with zeros
+    m.mapping = NULL;
+    if ( WriteFile( m.file, header, IMAGEMAP_HEADER, &written, NULL ) && written == IMAGEMAP_HEADER )
+        m.mapping = CreateFileMappingA( m.file, NULL, PAGE_READWRITE, (DWORD)( size >> 32 ),
+                                        (DWORD)size, NULL );
+    if ( m.mapping == NULL )
+    {
+        CloseHandle( m.file );
+        return -1;
+    }
+#else
+    m.file = open( filename, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if ( m.file < 0 )
+        return -1;
+    // The pixels are a hole in the file until they are written
+    if ( pwrite( m.file, header, IMAGEMAP_HEADER, 0 ) != IMAGEMAP_HEADER ||
+         ftruncate( m.file, (off_t)size ) != 0 )
+    {
+        close( m.file );
+        return -1;
+    }
+#endif
+    m.clock = 0;
+    m.open = true;
+    return image;
+}
+
+
+unsigned int* lockimagetile( int image, int left, int top, int right, int bottom, int* pitch )
+{
+    std::lock_guard<std::mutex> guard( imagemap_mutex );
+    ImageMap* m = Lookup( image );
+
+    if ( m == NULL || left < 0 || top < 0 || right >= m->width || bottom >= m->height ||
+         left > right || top > bottom )
+        return NULL;
+
+    MappedRows* r = NULL;
+    MappedTile t;
+
+    for ( size_t i = 0; i < m->mappings.size( ) && r == NULL; i++ )
+        if ( m->mappings[i].top <= top && bottom <= m->mappings[i].bottom )
+            r = &m->mappings[i];
+
+    if ( r == NULL )
+    {
+        // Only whole rows can be mapped, and the mapping has to start on a
+        // multiple of the granularity
+        size_t granularity = Granularity( );
+        uint64_t first = IMAGEMAP_HEADER + (uint64_t)top * m->width * 4;
+        MappedRows rows;
+
+        rows.start = first / granularity * granularity;
+        rows.length = (size_t)( first - rows.start + (uint64_t)( bottom - top + 1 ) * m->width * 4 );
+#ifdef _WIN32
+        rows.base = MapViewOfFile( m->mapping, FILE_MAP_WRITE, (DWORD)( rows.start >> 32 ),
+                                   (DWORD)rows.start, rows.length );
+        if ( rows.base == NULL )
+            return NULL;
+#else
+        rows.base = mmap( NULL, rows.length, PROT_READ | PROT_WRITE, MAP_SHARED, m->file, (off_t)rows.start );
+        if ( rows.base == MAP_FAILED )
+            return NULL;
+#endif
+        rows.top = top;
+        rows.bottom = bottom;
+        rows.users = 0;
+        m->mappings.push_back( rows );
+        r = &m->mappings.back( );
+    }
+
+    r->users++;
+    r->lastUsed = ++m->clock;
+    t.base = r->base;
+    t.pixels = (unsigned int*)( (char*)r->base + ( IMAGEMAP_HEADER + (uint64_t)top * m->width * 4 - r->start ) ) + left;
+    m->tiles.push_back( t );
+    *pitch = m->width;
+    return t.pixels;
+}
+
+
+void unlockimagetile( int image, unsigned int* tile )
+{
+    std::lock_guard<std::mutex> guard( imagemap_mutex );
+    ImageMap* m = Lookup( image );
+
+    if ( m == NULL )
+        return;
+    for ( size_t i = 0; i < m->tiles.size( ); i++ )
+    {
+        if ( m->tiles[i].pixels == tile )
+        {
+            for ( size_t j = 0; j < m->mappings.size( ); j++ )
+            {
+                if ( m->mappings[j].base == m->tiles[i].base )
+                {
+                    m->mappings[j].users--;
+                    m->mappings[j].lastUsed = ++m->clock;
+                }
+            }
+            m->tiles[i] = m->tiles.back( );
+            m->tiles.pop_back( );
+            TrimIdle( m );
+            return;
+        }
+    }
+}
+
+
+unsigned int imagemappixel( int color )
+{
+    // The same colors as graphdefaults in winbgi.cxx.  An image needs no
+    // window, so it cannot use the palette of one.
+    static const COLORREF defaults[16] =
+    {
+        RGB( 0, 0, 0 ), RGB( 0, 0, 128 ), RGB( 0, 128, 0 ), RGB( 0, 128, 128 ),
+        RGB( 128, 0, 0 ), RGB( 128, 0, 128 ), RGB( 128, 128, 0 ), RGB( 192, 192, 192 ),
+        RGB( 128, 128, 128 ), RGB( 128, 128, 255 ), RGB( 128, 255, 128 ), RGB( 128, 255, 255 ),
+        RGB( 255, 128, 128 ), RGB( 255, 128, 255 ), RGB( 255, 255, 0 ), RGB( 255, 255, 255 )
+    };
+    COLORREF rgb = IS_BGI_COLOR( color ) ? defaults[color] : ( color & 0x0FFFFFF );
+
+    // A COLORREF is 0x00BBGGRR, so in memory R, G, B: add an opaque alpha
+    return rgb | 0xFF000000u;
+}
+
+
+bool closeimagemapbgi( int image )
+{
+    std::lock_guard<std::mutex> guard( imagemap_mutex );
+    ImageMap* m = Lookup( image );
+    bool ok;
+
+    if ( m == NULL )
+        return false;
+    for ( size_t i = 0; i < m->mappings.size( ); i++ )
+        Unmap( m->mappings[i] );
+    m->mappings.clear( );
+    m->tiles.clear( );
+#ifdef _WIN32
+    ok = CloseHandle( m->mapping ) != 0;
+    ok = CloseHandle( m->file ) != 0 && ok;
+#else
+    ok = close( m->file ) == 0;
+#endif
+    m->open = false;
+    return ok;
+}
@@ -0,0 +1,119 @@
+// File: lock.cxx
+//
+// The spin-then-park window lock.  See lock.h.
+//
+
+#include <chrono>           // Provides std::chrono::steady_clock
+#include "lock.h"           // Our own declarations
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+// One attempt at taking a free lock.
+//
+static inline bool TryTake( BGI__Lock* l )
+{
+    return !l->locked.load( std::memory_order_relaxed ) &&
+           !l->locked.exchange( true, std::memory_order_acquire );
+}
+
+
+// Makes the calling thread the owner of a lock it has just taken.
+//
+static inline void BecomeOwner( BGI__Lock* l )
+{
+    l->owner.store( std::this_thread::get_id( ), std::memory_order_relaxed );
+    l->depth = 1;
+    l->acquisitions++;
+}
+
+
+/*****************************************************************************
+*
+*   The lock
+*
+*****************************************************************************/
+
+bool BGI__LockAcquire( BGI__Lock* l, int timeout )
+{
+    std::thread::id me = std::this_thread::get_id( );
+
+    // The owner may take it again.  Nobody else can set owner to our id, so
+    // this test is safe without holding anything.
+    if ( l->owner.load( std::memory_order_relaxed ) == me )
+    {
+        l->depth++;
+        return true;
+    }
+
+    // The usual case: nobody has it.
+    if ( TryTake( l ) )
+    {
+        BecomeOwner( l );
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds( timeout );
+    bool taken = false;
+
+    // Spin for a while, since most drawing calls let go quickly
+    for ( int i = 0; i < BGI__LOCK_SPINS && !taken; i++ )
+    {
+        if ( i % 16 == 15 )
+            std::this_thread::yield( );
+        taken = TryTake( l );
+    }
+
+    // Then sleep until the owner lets go.  The owner clears locked before it
+    // looks at parked and we count ourselves in parked before we try again
+    // (all sequentially consistent), so either we see the lock free or it
+    // sees us and wakes us.  It takes park_mutex before waking anybody, so
+    // the wake cannot slip in between our last try and the wait.
+    if ( !taken )
+    {
+        std::unique_lock<std::mutex> guard( l->park_mutex );
+        l->parked++;
+        while ( !( taken = !l->locked.exchange( true ) ) )
+        {
+            if ( l->park.wait_until( guard, deadline ) == std::cv_status::timeout &&
+                 !( taken = !l->locked.exchange( true ) ) )
+                break;
+        }
+        l->parked--;
+    }
+
+    if ( !taken )
+    {
+        l->timeouts++;
+        return false;
+    }
+
+    long long waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now( ) - start ).count( );
+    BecomeOwner( l );
+    l->contended++;
+    l->wait_ns += waited;
+    if ( waited > l->max_wait_ns )
+        l->max_wait_ns = waited;
+    return true;
+}
+
+
+void BGI__LockRelease( BGI__Lock* l )
+{
+    if ( --l->depth > 0 )
+        return;
+
+    l->owner.store( std::thread::id( ), std::memory_order_relaxed );
+    l->locked.store( false );
+    if ( l->parked.load( ) > 0 )
+    {
+        { std::lock_guard<std::mutex> guard( l->park_mutex ); }
+        l->park.notify_one( );
+    }
+}
@@ -0,0 +1,63 @@
+// File: lock.h
+//
+// The lock that guards a window's pages.  Every drawing call takes it, so it
+// has to be cheap when nobody else holds it: taking a free lock is a single
+// atomic exchange with no system call.  A thread that finds the lock taken
+// spins for a short while (most drawing calls are short) and then parks until
+// the owner lets go.  Like the Win32 mutex it replaces, the owner may take it
+// again (for example lockbuffer followed by putpixel).
+//
+// The lock also counts how it is used, so that contention between drawing
+// threads can be measured (getlockstatsbgi).
+
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <atomic>               // Provides std::atomic
+#include <condition_variable>   // Provides std::condition_variable
+#include <mutex>                // Provides std::mutex
+#include <thread>               // Provides std::thread::id
+
+// How many times a waiting thread tries again before it parks.
+#define BGI__LOCK_SPINS 200
+
+// How long (ms) a drawing call waits before the wait is reported.
+#define BGI__LOCK_TIMEOUT 5000
+
+// ---------------------------------------------------------------------------
+//                              Structures
+// ---------------------------------------------------------------------------
+struct BGI__Lock
+{
+    std::atomic<bool> locked;   // True while some thread owns the lock
+    std::atomic<std::thread::id> owner; // The owning thread
+    int depth;                  // How many times the owner has taken it
+    std::atomic<int> parked;    // Threads asleep waiting for the lock
+    std::mutex park_mutex;      // Guards the sleep of the parked threads
+    std::condition_variable park;
+
+    // Counters (getlockstatsbgi).  All but timeouts are only changed by the
+    // owner.
+    unsigned long acquisitions; // Times the lock was taken (not counting recursion)
+    unsigned long contended;    // Times it had to be waited for
+    std::atomic<unsigned long> timeouts; // Waits that ran past the timeout
+    long long wait_ns;          // Total time spent waiting
+    long long max_wait_ns;      // Longest single wait
+
+    BGI__Lock( ) : locked( false ), owner( std::thread::id( ) ), depth( 0 ), parked( 0 ),
+                   acquisitions( 0 ), contended( 0 ), timeouts( 0 ), wait_ns( 0 ), max_wait_ns( 0 )
+    { }
+};
+
+
+// ---------------------------------------------------------------------------
+//                              Prototypes
+// ---------------------------------------------------------------------------
+// Takes the lock, waiting at most timeout ms.  Returns false (and counts a
+// timeout) if the lock could not be taken in time.
+bool BGI__LockAcquire( BGI__Lock* l, int timeout );
+
+// Lets go of the lock once.  Only the owner may call it.
+void BGI__LockRelease( BGI__Lock* l );
+
+#endif // LOCK_H
@@ -144,7 +144,7 @@ void CreateNewPen( )
 
     // Round endcaps are default, set to square
     // Use a bevel join
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
     {
         hPen = ExtCreatePen( PS_GEOMETRIC | PS_ENDCAP_SQUARE 
@@ -155,7 +155,7 @@ void CreateNewPen( )
                              style.pattern );                   // Line Pattern
         DeletePen( (HPEN)SelectObject( pWndData->hDC[i], hPen ) );
     }
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 
@@ -504,10 +504,10 @@ void setbkcolor( int color )
     // Convert from BGI color to RGB color
     color = converttorgb( color );
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
         SetBkColor( pWndData->hDC[i], color );
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 
@@ -522,10 +522,10 @@ void setcolor( int color )
     color = converttorgb( color );
 
     // Use that to set the text color for each page
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
         SetTextColor( pWndData->hDC[i], color );
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 
     // Create the new drawing pen
     CreateNewPen( );
@@ -568,14 +568,14 @@ void setfillpattern( char *upattern, int color )
     // Create the bitmap
     hBitmap = CreateBitmap( 8, 8, 1, 1, pattern );
     // Create a brush for each DC
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
     {
         hBrush = CreatePatternBrush( hBitmap );
         // Select the new brush into the device context and delete the old one.
         DeleteBrush( (HBRUSH)SelectBrush( pWndData->hDC[i], hBrush ) );
     }
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     // I'm not sure if it's safe to delete the bitmap here or not, but it
     // hasn't caused any problems.  The material I've found just says the
     // bitmap must be deleted in addition to the brush when finished.
@@ -690,7 +690,7 @@ void setviewport( int left, int top, int right, int bottom, int clip )
     if ( clip != 0 )
         hRGN = CreateRectRgn( left, top, right, bottom );
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
     {
         SelectClipRgn( pWndData->hDC[i], hRGN );
@@ -701,7 +701,7 @@ void setviewport( int left, int top, int right, int bottom, int clip )
         // Move to the new origin
         MoveToEx( pWndData->hDC[i], 0, 0, NULL );
     }
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     // A copy of the region is used for the clipping region, so it is
     // safe to delete the region  (p. 369 Win32 API book)
     DeleteRgn( hRGN );
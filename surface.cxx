@@ -0,0 +1,545 @@
+// File: surface.cxx
+//
+// Software rasterizers for BGI__Surface.  See surface.h for the conventions
+// (pixel format, clipping, pens and brushes).
+//
+
+#define _USE_MATH_DEFINES   // Actually use the definitions in math.h
+#include <math.h>           // For sqrt, atan2 and floor
+#include <stdlib.h>         // Provides malloc and free
+#include <string.h>         // Provides memcpy
+#include <algorithm>        // Provides std::sort
+#include <vector>           // Scratch space for polygon and flood fills
+#include "graphics.h"       // For the line widths and putimage ops
+#include "surface.h"        // Our own declarations
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/*****************************************************************************
+*
+*   Helper functions
+*
+*****************************************************************************/
+
+// Writes one pixel of a line or arc, applying the write mode.  The caller has
+// already checked it against the clipping rectangle.
+//
+static inline void PenPixel( BGI__Surface* s, int x, int y, const BGI__Pen* pen )
+{
+    uint32_t* p = BGI__SurfaceRow( s, y ) + x;
+
+    if ( pen->writemode == XOR_PUT )
+        *p ^= pen->color;
+    else
+        *p = pen->color;
+}
+
+
+// Plots the pixel at (x,y) of a line or arc, widened to three pixels along
+// the minor axis for THICK_WIDTH.  xmajor tells which way the minor axis runs.
+//
+static inline void PenPlot( BGI__Surface* s, const BGI__Rect* clip,
+                            int x, int y, bool xmajor, const BGI__Pen* pen )
+{
+    int first = 0, last = 0;
+    int i;
+
+    if ( pen->thickness > NORM_WIDTH )
+    {
+        first = -(pen->thickness / 2);
+        last = pen->thickness / 2;
+    }
+
+    for ( i = first; i <= last; i++ )
+    {
+        int px = xmajor ? x : x + i;
+        int py = xmajor ? y + i : y;
+
+        if ( px >= clip->left && px < clip->right && py >= clip->top && py < clip->bottom )
+            PenPixel( s, px, py, pen );
+    }
+}
+
+
+// Returns the brush pixel for device position (x,y).  The pattern is
+// anchored to the surface origin so adjacent fills line up.
+//
+static inline uint32_t BrushPixel( const BGI__Brush* brush, int x, int y )
+{
+    return ( brush->pattern[y & 7] & (0x80 >> (x & 7)) ) ? brush->color : brush->bkcolor;
+}
+
+
+// Returns true if every row of the brush is solid, so a span can be filled
+// with a single value.
+//
+static inline bool BrushIsSolid( const BGI__Brush* brush )
+{
+    for ( int i = 0; i < 8; i++ )
+        if ( brush->pattern[i] != 0xFF )
+            return false;
+    return true;
+}
+
+
+// Fills the pixels left..right (inclusive) of row y with the brush, clipped
+// to clip.
+//
+static void BrushSpan( BGI__Surface* s, const BGI__Rect* clip,
+                       int y, int left, int right, const BGI__Brush* brush, bool solid )
+{
+    uint32_t* row;
+    int x;
+
+    if ( y < clip->top || y >= clip->bottom )
+        return;
+    if ( left < clip->left ) left = clip->left;
+    if ( right >= clip->right ) right = clip->right - 1;
+    if ( left > right )
+        return;
+
+    row = BGI__SurfaceRow( s, y );
+    if ( solid )
+    {
+        for ( x = left; x <= right; x++ )
+            row[x] = brush->color;
+    }
+    else
+    {
+        for ( x = left; x <= right; x++ )
+            row[x] = BrushPixel( brush, x, y );
+    }
+}
+
+
+// Normalizes a pair of BGI angles (degrees, counterclockwise from the
+// positive x axis) so that 0 <= *st < 360 and *st <= *end < *st + 360.
+// Returns true if the pair describes a full turn.
+//
+static bool NormalizeAngles( int* st, int* end )
+{
+    if ( *end - *st >= 360 || *st - *end >= 360 )
+        return true;
+
+    *st %= 360;
+    if ( *st < 0 ) *st += 360;
+    *end %= 360;
+    if ( *end < 0 ) *end += 360;
+    if ( *end <= *st ) *end += 360;
+    return false;
+}
+
+
+// Tells whether the point (dx,dy), relative to the center of an ellipse with
+// the given radii, lies between the angles st and end (normalized as above).
+// The angle used is the parametric one, which is how ArcEndPoints in
+// drawing.cxx places the end points of an elliptical arc.
+//
+static bool InAngleRange( int dx, int dy, int xradius, int yradius, int st, int end )
+{
+    double angle = atan2( -dy / (double) yradius, dx / (double) xradius ) * 180.0 / M_PI;
+
+    if ( angle < 0 ) angle += 360.0;
+    if ( angle < st ) angle += 360.0;
+    return angle <= end;
+}
+
+
+/*****************************************************************************
+*
+*   Surface management
+*
+*****************************************************************************/
+
+bool BGI__SurfaceCreate( BGI__Surface* s, int width, int height )
+{
+    s->pixels = NULL;
+    s->width = s->height = s->pitch = 0;
+    if ( width <= 0 || height <= 0 )
+        return false;
+
+    s->pixels = (uint32_t*) calloc( (size_t) width * height, sizeof(uint32_t) );
+    if ( s->pixels == NULL )
+        return false;
+
+    s->width = width;
+    s->height = height;
+    s->pitch = width;
+    return true;
+}
+
+
+void BGI__SurfaceDestroy( BGI__Surface* s )
+{
+    free( s->pixels );
+    s->pixels = NULL;
+    s->width = s->height = s->pitch = 0;
+}
+
+
+bool BGI__SurfaceClipRect( const BGI__Surface* s, BGI__Rect* r )
+{
+    if ( r->left < 0 ) r->left = 0;
+    if ( r->top < 0 ) r->top = 0;
+    if ( r->right > s->width ) r->right = s->width;
+    if ( r->bottom > s->height ) r->bottom = s->height;
+    return r->left < r->right && r->top < r->bottom;
+}
+
+
+void BGI__SurfaceFill( BGI__Surface* s, const BGI__Rect* rect, uint32_t color )
+{
+    for ( int y = rect->top; y < rect->bottom; y++ )
+    {
+        uint32_t* row = BGI__SurfaceRow( s, y );
+        for ( int x = rect->left; x < rect->right; x++ )
+            row[x] = color;
+    }
+}
+
+
+/*****************************************************************************
+*
+*   Outlines
+*
+*****************************************************************************/
+
+// Bresenham's line from (x1,y1) to (x2,y2), both end points included.  The
+// line style pattern advances by one bit per pixel along the major axis.
+//
+void BGI__SurfaceLine( BGI__Surface* s, const BGI__Rect* clip,
+                       int x1, int y1, int x2, int y2, const BGI__Pen* pen )
+{
+    int dx = abs( x2 - x1 ), sx = x1 < x2 ? 1 : -1;
+    int dy = -abs( y2 - y1 ), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    bool xmajor = dx >= -dy;
+    unsigned pattern = pen->pattern & 0xFFFF;
+    int step = 0;
+
+    // Skip the walk entirely when the line cannot touch the clipping
+    // rectangle (allowing one pixel for THICK_WIDTH).
+    if ( ( x1 < clip->left - 1 && x2 < clip->left - 1 ) ||
+         ( y1 < clip->top - 1 && y2 < clip->top - 1 ) ||
+         ( x1 > clip->right && x2 > clip->right ) ||
+         ( y1 > clip->bottom && y2 > clip->bottom ) )
+        return;
+
+    while ( true )
+    {
+        if ( pattern == 0xFFFF || ( pattern & (1 << (step & 15)) ) )
+            PenPlot( s, clip, x1, y1, xmajor, pen );
+        if ( x1 == x2 && y1 == y2 )
+            break;
+
+        int e2 = 2 * err;
+        if ( e2 >= dy ) { err += dy; x1 += sx; }
+        if ( e2 <= dx ) { err += dx; y1 += sy; }
+        step++;
+    }
+}
+
+
+// The midpoint ellipse algorithm, with each plotted point tested against the
+// angle range when only part of the ellipse is wanted.
+//
+void BGI__SurfaceArc( BGI__Surface* s, const BGI__Rect* clip,
+                      int x, int y, int xradius, int yradius,
+                      int stangle, int endangle, const BGI__Pen* pen )
+{
+    bool full = NormalizeAngles( &stangle, &endangle );
+    long long a2, b2, px, py, d;
+    int ex, ey;
+
+    xradius = abs( xradius );
+    yradius = abs( yradius );
+    if ( xradius == 0 || yradius == 0 )
+    {
+        BGI__SurfaceLine( s, clip, x - xradius, y - yradius, x + xradius, y + yradius, pen );
+        return;
+    }
+
+    a2 = (long long) xradius * xradius;
+    b2 = (long long) yradius * yradius;
+
+    // Plots the four symmetric points of (ex,ey), skipping duplicates on the
+    // axes so XOR_PUT does not cancel them out.
+    auto plot4 = [&]( int ex, int ey, bool xmajor )
+    {
+        int dxs[4] = { ex, -ex, ex, -ex };
+        int dys[4] = { ey, ey, -ey, -ey };
+        for ( int i = 0; i < 4; i++ )
+        {
+            if ( ( i & 1 ) && ex == 0 ) continue;
+            if ( ( i & 2 ) && ey == 0 ) continue;
+            if ( full || InAngleRange( dxs[i], dys[i], xradius, yradius, stangle, endangle ) )
+                PenPlot( s, clip, x + dxs[i], y + dys[i], xmajor, pen );
+        }
+    };
+
+    // Region 1: the slope is shallower than -1, step in x.
+    ex = 0;
+    ey = yradius;
+    px = 0;
+    py = 2 * a2 * ey;
+    d = b2 - a2 * yradius + a2 / 4;
+    while ( px < py )
+    {
+        plot4( ex, ey, true );
+        ex++;
+        px += 2 * b2;
+        if ( d < 0 )
+            d += b2 + px;
+        else
+        {
+            ey--;
+            py -= 2 * a2;
+            d += b2 + px - py;
+        }
+    }
+
+    // Region 2: the slope is steeper than -1, step in y.
+    d = (long long)( b2 * (ex + 0.5) * (ex + 0.5) + a2 * (double)(ey - 1) * (ey - 1) - a2 * b2 );
+    while ( ey >= 0 )
+    {
+        plot4( ex, ey, false );
+        ey--;
+        py -= 2 * a2;
+        if ( d > 0 )
+            d += a2 - py;
+        else
+        {
+            ex++;
+            px += 2 * b2;
+            d += a2 - py + px;
+        }
+    }
+}
+
+
+/*****************************************************************************
+*
+*   Filled areas
+*
+*****************************************************************************/
+
+void BGI__SurfaceFillRect( BGI__Surface* s, const BGI__Rect* clip,
+                           const BGI__Rect* rect, const BGI__Brush* brush )
+{
+    bool solid = BrushIsSolid( brush );
+    int left = rect->left < rect->right ? rect->left : rect->right;
+    int right = rect->left < rect->right ? rect->right : rect->left;
+    int top = rect->top < rect->bottom ? rect->top : rect->bottom;
+    int bottom = rect->top < rect->bottom ? rect->bottom : rect->top;
+
+    for ( int y = top; y < bottom; y++ )
+        BrushSpan( s, clip, y, left, right - 1, brush, solid );
+}
+
+
+// Each row of the ellipse is one span; a pie slice keeps only the pixels of
+// the span that fall inside the angle range.
+//
+void BGI__SurfaceFillPie( BGI__Surface* s, const BGI__Rect* clip,
+                          int x, int y, int xradius, int yradius,
+                          int stangle, int endangle, const BGI__Brush* brush )
+{
+    bool full = NormalizeAngles( &stangle, &endangle );
+    bool solid = BrushIsSolid( brush );
+    int dy, dx, half;
+
+    xradius = abs( xradius );
+    yradius = abs( yradius );
+    if ( xradius == 0 || yradius == 0 )
+        return;
+
+    for ( dy = -yradius; dy <= yradius; dy++ )
+    {
+        if ( y + dy < clip->top || y + dy >= clip->bottom )
+            continue;
+
+        half = (int) floor( xradius * sqrt( 1.0 - (double) dy * dy / ((double) yradius * yradius) ) + 0.5 );
+        if ( full )
+        {
+            BrushSpan( s, clip, y + dy, x - half, x + half, brush, solid );
+            continue;
+        }
+
+        for ( dx = -half; dx <= half; dx++ )
+        {
+            if ( ( dx != 0 || dy != 0 ) && !InAngleRange( dx, dy, xradius, yradius, stangle, endangle ) )
+                continue;
+            BrushSpan( s, clip, y + dy, x + dx, x + dx, brush, solid );
+        }
+    }
+}
+
+
+// Scanline polygon fill.  Each row is sampled through the pixel centers and
+// the crossings are paired up (even-odd rule), so the right and bottom edges
+// are left out just as with GDI's Polygon.
+//
+void BGI__SurfaceFillPolygon( BGI__Surface* s, const BGI__Rect* clip,
+                              int n_points, const int* points, const BGI__Brush* brush )
+{
+    std::vector<double> xs;
+    bool solid = BrushIsSolid( brush );
+    int ymin, ymax, i, j, y;
+
+    if ( n_points < 3 )
+        return;
+
+    ymin = ymax = points[1];
+    for ( i = 1; i < n_points; i++ )
+    {
+        if ( points[2*i + 1] < ymin ) ymin = points[2*i + 1];
+        if ( points[2*i + 1] > ymax ) ymax = points[2*i + 1];
+    }
+    if ( ymin < clip->top ) ymin = clip->top;
+    if ( ymax > clip->bottom ) ymax = clip->bottom;
+
+    for ( y = ymin; y < ymax; y++ )
+    {
+        double cy = y + 0.5;
+
+        xs.clear( );
+        for ( i = 0, j = n_points - 1; i < n_points; j = i++ )
+        {
+            double x0 = points[2*j], y0 = points[2*j + 1];
+            double x1 = points[2*i], y1 = points[2*i + 1];
+
+            if ( ( y0 <= cy && y1 > cy ) || ( y1 <= cy && y0 > cy ) )
+                xs.push_back( x0 + (cy - y0) * (x1 - x0) / (y1 - y0) );
+        }
+        std::sort( xs.begin( ), xs.end( ) );
+
+        for ( i = 0; i + 1 < (int) xs.size( ); i += 2 )
+        {
+            int left = (int) ceil( xs[i] - 0.5 );
+            int right = (int) ceil( xs[i + 1] - 0.5 ) - 1;
+            BrushSpan( s, clip, y, left, right, brush, solid );
+        }
+    }
+}
+
+
+// Fills the area around (x,y) bounded by pixels of the border color.  A
+// separate mask records which pixels have been filled, since a patterned
+// brush can leave pixels that still look unfilled.
+//
+void BGI__SurfaceFloodFill( BGI__Surface* s, const BGI__Rect* clip,
+                            int x, int y, uint32_t border, const BGI__Brush* brush,
+                            BGI__Rect* bounds )
+{
+    int w = clip->right - clip->left;
+    int h = clip->bottom - clip->top;
+    std::vector<unsigned char> done;
+    std::vector<int> seeds;
+    BGI__Rect filled = { x, y, x, y };
+
+    if ( bounds != NULL )
+        *bounds = filled;
+    if ( x < clip->left || x >= clip->right || y < clip->top || y >= clip->bottom )
+        return;
+    if ( BGI__SurfaceRow( s, y )[x] == border )
+        return;
+
+    done.assign( (size_t) w * h, 0 );
+    seeds.push_back( x );
+    seeds.push_back( y );
+
+    while ( !seeds.empty( ) )
+    {
+        int sy = seeds.back( ); seeds.pop_back( );
+        int sx = seeds.back( ); seeds.pop_back( );
+        uint32_t* row = BGI__SurfaceRow( s, sy );
+        unsigned char* mask = done.data( ) + (size_t)(sy - clip->top) * w - clip->left;
+        int left, right, i;
+
+        if ( mask[sx] || row[sx] == border )
+            continue;
+
+        // Grow the seed into the longest run on this row
+        for ( left = sx; left > clip->left && !mask[left - 1] && row[left - 1] != border; left-- )
+            ;
+        for ( right = sx; right < clip->right - 1 && !mask[right + 1] && row[right + 1] != border; right++ )
+            ;
+        for ( i = left; i <= right; i++ )
+        {
+            mask[i] = 1;
+            row[i] = BrushPixel( brush, i, sy );
+        }
+        if ( left < filled.left ) filled.left = left;
+        if ( right + 1 > filled.right ) filled.right = right + 1;
+        if ( sy < filled.top ) filled.top = sy;
+        if ( sy + 1 > filled.bottom ) filled.bottom = sy + 1;
+
+        // Queue one seed for each run in the rows above and below
+        for ( int ny = sy - 1; ny <= sy + 1; ny += 2 )
+        {
+            if ( ny < clip->top || ny >= clip->bottom )
+                continue;
+            uint32_t* nrow = BGI__SurfaceRow( s, ny );
+            unsigned char* nmask = done.data( ) + (size_t)(ny - clip->top) * w - clip->left;
+            bool inside = false;
+            for ( i = left; i <= right; i++ )
+            {
+                bool open = !nmask[i] && nrow[i] != border;
+                if ( open && !inside )
+                {
+                    seeds.push_back( i );
+                    seeds.push_back( ny );
+                }
+                inside = open;
+            }
+        }
+    }
+    if ( bounds != NULL )
+        *bounds = filled;
+}
+
+
+/*****************************************************************************
+*
+*   Images
+*
+*****************************************************************************/
+
+void BGI__SurfaceBlit( BGI__Surface* s, const BGI__Rect* clip, int x, int y,
+                       const uint32_t* src, int width, int height, int srcpitch, int op )
+{
+    int left = x < clip->left ? clip->left : x;
+    int top = y < clip->top ? clip->top : y;
+    int right = x + width > clip->right ? clip->right : x + width;
+    int bottom = y + height > clip->bottom ? clip->bottom : y + height;
+    int i, j;
+
+    for ( j = top; j < bottom; j++ )
+    {
+        uint32_t* d = BGI__SurfaceRow( s, j );
+        const uint32_t* r = src + (long)(j - y) * srcpitch - x;
+
+        switch ( op )
+        {
+        case COPY_PUT:
+            if ( right > left )
+                memcpy( d + left, r + left, (right - left) * sizeof(uint32_t) );
+            break;
+        case XOR_PUT:
+            for ( i = left; i < right; i++ ) d[i] ^= r[i];
+            break;
+        case OR_PUT:
+            for ( i = left; i < right; i++ ) d[i] |= r[i];
+            break;
+        case AND_PUT:
+            for ( i = left; i < right; i++ ) d[i] &= r[i];
+            break;
+        case NOT_PUT:
+            for ( i = left; i < right; i++ ) d[i] = ~r[i] & 0x00FFFFFF;
+            break;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+// File: surface.h
+//
+// A plain block of 32-bit pixels in memory and the software rasterizers that
+// draw into it.  Nothing in here knows about windows, viewports or the
+// current drawing state; the caller converts to device coordinates, picks a
+// clipping rectangle and passes the pen or brush to use.  This is what the
+// headless backend (headless.cxx) draws with, and it has no dependency on the
+// Win32 API so it builds anywhere.
+
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stdint.h>             // Provides uint32_t
+
+// ---------------------------------------------------------------------------
+//                              Structures
+// ---------------------------------------------------------------------------
+// A drawing surface.  Pixels are stored as 0x00RRGGBB, which is the memory
+// layout of a 32-bit top-down DIB section, so a surface row can be handed to
+// GDI (or written to a .bmp) without conversion.
+struct BGI__Surface
+{
+    uint32_t* pixels;           // The top-left pixel
+    int width;                  // Width in pixels
+    int height;                 // Height in pixels
+    int pitch;                  // Distance from one row to the next, in pixels
+};
+
+// A rectangle in device coordinates.  Like a Win32 RECT, right and bottom
+// are one past the last pixel included.
+struct BGI__Rect
+{
+    int left, top, right, bottom;
+};
+
+// Everything the line and arc rasterizers need to know about the current
+// line settings.
+struct BGI__Pen
+{
+    uint32_t color;             // Pixel value to draw with
+    unsigned pattern;           // 16-bit line style; bit 0 is the first pixel
+    int thickness;              // NORM_WIDTH or THICK_WIDTH
+    int writemode;              // COPY_PUT or XOR_PUT
+};
+
+// Everything the area fills need to know about the current fill settings.
+// A set bit in the pattern is drawn in color, a clear bit in bkcolor.  The
+// most significant bit of each byte is the leftmost pixel, as in Borland's
+// fill patterns.
+struct BGI__Brush
+{
+    uint32_t color;             // Pixel value for set pattern bits
+    uint32_t bkcolor;           // Pixel value for clear pattern bits
+    unsigned char pattern[8];   // The 8x8 fill pattern
+};
+
+
+// ---------------------------------------------------------------------------
+//                              Prototypes
+// ---------------------------------------------------------------------------
+// Allocates the pixels of a width x height surface and clears them to black.
+// Returns false (leaving the surface empty) if the memory is not available.
+bool BGI__SurfaceCreate( BGI__Surface* s, int width, int height );
+void BGI__SurfaceDestroy( BGI__Surface* s );
+
+// Intersects r with the bounds of the surface.  Returns false if nothing is
+// left.
+bool BGI__SurfaceClipRect( const BGI__Surface* s, BGI__Rect* r );
+
+// Sets every pixel of rect (already clipped) to color.
+void BGI__SurfaceFill( BGI__Surface* s, const BGI__Rect* rect, uint32_t color );
+
+// Outlines.  Each one draws only inside clip, which must lie within the
+// surface.
+void BGI__SurfaceLine( BGI__Surface* s, const BGI__Rect* clip,
+                       int x1, int y1, int x2, int y2, const BGI__Pen* pen );
+void BGI__SurfaceArc( BGI__Surface* s, const BGI__Rect* clip,
+                      int x, int y, int xradius, int yradius,
+                      int stangle, int endangle, const BGI__Pen* pen );
+
+// Filled areas, drawn with the pattern of the brush.  BGI__SurfaceFillPie
+// fills the whole ellipse when the angles span a full turn.  The polygon is
+// given as n (x,y) pairs and is filled with the even-odd rule, as GDI does.
+void BGI__SurfaceFillRect( BGI__Surface* s, const BGI__Rect* clip,
+                           const BGI__Rect* rect, const BGI__Brush* brush );
+void BGI__SurfaceFillPie( BGI__Surface* s, const BGI__Rect* clip,
+                          int x, int y, int xradius, int yradius,
+                          int stangle, int endangle, const BGI__Brush* brush );
+void BGI__SurfaceFillPolygon( BGI__Surface* s, const BGI__Rect* clip,
+                              int n_points, const int* points, const BGI__Brush* brush );
+// The flood fill also reports the rectangle it filled in bounds (unless
+// bounds is NULL); the rectangle is empty if nothing was filled.
+void BGI__SurfaceFloodFill( BGI__Surface* s, const BGI__Rect* clip,
+                            int x, int y, uint32_t border, const BGI__Brush* brush,
+                            BGI__Rect* bounds );
+
+// Copies a width x height block of pixels to (x,y), combining it with what is
+// already there according to op (one of the putimage_ops).
+void BGI__SurfaceBlit( BGI__Surface* s, const BGI__Rect* clip, int x, int y,
+                       const uint32_t* src, int width, int height, int srcpitch, int op );
+
+
+// ---------------------------------------------------------------------------
+//                          Inline helpers
+// ---------------------------------------------------------------------------
+// Converts a Win32 COLORREF (0x00BBGGRR) to a surface pixel (0x00RRGGBB) and
+// back again.  The conversion is its own inverse.
+inline uint32_t BGI__ColorrefToPixel( uint32_t c )
+{
+    return ((c & 0xFF) << 16) | (c & 0xFF00) | ((c >> 16) & 0xFF);
+}
+
+inline uint32_t BGI__PixelToColorref( uint32_t p )
+{
+    return BGI__ColorrefToPixel( p );
+}
+
+inline uint32_t* BGI__SurfaceRow( const BGI__Surface* s, int y )
+{
+    return s->pixels + (long)y * s->pitch;
+}
+
+#endif // SURFACE_H
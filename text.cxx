@@ -219,10 +219,10 @@ void outtext(char *textstring)
 	set_align(pWndData);
     }
 
+    BGI__BeginBounds( hDC );
     TextOut(hDC, 0, 0, (LPCTSTR)textstring, strlen(textstring));
+    BGI__RefreshBounds( hDC );
     BGI__ReleaseWinbgiDC( );
-    RefreshWindow( NULL );
-    // Todo: Change to refresh only the needed part.
 }
 
 // This function prints textstring to x,y
@@ -243,11 +243,10 @@ void outtextxy(int x, int y, char *textstring)
 	set_align(pWndData);
     }
 
+    BGI__BeginBounds( hDC );
     TextOut(hDC, x, y, (LPCTSTR)textstring, strlen(textstring));
+    BGI__RefreshBounds( hDC );
     BGI__ReleaseWinbgiDC( );
-
-    RefreshWindow( NULL );
-    // Todo: Change to refresh only the needed part.
 }
 
 
@@ -263,9 +262,9 @@ void settextjustify(int horiz, int vert)
     pWndData->textInfo.horiz = horiz;
     pWndData->textInfo.vert  = vert;
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     set_align(pWndData);
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 
@@ -282,9 +281,9 @@ void settextstyle(int font, int direction, int charsize)
     pWndData->textInfo.direction = direction;
     pWndData->textInfo.charsize = charsize;
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     set_font(pWndData);
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 // This function sets the size of stroked fonts
@@ -300,9 +299,9 @@ void setusercharsize(int multx, int divx, int multy, int divy)
     pWndData->t_scale[2] = multy;
     pWndData->t_scale[3] = divy;
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     set_font(pWndData);
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 }
 
 // This function returns the height in pixels of textstring using the current
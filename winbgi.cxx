@@ -217,7 +217,7 @@ void graphdefaults( )
 	// Set the default text color for each page
 	SetTextColor(pWndData->hDC[i], converttorgb(WHITE));
     }
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
 
     // Set text font and justification to default
     pWndData->textInfo.horiz = LEFT_TEXT;
@@ -25,13 +25,49 @@
 // ---------------------------------------------------------------------------
 #ifndef WINBGI_H
 #define WINBGI_H
+// Without the Win32 API the library is built with the headless backend,
+// which draws into in-memory surfaces instead of windows (headless.cxx).
+#if !defined(_WIN32) && !defined(BGI_HEADLESS)
+#define BGI_HEADLESS
+#endif
+#ifndef BGI_HEADLESS
 #include <windows.h>        // Provides the mouse message types
+#endif
 #include <limits.h>         // Provides INT_MAX
 #include <sstream>          // Provides std::ostringstream
 // ---------------------------------------------------------------------------
 
 
 
+// ---------------------------------------------------------------------------
+//                          Headless Stand-ins
+// ---------------------------------------------------------------------------
+// The few pieces of <windows.h> that appear in this interface.  The values
+// match the Win32 ones so programs behave the same with either backend.
+#ifdef BGI_HEADLESS
+typedef void* HWND;                 // Identifies a (headless) window
+typedef unsigned int COLORREF;      // 0x00BBGGRR
+#define RGB(r,g,b)          ((COLORREF)(((r)&0xFF) | (((g)&0xFF)<<8) | (((b)&0xFF)<<16)))
+#define GetRValue(rgb)      ((unsigned char)(rgb))
+#define GetGValue(rgb)      ((unsigned char)((rgb) >> 8))
+#define GetBValue(rgb)      ((unsigned char)((rgb) >> 16))
+#define WM_MOUSEFIRST       0x0200
+#define WM_MOUSEMOVE        0x0200
+#define WM_LBUTTONDOWN      0x0201
+#define WM_LBUTTONUP        0x0202
+#define WM_LBUTTONDBLCLK    0x0203
+#define WM_RBUTTONDOWN      0x0204
+#define WM_RBUTTONUP        0x0205
+#define WM_RBUTTONDBLCLK    0x0206
+#define WM_MBUTTONDOWN      0x0207
+#define WM_MBUTTONUP        0x0208
+#define WM_MBUTTONDBLCLK    0x0209
+#define WM_MOUSELAST        0x0209
+#endif
+// ---------------------------------------------------------------------------
+
+
+
 // ---------------------------------------------------------------------------
 //                          Definitions
 // ---------------------------------------------------------------------------
@@ -180,6 +216,29 @@ struct viewporttype
 };
 
 
+// This structure records how the changes to a window have been shown on the
+// screen (getrefreshstatsbgi).
+struct refreshstatstype
+{
+    unsigned long changes;      // Changed rectangles reported by drawing calls
+    unsigned long merged;       // Rectangles merged into another changed region
+    unsigned long presents;     // Times the window was brought up to date
+    unsigned long long bytes;   // Pixel bytes copied to the screen
+};
+
+
+// This structure records how often drawing calls had to wait for each other
+// (getlockstatsbgi).
+struct lockstatstype
+{
+    unsigned long acquisitions; // Times a call took the window's lock
+    unsigned long contended;    // Times it had to wait for another thread
+    unsigned long timeouts;     // Waits that lasted over 5 seconds
+    double wait_ms;             // Total time spent waiting
+    double max_wait_ms;         // Longest single wait
+};
+
+
 // This structure records information about the palette.
 struct palettetype
 {
@@ -214,6 +273,64 @@ void linerel( int dx, int dy );
 void lineto( int x, int y );
 void pieslice( int x, int y, int stangle, int endangle, int radius );
 void putpixel( int x, int y, int color );
+// Plot n_points pixels (xs[i],ys[i]) in one call, each in colors[i]
+// (putpixels) or all in one color (putpixelscolor).  Much faster than
+// calling putpixel for each one.
+void putpixels( int n_points, const int* xs, const int* ys, const int* colors );
+void putpixelscolor( int n_points, const int* xs, const int* ys, int color );
+
+// Direct Buffer Access
+// lockbuffer returns the pixels of the active page of the current window,
+// top row first, with *pitch set to the number of pixels from one row to the
+// next.  Each pixel is 0x00RRGGBB; bufferpixel converts a BGI or RGB color
+// to that format.  Coordinates are those of the window, not the viewport,
+// and nothing is clipped.  While the buffer is locked, any number of threads
+// may write to it as long as no two write the same pixel (for example, each
+// takes its own rows); drawing calls from other threads wait until
+// unlockbuffer.  unlockbuffer must be called by the thread that called
+// lockbuffer, with the rectangle that was changed (default: all of it).
+unsigned int* lockbuffer( int* pitch );
+void unlockbuffer( int left=0, int top=0, int right=INT_MAX, int bottom=INT_MAX );
+unsigned int bufferpixel( int color );
+
+// Command Buffers
+// Each thread may record drawing calls into a buffer of its own, with a
+// color, fill style and line style of its own (starting from the window's),
+// without waiting for any other thread.  flushrecordedbgi draws everything
+// recorded so far in one go, ordered by the key given to setrecordorder
+// (default 0), then by the order the threads started recording, then in the
+// order the calls were made, and returns how many calls it drew.  No thread
+// may record while the flush runs.  With keep set, the buffers are not
+// emptied, so the same calls can be drawn again.
+void setrecordorder( int key );
+void recordsetcolor( int color );
+void recordsetfillstyle( int pattern, int color );
+void recordsetlinestyle( int linestyle, unsigned upattern, int thickness );
+void recordputpixel( int x, int y, int color );
+void recordline( int x1, int y1, int x2, int y2 );
+void recordbar( int left, int top, int right, int bottom );
+void recordcircle( int x, int y, int radius );
+void recordfillpoly( int n_points, const int* points );
+int flushrecordedbgi( bool keep=false );
+
+// Memory-Mapped Images
+// createimagemapbgi creates (or replaces) a PAM image file of width x height
+// pixels, all transparent, without holding any of it in memory, so it may be
+// far larger than memory.  It returns a handle for the other calls, or -1.
+// The width is rounded up to a multiple of 16 pixels, so that every row
+// starts on a 64-byte boundary.  lockimagetile maps the pixels from (left,
+// top) to (right, bottom) into memory and returns the first one, with *pitch
+// set to the number of pixels from one row to the next; unlockimagetile takes
+// that pointer back and unmaps them.  Any number of tiles may be locked at
+// once, by any threads, as long as no two are written to in the same place.
+// imagemappixel converts a BGI color (from the default palette, whatever the
+// window uses) or RGB color to a pixel of the file, which is not the same as
+// bufferpixel.  closeimagemapbgi closes the file.
+int createimagemapbgi( const char* filename, int width, int height );
+unsigned int* lockimagetile( int image, int left, int top, int right, int bottom, int* pitch );
+void unlockimagetile( int image, unsigned int* tile );
+unsigned int imagemappixel( int color );
+bool closeimagemapbgi( int image );
 void rectangle( int left, int top, int right, int bottom );
 void sector( int x, int y, int stangle, int endangle, int xradius, int yradius );
 
@@ -243,6 +360,12 @@ void moverel( int dx, int dy );
 void moveto( int x, int y );
 void refreshbgi(int left, int top, int right, int bottom);
 void refreshallbgi( );    
+// Changes are shown at most hz times a second (default 60; 0 shows every
+// change at once).  flushbgi shows any pending changes now.
+void setrefreshratebgi( int hz );
+void flushbgi( );
+void getrefreshstatsbgi( refreshstatstype *stats );
+void getlockstatsbgi( lockstatstype *stats );
 void setbkcolor( int color );
 void setcolor( int color );
 void setfillpattern( char *upattern, int color );
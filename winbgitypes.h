@@ -16,11 +16,18 @@
 #include <queue>                // Provides STL queue class
 #include <string>               // Provides STL string class
 #include "winbgi.h"             // Provides other structures
+#include "damage.h"             // Provides BGI__Damage
+#include "lock.h"               // Provides BGI__Lock
 
 // Define maximum pages used for drawing.
 #define MAX_PAGES 4
 typedef void (*Handler)(int, int);
 
+// The timer that presents damage the refresh rate held back, and how often
+// it fires (ms).
+#define BGI__REFRESH_TIMER 1
+#define BGI__REFRESH_TICK 10
+
 // ---------------------------------------------------------------------------
 //                              Structures
 // ---------------------------------------------------------------------------
@@ -41,7 +48,8 @@ struct WindowData
     viewporttype viewportInfo;  // Information about the viewport
     HWND hWnd;                  // Handle to the window created
     HDC hDC[MAX_PAGES];         // Device contexts used for double buffering
-    HBITMAP hOldBitmap[MAX_PAGES]; // The bitmaps generated with CreateCompatibleBitmap
+    HBITMAP hOldBitmap[MAX_PAGES]; // The bitmaps originally selected into hDC
+    DWORD* pixels[MAX_PAGES];   // The bits of each page's DIB section (lockbuffer)
     int VisualPage;             // The current device context used for painting the window
     int ActivePage;             // The current device context used for drawing
     bool DoubleBuffer;          // Whether the user wants a double buffered window (DOUBLE_BUFFER in initwindow)
@@ -65,7 +73,8 @@ struct WindowData
     bool mouse_queuing[WM_MOUSELAST - WM_MOUSEFIRST + 1]; // Array to tell whether mouse events should be queued
     Handler mouse_handlers[WM_MOUSELAST - WM_MOUSEFIRST + 1];   // Array of mouse event handlers
     bool refreshing;            // True if autorefershing should be done after each drawing event
-    HANDLE hDCMutex;            // A mutex so that only one thread at a time can access the hDC array.
+    BGI__Lock hDCLock;          // A lock so that only one thread at a time can access the hDC array.
+    BGI__Damage damage;         // Changed areas waiting to be painted (guarded by hDCLock)
 };
 // maybe need current position for lines, text, etc.
 // palette settings
@@ -88,6 +97,10 @@ DWORD WINAPI BGI__ThreadInitWindow( LPVOID pThreadData );
 HDC BGI__GetWinbgiDC( HWND hWnd = NULL );
 void BGI__ReleaseWinbgiDC( HWND hWnd = NULL );
 
+// Takes and releases the lock on the pages of a window (drawing.cpp)
+void BGI__LockWindow( WindowData* pWndData );
+void BGI__UnlockWindow( WindowData* pWndData );
+
 // Returns a pointer to the window data structure associated with hWnd.
 // If hWnd is NULL, the current window is used (drawing.cpp)
 WindowData* BGI__GetWindowDataPtr( HWND hWnd = NULL );
@@ -95,6 +108,15 @@ WindowData* BGI__GetWindowDataPtr( HWND hWnd = NULL );
 // Refreshes an area of the window:
 void RefreshWindow( RECT* rect );
 
+// Invalidates the window's damaged regions, if the refresh rate allows it
+// or force is set (drawing.cpp)
+void BGI__PresentDamage( WindowData* pWndData, bool force );
+
+// Refreshes the bounds of what GDI draws into hDC between the two calls
+// (drawing.cpp)
+void BGI__BeginBounds( HDC hDC );
+void BGI__RefreshBounds( HDC hDC );
+
 // ---------------------------------------------------------------------------
 //                            Global Variables
 // ---------------------------------------------------------------------------
@@ -44,7 +44,7 @@ DWORD WINAPI BGI__ThreadInitWindow( LPVOID pThreadData )
     HWND hWindow;                       // A handle to the window
     MSG Message;                        // A windows event message
     HDC hDC;                            // The device context of the window
-    HBITMAP hBitmap;                    // A compatible bitmap of the DC for the Memory DC
+    HBITMAP hBitmap;                    // The DIB section selected into each memory DC
     HMENU hMenu;                        // Handle to the system menu
     int CaptionHeight, xBorder, yBorder;
     
@@ -116,18 +116,31 @@ DWORD WINAPI BGI__ThreadInitWindow( LPVOID pThreadData )
     // to the screen in the paint method.  The DC and bitmaps are deleted
     // in cls_OnDestroy()
     hDC = GetDC( hWindow );
-    pWndData->hDCMutex = CreateMutex(NULL, FALSE,	NULL);
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
     {
         pWndData->hDC[i] = CreateCompatibleDC( hDC );
-        // Create a bitmap for the memory DC.  This is where the drawn image is stored.
-        hBitmap = CreateCompatibleBitmap( hDC, pWndData->width, pWndData->height );
+        // Create a bitmap for the memory DC.  This is where the drawn image is
+        // stored.  It is a 32-bit top-down DIB section rather than a
+        // compatible bitmap so that lockbuffer can hand out its pixels.
+        BITMAPINFO bmi;
+        ZeroMemory( &bmi, sizeof(bmi) );
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = pWndData->width;
+        bmi.bmiHeader.biHeight = -pWndData->height;     // Negative: top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        hBitmap = CreateDIBSection( hDC, &bmi, DIB_RGB_COLORS, (void**)&pWndData->pixels[i], NULL, 0 );
         pWndData->hOldBitmap[i] = (HBITMAP)SelectObject( pWndData->hDC[i], hBitmap );
     }
-    ReleaseMutex(pWndData->hDCMutex);    
+    BGI__DamageInit( &pWndData->damage, pWndData->width, pWndData->height, BGI__DEFAULT_REFRESH_RATE );
+    BGI__UnlockWindow( pWndData );    
     // Release the original DC and set up the mutex for the hDC array
     ReleaseDC( hWindow, hDC );
+
+    // Present the changes held back by the refresh rate
+    SetTimer( hWindow, BGI__REFRESH_TIMER, BGI__REFRESH_TICK, NULL );
     
     // Make the window visible
     ShowWindow( hWindow, SW_SHOWNORMAL );           // Make the window visible
@@ -180,7 +193,8 @@ static void cls_OnDestroy( HWND hWnd )
     // This gets the address of the WindowData structure associated with the window
     WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
 
-    WaitForSingleObject(pWndData->hDCMutex, 5000);
+    KillTimer( hWnd, BGI__REFRESH_TIMER );
+    BGI__LockWindow( pWndData );
     for ( int i = 0; i < MAX_PAGES; i++ )
     {
         // Delete the pen in the DC's
@@ -196,7 +210,7 @@ static void cls_OnDestroy( HWND hWnd )
         // Finally, we delete the MemoryDC
         DeleteObject( pWndData->hDC[i] );
     }
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     // Clean up the bitmap memory
     DeleteBitmap( pWndData->hbitmap );
 
@@ -308,6 +322,18 @@ static void cls_OnKey( HWND hWnd, UINT vk, BOOL down, int repeat, UINT flags )
     FORWARD_WM_KEYDOWN( hWnd, vk, repeat, flags, DefWindowProc );
 }
 
+// This function handles the WM_TIMER message.  The refresh timer presents
+// any damage that is due but that no drawing call has presented yet.
+//
+static void cls_OnTimer( HWND hWnd, UINT id )
+{
+    WindowData *pWndData = BGI__GetWindowDataPtr( hWnd );
+
+    if ( id == BGI__REFRESH_TIMER )
+        BGI__PresentDamage( pWndData, false );
+}
+
+
 #include <iostream>
 static void cls_OnPaint( HWND hWnd )
 {
@@ -319,7 +345,7 @@ static void cls_OnPaint( HWND hWnd )
     BOOL success;               // Is the BitBlt successful?
     int i;                      // Count for how many bitblts have been tried.
 
-    WaitForSingleObject(pWndData->hDCMutex, INFINITE);
+    BGI__LockWindow( pWndData );
     BeginPaint( hWnd, &ps );
     hSrcDC = pWndData->hDC[pWndData->VisualPage];   // The source (memory) DC
 
@@ -340,7 +366,7 @@ static void cls_OnPaint( HWND hWnd )
     success = BitBlt( ps.hdc, ps.rcPaint.left, ps.rcPaint.top, width, height,
 			 hSrcDC, srcCorner.x, srcCorner.y, SRCCOPY );
     EndPaint( hWnd, &ps );  // Validates the rectangle
-    ReleaseMutex(pWndData->hDCMutex);
+    BGI__UnlockWindow( pWndData );
     
     if ( !success )
     {   // I would like to invalidate the rectangle again
@@ -388,6 +414,7 @@ LRESULT CALLBACK WndProc
     HANDLE_MSG( hWnd, WM_DESTROY, cls_OnDestroy );
     HANDLE_MSG( hWnd, WM_KEYDOWN, cls_OnKey );
     HANDLE_MSG( hWnd, WM_PAINT, cls_OnPaint );
+    HANDLE_MSG( hWnd, WM_TIMER, cls_OnTimer );
     case WM_LBUTTONDBLCLK:
 	return TRUE;
     case WM_NCHITTEST: